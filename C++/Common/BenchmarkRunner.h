@@ -0,0 +1,385 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file BenchmarkRunner.h
+//
+//  \brief
+//  Small benchmark harness in the style of Google Benchmark: timed cases, MB/s and frames/s, JSON
+//  results and comparison against a stored baseline.
+//
+//  Description: a case is a name, the bytes and frames one iteration processes and a function
+//  running one iteration. Run() calls every case once untimed (lazy initialization, page faults),
+//  then repeats it until both the minimum time and the minimum iteration count are reached and
+//  reports the median iteration time, which is robust against the odd preemption. The minimum
+//  is kept as well.
+//
+//  WriteJson() writes the results in the layout of Google Benchmark's --benchmark_out (context,
+//  benchmarks with name, iterations, real_time, bytes_per_second, items_per_second), one object
+//  per line. LoadBaseline() reads the name and bytes_per_second of every benchmark from such a
+//  file, also one written by Google Benchmark itself, and Compare() flags every case whose
+//  throughput fell by more than the threshold:
+//
+//      BenchmarkRunner runner(0.5);
+//      runner.Add("Demodulate/2048x1088", frameBytes, 1, [&]() { return Demodulate(); });
+//      runner.Run(stdout);
+//      runner.WriteJson("results.json");
+//      if (runner.LoadBaseline("baseline.json") && runner.Compare(stdout, 0.10) > 0)
+//          return 1;
+//
+//  Cases are run in the order they were added. Run() may be called several times, e.g. once per
+//  data set so only one set of buffers is allocated at a time; the results accumulate.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HostClock.h"
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t bytes;         // per iteration
+    uint32_t frames;        // per iteration
+    uint64_t iterations;
+    double medianNs;
+    double minNs;
+    bool failed;
+
+    double GetBytesPerSecond() const
+    {
+        return (medianNs > 0.0) ? bytes * 1e9 / medianNs : 0.0;
+    }
+
+    double GetFramesPerSecond() const
+    {
+        return (medianNs > 0.0) ? frames * 1e9 / medianNs : 0.0;
+    }
+};
+
+class BenchmarkRunner
+{
+public:
+    // Iterations stop after minSeconds and minIterations, whichever comes last
+    explicit BenchmarkRunner(double minSeconds = 0.5, uint64_t minIterations = 5, uint64_t maxIterations = 100000)
+        : m_minNs((uint64_t)(minSeconds * 1e9)), m_minIterations(minIterations), m_maxIterations(maxIterations),
+          m_headerPrinted(false)
+    {
+    }
+
+    // Only cases whose name contains filter are run
+    void SetFilter(const char *filter)
+    {
+        m_filter = (filter != nullptr) ? filter : "";
+    }
+
+    // Extra "context" entries of the JSON output
+    void SetContext(const std::string &key, const std::string &value)
+    {
+        m_context.push_back(std::make_pair(key, value));
+    }
+
+    // run performs one iteration and returns false on an error, which fails the case
+    void Add(const std::string &name, uint64_t bytes, uint32_t frames, std::function<bool()> run)
+    {
+        Case entry;
+        entry.name = name;
+        entry.bytes = bytes;
+        entry.frames = frames;
+        entry.run = run;
+        m_cases.push_back(entry);
+    }
+
+    // Runs the cases added since the last call, one result line each
+    void Run(FILE *out)
+    {
+        if (!m_headerPrinted)
+        {
+            fprintf(out, "%-64s %10s %12s %10s %10s\n", "Benchmark", "Iterations", "Time (us)", "MB/s", "Frames/s");
+            m_headerPrinted = true;
+        }
+        for (size_t i = 0; i < m_cases.size(); i++)
+        {
+            const Case &entry = m_cases[i];
+            if (!m_filter.empty() && entry.name.find(m_filter) == std::string::npos)
+                continue;
+            BenchmarkResult result = Measure(entry);
+            if (result.failed)
+                fprintf(out, "%-64s %10s\n", result.name.c_str(), "failed");
+            else
+                fprintf(out, "%-64s %10llu %12.1f %10.1f %10.1f\n", result.name.c_str(), (unsigned long long)result.iterations,
+                    result.medianNs / 1000.0, result.GetBytesPerSecond() / 1e6, result.GetFramesPerSecond());
+            fflush(out);
+            m_results.push_back(result);
+        }
+        m_cases.clear();
+    }
+
+    const std::vector<BenchmarkResult> &GetResults() const
+    {
+        return m_results;
+    }
+
+    bool WriteJson(const char *filename) const
+    {
+        FILE *file = fopen(filename, "w");
+        if (file == nullptr)
+            return false;
+        char date[64];
+        time_t now = time(nullptr);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        fprintf(file, "{\n  \"context\": {\n    \"date\": \"%s\"", date);
+        for (size_t i = 0; i < m_context.size(); i++)
+            fprintf(file, ",\n    \"%s\": \"%s\"", JsonEscape(m_context[i].first).c_str(), JsonEscape(m_context[i].second).c_str());
+        fprintf(file, "\n  },\n  \"benchmarks\": [");
+        bool first = true;
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const BenchmarkResult &result = m_results[i];
+            if (result.failed)
+                continue;
+            fprintf(file, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"real_time\": %.1f, \"min_time\": %.1f, "
+                "\"time_unit\": \"ns\", \"bytes_per_second\": %.1f, \"items_per_second\": %.3f}",
+                first ? "" : ",", JsonEscape(result.name).c_str(), (unsigned long long)result.iterations, result.medianNs, result.minNs,
+                result.GetBytesPerSecond(), result.GetFramesPerSecond());
+            first = false;
+        }
+        fprintf(file, "\n  ]\n}\n");
+        return fclose(file) == 0;
+    }
+
+    // Reads name and bytes_per_second of every benchmark of a JSON results file
+    bool LoadBaseline(const char *filename)
+    {
+        FILE *file = fopen(filename, "rb");
+        if (file == nullptr)
+            return false;
+        std::string text;
+        char chunk[4096];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            text.append(chunk, read);
+        fclose(file);
+
+        m_baseline.clear();
+        size_t position = 0;
+        while ((position = text.find("\"name\"", position)) != std::string::npos)
+        {
+            size_t open = text.find('"', text.find(':', position) + 1);
+            std::string name;
+            size_t close = (open == std::string::npos) ? open : ReadJsonString(text, open, name);
+            // The next benchmark starts after the name, which may contain "name" itself
+            size_t next = text.find("\"name\"", (close == std::string::npos) ? position + 6 : close);
+            size_t rate = (close == std::string::npos) ? close : text.find("\"bytes_per_second\"", close);
+            if (close != std::string::npos && rate != std::string::npos && rate < next)
+            {
+                size_t colon = text.find(':', rate);
+                m_baseline[name] = strtod(text.c_str() + colon + 1, nullptr);
+            }
+            position = (next == std::string::npos) ? text.size() : next;
+        }
+        return !m_baseline.empty();
+    }
+
+    // Prints the change against the baseline, returns the number of cases slower by more than
+    // threshold (0.10 = 10%). A case of the baseline that fails now counts as a regression.
+    int Compare(FILE *out, double threshold) const
+    {
+        int regressions = 0;
+        std::map<std::string, bool> measured;
+        fprintf(out, "\n%-64s %10s %10s %8s\n", "Benchmark", "Base MB/s", "MB/s", "Change");
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const BenchmarkResult &result = m_results[i];
+            measured[result.name] = true;
+            std::map<std::string, double>::const_iterator base = m_baseline.find(result.name);
+            if (result.failed && base != m_baseline.end())
+            {
+                fprintf(out, "%-64s %10.1f %10s %8s  REGRESSION\n", result.name.c_str(), base->second / 1e6, "failed", "");
+                regressions++;
+                continue;
+            }
+            if (result.failed || base == m_baseline.end() || base->second <= 0.0)
+            {
+                fprintf(out, "%-64s %10s\n", result.name.c_str(), result.failed ? "failed" : "new");
+                continue;
+            }
+            double change = result.GetBytesPerSecond() / base->second - 1.0;
+            const char *verdict = "";
+            if (change < -threshold)
+            {
+                verdict = "  REGRESSION";
+                regressions++;
+            }
+            else if (change > threshold)
+                verdict = "  faster";
+            fprintf(out, "%-64s %10.1f %10.1f %+7.1f%%%s\n", result.name.c_str(), base->second / 1e6,
+                result.GetBytesPerSecond() / 1e6, 100.0 * change, verdict);
+        }
+        // Not a regression: a filter or other widths and heights leave cases of the baseline out
+        int missing = 0;
+        for (std::map<std::string, double>::const_iterator base = m_baseline.begin(); base != m_baseline.end(); ++base)
+        {
+            if (measured.count(base->first) == 0)
+                missing++;
+        }
+        if (missing > 0)
+            fprintf(out, "%d case(s) of the baseline not measured\n", missing);
+        fprintf(out, "%d regression(s) beyond %.0f%%\n", regressions, 100.0 * threshold);
+        return regressions;
+    }
+
+private:
+    static std::string JsonEscape(const std::string &text)
+    {
+        std::string escaped;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            unsigned char c = (unsigned char)text[i];
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += (char)c;
+            }
+            else if (c < 0x20)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                escaped += code;
+            }
+            else
+            {
+                escaped += (char)c;
+            }
+        }
+        return escaped;
+    }
+
+    // String starting at the quote at open, unescaped into value. Returns the closing quote.
+    static size_t ReadJsonString(const std::string &text, size_t open, std::string &value)
+    {
+        value.clear();
+        for (size_t i = open + 1; i < text.size(); i++)
+        {
+            char c = text[i];
+            if (c == '"')
+                return i;
+            if (c != '\\' || i + 1 >= text.size())
+            {
+                value += c;
+                continue;
+            }
+            c = text[++i];
+            if (c == 'u' && i + 4 < text.size())
+            {
+                // Only the control characters JsonEscape() writes, other code points are kept escaped
+                unsigned long code = strtoul(text.substr(i + 1, 4).c_str(), nullptr, 16);
+                if (code < 0x80)
+                    value += (char)code;
+                else
+                    value += "\\u" + text.substr(i + 1, 4);
+                i += 4;
+            }
+            else if (c == 'n')
+                value += '\n';
+            else if (c == 't')
+                value += '\t';
+            else if (c == 'r')
+                value += '\r';
+            else
+                value += c;
+        }
+        return std::string::npos;
+    }
+
+    struct Case
+    {
+        std::string name;
+        uint64_t bytes;
+        uint32_t frames;
+        std::function<bool()> run;
+    };
+
+    BenchmarkResult Measure(const Case &entry) const
+    {
+        BenchmarkResult result;
+        result.name = entry.name;
+        result.bytes = entry.bytes;
+        result.frames = entry.frames;
+        result.iterations = 0;
+        result.medianNs = 0.0;
+        result.minNs = 0.0;
+        result.failed = !entry.run();
+
+        std::vector<uint64_t> times;
+        uint64_t start = HostNowNs();
+        uint64_t elapsed = 0;
+        while (!result.failed && times.size() < m_maxIterations && (elapsed < m_minNs || times.size() < m_minIterations))
+        {
+            uint64_t begin = HostNowNs();
+            result.failed = !entry.run();
+            uint64_t end = HostNowNs();
+            times.push_back(end - begin);
+            elapsed = end - start;
+        }
+        if (result.failed || times.empty())
+        {
+            result.failed = true;
+            return result;
+        }
+        std::sort(times.begin(), times.end());
+        result.iterations = times.size();
+        result.medianNs = (double)times[times.size() / 2];
+        result.minNs = (double)times[0];
+        return result;
+    }
+
+    uint64_t m_minNs;
+    uint64_t m_minIterations;
+    uint64_t m_maxIterations;
+    bool m_headerPrinted;
+    std::string m_filter;
+    std::vector<std::pair<std::string, std::string> > m_context;
+    std::vector<Case> m_cases;
+    std::vector<BenchmarkResult> m_results;
+    std::map<std::string, double> m_baseline;
+};
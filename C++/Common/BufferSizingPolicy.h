@@ -0,0 +1,195 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file BufferSizingPolicy.h
+//
+//  \brief
+//  Chooses the ring buffer count (PFStream::SetBufferCount()) from measured consumer latency
+//  instead of a fixed guess, and adapts it from one session to the next.
+//
+//  Description: while the consumer spends time on a frame, new frames keep arriving at the frame
+//  rate and wait in the ring buffer. A stall of D seconds needs fps * D free buffers, otherwise
+//  frames are dropped. For a target loss probability p the policy takes the consumer latency that
+//  is exceeded by a fraction p of the frames and sizes the ring for that stall:
+//
+//      buffers = ceil(fps * latency(1 - p) * safety) + headroom
+//
+//  The headroom covers the buffer being filled by the stream and the one held by the consumer.
+//  If there are too few samples to resolve the requested percentile, the maximum is used.
+//
+//  fps must be the rate the camera delivers (AcquisitionFrameRate or the stream statistics), not
+//  the rate the consumer picks frames up: an overloaded consumer paces its own intervals.
+//  A consumer that needs longer than a frame period on average loses frames with any ring size.
+//  The policy then reports it as overloaded and keeps the count of this session instead of
+//  locking more memory that would not help.
+//
+//  The count of the next session is stored in a small text file. It grows at once to the
+//  recommendation (and by at least 50% if the session lost frames) but only shrinks by half of
+//  the difference per session, so a single quiet session does not undo the sizing.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+
+#include "LatencyHistogram.h"
+
+class BufferSizingPolicy
+{
+public:
+    BufferSizingPolicy(const char *stateFile, int defaultCount, double targetLossProbability = 1e-4,
+                       int minCount = 4, int maxCount = 2000)
+        : m_stateFile(stateFile), m_defaultCount(defaultCount), m_targetLoss(targetLossProbability),
+          m_minCount(minCount), m_maxCount(maxCount), m_safety(1.25), m_headroom(2),
+          m_sessionCount(defaultCount), m_recommended(0), m_nextCount(0), m_frameBytes(0), m_load(0.0)
+    {
+    }
+
+    // Buffer count for this session: stored by the previous session or the default
+    int Load()
+    {
+        int count = 0;
+        FILE *file = fopen(m_stateFile.c_str(), "r");
+        if (file)
+        {
+            if (fscanf(file, "BufferCount=%d", &count) != 1)
+                count = 0;
+            fclose(file);
+        }
+        m_sessionCount = (count > 0) ? Clamp(count) : m_defaultCount;
+        return m_sessionCount;
+    }
+
+    // Mean consumer latency in frame periods; above 1 the consumer can not keep up
+    static double GetLoad(double fps, const LatencyHistogram &consumerLatency)
+    {
+        return consumerLatency.GetMean() * fps / 1e9;
+    }
+
+    // Minimal buffer count for the given frame rate and consumer latency (ns per frame).
+    // An overloaded consumer gets the count of this session, no ring size avoids its losses.
+    int Recommend(double fps, const LatencyHistogram &consumerLatency) const
+    {
+        if (fps <= 0.0 || consumerLatency.GetCount() == 0 || GetLoad(fps, consumerLatency) > 1.0)
+            return m_sessionCount;
+
+        double percentile = 100.0 * (1.0 - m_targetLoss);
+        uint64_t stallNs;
+        if ((double)consumerLatency.GetCount() * m_targetLoss < 1.0)
+            stallNs = consumerLatency.GetMax();
+        else
+            stallNs = consumerLatency.GetValueAtPercentile(percentile);
+
+        double buffers = std::ceil(fps * (double)stallNs / 1e9 * m_safety) + m_headroom;
+        return Clamp((int)buffers);
+    }
+
+    // Computes the count for the next session and stores it. Returns the new count.
+    int Update(uint64_t frameBytes, double fps, const LatencyHistogram &consumerLatency, uint64_t lostFrames)
+    {
+        m_frameBytes = frameBytes;
+        m_recommended = Recommend(fps, consumerLatency);
+        m_load = (fps > 0.0) ? GetLoad(fps, consumerLatency) : 0.0;
+
+        int next;
+        if (m_recommended >= m_sessionCount)
+            next = m_recommended;
+        else
+            next = m_sessionCount - (m_sessionCount - m_recommended) / 2;
+        // Losses of an overloaded consumer are not a ring size problem
+        if (lostFrames > 0 && !IsOverloaded() && next < m_sessionCount + m_sessionCount / 2)
+            next = m_sessionCount + m_sessionCount / 2;
+        m_nextCount = Clamp(next);
+
+        FILE *file = fopen(m_stateFile.c_str(), "w");
+        if (file)
+        {
+            fprintf(file, "BufferCount=%d\n", m_nextCount);
+            fclose(file);
+        }
+        return m_nextCount;
+    }
+
+    int GetSessionCount() const { return m_sessionCount; }
+    int GetRecommended() const { return m_recommended; }
+    int GetNextCount() const { return m_nextCount; }
+    bool IsOverloaded() const { return m_load > 1.0; }
+
+    void PrintReport(FILE *out) const
+    {
+        const double MB = 1024.0 * 1024.0;
+        fprintf(out, "Ring buffers: this session %d, recommended %d, next session %d (target loss %g)\n",
+            m_sessionCount, m_recommended, m_nextCount, m_targetLoss);
+        if (IsOverloaded())
+            fprintf(out, "Consumer overloaded: it needs %.2f frame periods per frame on average and loses frames with any ring size,"
+                " the buffer count is kept\n", m_load);
+        if (m_frameBytes)
+        {
+            double change = (m_nextCount - m_defaultCount) * (double)m_frameBytes / MB;
+            fprintf(out, "Ring memory: default %.1f MB, this session %.1f MB, next session %.1f MB",
+                m_defaultCount * (double)m_frameBytes / MB, m_sessionCount * (double)m_frameBytes / MB,
+                m_nextCount * (double)m_frameBytes / MB);
+            if (change < 0.0)
+                fprintf(out, " (saves %.1f MB)\n", -change);
+            else if (change > 0.0)
+                fprintf(out, " (needs %.1f MB more)\n", change);
+            else
+                fprintf(out, "\n");
+        }
+    }
+
+private:
+    int Clamp(int count) const
+    {
+        if (count < m_minCount)
+            return m_minCount;
+        if (count > m_maxCount)
+            return m_maxCount;
+        return count;
+    }
+
+    std::string m_stateFile;
+    int m_defaultCount;
+    double m_targetLoss;
+    int m_minCount;
+    int m_maxCount;
+    double m_safety;
+    int m_headroom;
+    int m_sessionCount;
+    int m_recommended;
+    int m_nextCount;
+    uint64_t m_frameBytes;
+    double m_load;
+};
@@ -0,0 +1,271 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file CameraClockModel.h
+//
+//  \brief
+//  Maps camera timestamps (PFBuffer::GetTimestamp(), camera clock ticks) to host monotonic time.
+//
+//  Description: every buffer gives a pair (camera timestamp, host arrival time). The arrival is
+//  the host time of the timestamp plus a transport delay that is never below some minimum but
+//  often much larger (packet coalescing, scheduling, full ring buffer). A least squares fit over
+//  all pairs would therefore be biased by the queueing delays. Instead the model fits the lower
+//  envelope of the points:
+//
+//  1. Camera time is split in windows (default 500 ms). Of every window only the pair with the
+//     smallest delay is kept, in a ring of the last windows (default 64, i.e. 32 s).
+//  2. Offset and drift are fitted by least squares over the window minima. Minima with a residual
+//     above 3 MADs are dropped and the fit is repeated.
+//  3. The line is lowered to touch the lowest minimum, so it runs below all of them.
+//
+//  The resulting host time estimate includes the minimum transport delay, which cannot be
+//  separated from the clock offset without PTP; it is the same for all frames of a camera.
+//  ToHostNs() is a multiply and an add and can be called for every frame. Use one model per
+//  camera to bring several cameras onto the host time base.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+class CameraClockModel
+{
+public:
+    // tickFrequency is the nominal camera clock in Hz (GevTimestampTickFrequency). With 0 it is
+    // estimated from the first second of data.
+    CameraClockModel(double tickFrequency = 0.0, uint64_t windowNs = 500000000ull, int windowCount = 64)
+        : m_nominalNsPerTick(tickFrequency > 0.0 ? 1e9 / tickFrequency : 0.0), m_windowNs(windowNs),
+          m_windowCount(windowCount < 2 ? 2 : windowCount)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_hasFirst = false;
+        m_firstTicks = 0;
+        m_firstHostNs = 0;
+        m_windows.clear();
+        m_current.valid = false;
+        m_fitValid = false;
+        m_refTicks = 0;
+        m_refHostNs = 0;
+        m_nsPerTick = m_nominalNsPerTick;
+        m_samples = 0;
+    }
+
+    // Adds one buffer. Call it in arrival order with the timestamp of the buffer and its arrival time.
+    void Add(uint64_t cameraTicks, uint64_t arrivalNs)
+    {
+        m_samples++;
+        if (!m_hasFirst)
+        {
+            m_hasFirst = true;
+            m_firstTicks = cameraTicks;
+            m_firstHostNs = arrivalNs;
+            return;
+        }
+        if (cameraTicks < m_firstTicks)
+        {
+            // Camera clock was reset (e.g. TimestampReset or reconnection)
+            Reset();
+            Add(cameraTicks, arrivalNs);
+            return;
+        }
+
+        if (m_nsPerTick <= 0.0)
+        {
+            // Bootstrap the nominal rate from at least one second of data
+            if (arrivalNs - m_firstHostNs < 1000000000ull || cameraTicks == m_firstTicks)
+                return;
+            m_nsPerTick = (double)(arrivalNs - m_firstHostNs) / (double)(cameraTicks - m_firstTicks);
+            m_nominalNsPerTick = m_nsPerTick;
+        }
+
+        Point point;
+        point.x = (double)(cameraTicks - m_firstTicks) * m_nominalNsPerTick;
+        point.y = (double)(arrivalNs - m_firstHostNs);
+        point.valid = true;
+        int64_t window = (int64_t)(point.x / (double)m_windowNs);
+
+        if (m_current.valid && window != m_currentWindow)
+        {
+            m_windows.push_back(m_current);
+            if ((int)m_windows.size() > m_windowCount)
+                m_windows.erase(m_windows.begin());
+            m_current.valid = false;
+            Fit();
+        }
+        if (!m_current.valid || point.y - point.x < m_current.y - m_current.x)
+        {
+            m_current = point;
+            m_currentWindow = window;
+        }
+
+        if (!m_fitValid)
+        {
+            // Until two windows are complete: nominal rate through the lowest delay seen so far
+            m_refTicks = m_firstTicks + (uint64_t)(m_current.x / m_nominalNsPerTick);
+            m_refHostNs = m_firstHostNs + (uint64_t)m_current.y;
+        }
+    }
+
+    bool IsValid() const { return m_nsPerTick > 0.0 && m_current.valid; }
+    bool IsFitted() const { return m_fitValid; }
+    uint64_t GetSampleCount() const { return m_samples; }
+
+    // Host monotonic time (ns) of a camera timestamp
+    uint64_t ToHostNs(uint64_t cameraTicks) const
+    {
+        double delta = (double)(int64_t)(cameraTicks - m_refTicks) * m_nsPerTick;
+        return (uint64_t)((int64_t)m_refHostNs + (int64_t)llround(delta));
+    }
+
+    // Camera clock drift relative to the host clock in ppm (positive: camera runs fast).
+    // Relative to the bootstrapped rate if no tick frequency was given.
+    double GetDriftPpm() const
+    {
+        return (m_nsPerTick > 0.0) ? (m_nominalNsPerTick / m_nsPerTick - 1.0) * 1e6 : 0.0;
+    }
+
+    double GetNsPerTick() const { return m_nsPerTick; }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "Clock model: %s, %llu samples, %d windows, %.6f ns/tick, drift %+.3f ppm\n",
+            m_fitValid ? "fitted" : (IsValid() ? "nominal" : "not ready"), (unsigned long long)m_samples,
+            (int)m_windows.size(), m_nsPerTick, GetDriftPpm());
+    }
+
+private:
+    struct Point
+    {
+        double x;       // Camera time since first sample, nominal ns
+        double y;       // Host time since first sample, ns
+        bool valid;
+    };
+
+    void Fit()
+    {
+        if (m_windows.size() < 2)
+            return;
+
+        std::vector<Point> points(m_windows.begin(), m_windows.end());
+        double slope, intercept;
+        if (!LeastSquares(points, slope, intercept))
+            return;
+
+        // Drop the windows whose minimum is still far above the others (no quiet frame in that window)
+        std::vector<double> residuals(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+            residuals[i] = points[i].y - (slope * points[i].x + intercept);
+        std::vector<double> sorted(residuals);
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double median = sorted[sorted.size() / 2];
+        for (size_t i = 0; i < sorted.size(); i++)
+            sorted[i] = std::fabs(residuals[i] - median);
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double mad = sorted[sorted.size() / 2];
+
+        std::vector<Point> inliers;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (residuals[i] - median <= 3.0 * mad + 1.0)
+                inliers.push_back(points[i]);
+        }
+        if (inliers.size() >= 2)
+            LeastSquares(inliers, slope, intercept);
+
+        // Lower envelope: shift the line down to the lowest minimum
+        double lowest = 0.0;
+        for (size_t i = 0; i < inliers.size(); i++)
+        {
+            double residual = inliers[i].y - (slope * inliers[i].x + intercept);
+            if (i == 0 || residual < lowest)
+                lowest = residual;
+        }
+        intercept += lowest;
+
+        // Reference at the newest window keeps the deltas of ToHostNs() small
+        const Point &last = m_windows.back();
+        m_nsPerTick = slope * m_nominalNsPerTick;
+        m_refTicks = m_firstTicks + (uint64_t)llround(last.x / m_nominalNsPerTick);
+        m_refHostNs = m_firstHostNs + (uint64_t)llround(slope * last.x + intercept);
+        m_fitValid = true;
+    }
+
+    static bool LeastSquares(const std::vector<Point> &points, double &slope, double &intercept)
+    {
+        // Centered sums to keep the precision with large x
+        double n = (double)points.size();
+        double meanX = 0.0, meanY = 0.0;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            meanX += points[i].x;
+            meanY += points[i].y;
+        }
+        meanX /= n;
+        meanY /= n;
+        double sxx = 0.0, sxy = 0.0;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            sxx += (points[i].x - meanX) * (points[i].x - meanX);
+            sxy += (points[i].x - meanX) * (points[i].y - meanY);
+        }
+        if (sxx <= 0.0)
+            return false;
+        slope = sxy / sxx;
+        intercept = meanY - slope * meanX;
+        return true;
+    }
+
+    double m_nominalNsPerTick;
+    uint64_t m_windowNs;
+    int m_windowCount;
+
+    bool m_hasFirst;
+    uint64_t m_firstTicks;
+    uint64_t m_firstHostNs;
+    std::vector<Point> m_windows;
+    Point m_current;
+    int64_t m_currentWindow;
+
+    bool m_fitValid;
+    uint64_t m_refTicks;
+    uint64_t m_refHostNs;
+    double m_nsPerTick;
+    uint64_t m_samples;
+};
@@ -0,0 +1,201 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file CpuDispatch.h
+//
+//  \brief
+//  Runtime selection of the SIMD kernels for the CPU the program runs on.
+//
+//  Description: kernels compiled for the build machine (-march=native, -mavx2) stop with an
+//  illegal instruction on older PCs, kernels compiled for the oldest PC leave the newer ones
+//  idle. Instead, every SIMD variant is compiled with a target attribute (GCC, Clang) or as
+//  plain intrinsics (MSVC) into the same binary, and the first call of a kernel binds the fastest
+//  variant the CPU supports to a function pointer:
+//
+//      typedef void (*UnpackFunction)(const uint8_t *, uint16_t *, size_t);
+//      static const UnpackFunction function = SelectKernel<UnpackFunction>(
+//          UnpackScalar, UnpackSse42, UnpackAvx2, nullptr, nullptr);
+//
+//  Levels: scalar, SSE4.2 (with SSSE3), AVX2, AVX-512 (F and BW) and NEON (always present on
+//  64 bit ARM). A missing variant (nullptr) falls back to the next lower level.
+//
+//  The environment variable PF_SIMD=scalar|sse42|avx2|avx512|neon caps the level, e.g. to compare
+//  the variants on one machine ("PF_SIMD=sse42 ./PFCameraLib_ConfigAndGrab_Console_OpenCV").
+//  A level above what the CPU supports is ignored. PrintCpuDispatch() shows the detected and
+//  selected level.
+//
+//  memcpy() needs no entry here: the C runtime already selects its copy loop for the CPU.
+//
+*/
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PF_SIMD_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts the intrinsics of every level without compiler options
+#define PF_TARGET_SSE42
+#define PF_TARGET_AVX2
+#define PF_TARGET_AVX512
+#else
+#define PF_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define PF_TARGET_AVX2 __attribute__((target("avx2")))
+#define PF_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+#include <immintrin.h>
+#else
+#define PF_SIMD_X86 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define PF_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define PF_SIMD_NEON 0
+#endif
+
+enum CpuLevel
+{
+    CpuScalar = 0,
+    CpuSse42,
+    CpuAvx2,
+    CpuAvx512,
+    CpuNeon,
+};
+
+inline const char *CpuLevelName(CpuLevel level)
+{
+    switch (level)
+    {
+    case CpuSse42:  return "sse42";
+    case CpuAvx2:   return "avx2";
+    case CpuAvx512: return "avx512";
+    case CpuNeon:   return "neon";
+    default:        return "scalar";
+    }
+}
+
+// Highest level of the CPU (and operating system, which must save the wide registers)
+inline CpuLevel DetectCpuLevel()
+{
+#if PF_SIMD_X86 && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0 && (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!sse42)
+        return CpuScalar;
+    if (!osxsave || maxLeaf < 7)
+        return CpuSse42;
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+    bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (xcr0 & 0xE6) == 0xE6;
+    if (avx512 && avx2)
+        return CpuAvx512;
+    return avx2 ? CpuAvx2 : CpuSse42;
+#elif PF_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx2"))
+        return CpuAvx512;
+    if (__builtin_cpu_supports("avx2"))
+        return CpuAvx2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3"))
+        return CpuSse42;
+    return CpuScalar;
+#elif PF_SIMD_NEON
+    return CpuNeon;
+#else
+    return CpuScalar;
+#endif
+}
+
+// Detected level, capped by PF_SIMD. Evaluated once.
+inline CpuLevel GetCpuLevel()
+{
+    static const CpuLevel level = []()
+    {
+        CpuLevel detected = DetectCpuLevel();
+        const char *request = getenv("PF_SIMD");
+        if (request == nullptr || *request == '\0')
+            return detected;
+        for (int candidate = CpuScalar; candidate <= CpuNeon; candidate++)
+        {
+            if (strcmp(request, CpuLevelName((CpuLevel)candidate)) != 0)
+                continue;
+            // NEON and the x86 levels exclude each other, scalar runs everywhere
+            bool supported = candidate == CpuScalar ||
+                (candidate == CpuNeon ? detected == CpuNeon : (detected != CpuNeon && candidate <= detected));
+            if (supported)
+                return (CpuLevel)candidate;
+            fprintf(stderr, "PF_SIMD=%s is not supported by this CPU, using %s\n", request, CpuLevelName(detected));
+            return detected;
+        }
+        fprintf(stderr, "PF_SIMD=%s unknown, use scalar|sse42|avx2|avx512|neon\n", request);
+        return detected;
+    }();
+    return level;
+}
+
+// Fastest non null variant up to the selected level
+template <class Function>
+inline Function SelectKernel(Function scalar, Function sse42, Function avx2, Function avx512, Function neon)
+{
+    switch (GetCpuLevel())
+    {
+    case CpuAvx512:
+        if (avx512) return avx512;
+        // fall through
+    case CpuAvx2:
+        if (avx2) return avx2;
+        // fall through
+    case CpuSse42:
+        if (sse42) return sse42;
+        return scalar;
+    case CpuNeon:
+        return neon ? neon : scalar;
+    default:
+        return scalar;
+    }
+}
+
+inline void PrintCpuDispatch(FILE *out)
+{
+    fprintf(out, "SIMD kernels: %s (CPU supports %s, PF_SIMD=%s)\n", CpuLevelName(GetCpuLevel()),
+        CpuLevelName(DetectCpuLevel()), getenv("PF_SIMD") ? getenv("PF_SIMD") : "");
+}
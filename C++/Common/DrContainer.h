@@ -0,0 +1,364 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DrContainer.h
+//
+//  \brief
+//  File format for double rate (DR1) frames with a header describing the acquisition and an
+//  index of the frames, so any frame can be read directly.
+//
+//  Description: a plain .dr1 file is the modulated data only. The demodulated width is guessed
+//  from the data, the height from the file size, and "Window_W", the binning and whether the
+//  camera is a color model (DemodulateDR(isColor)) are lost. A DR container keeps them:
+//
+//      DrContainerHeader   64 bytes: magic, major and minor version, Window_W (after binning), modulated stride,
+//                          binning, flags, pixel format name, frame count and index offset
+//      per frame           DrContainerFrame record (32 bytes: data offset, timestamp, frame ID,
+//                          lines) followed by lines * modulatedStride bytes of modulated data
+//      index               one DrContainerFrame per frame, its offset is in the header
+//
+//  The frame count and the index are written by DrContainerWriter::Close(). A recording that was
+//  interrupted before has neither; DrContainerReader then rebuilds the index from the frame
+//  records (IsRecovered()). A newer minor version only appends fields to the header, readers
+//  accept it and skip the fields they do not know; a newer major version changes the layout and
+//  is rejected. Values are stored little endian, as all supported hosts are.
+//
+//      DrContainerWriter writer;
+//      writer.Open("capture.drc", MakeDrContainerHeader(Window_W, Width, FormatMono8, binX, binY, DrContainerColorCamera));
+//      writer.WriteFrame(pfBuffer->GetRawData(), Height, pfBuffer->GetTimestamp(), pfBuffer->GetFrameCounter());
+//      writer.Close();
+//
+//      DrContainerReader reader;
+//      if (reader.Open("capture.drc"))
+//          reader.ReadFrame(k, modImage);  // one seek, lines in reader.GetFrame(k).lines
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "PixelFormats.h"
+
+#ifdef WIN32
+#define DrContainerSeek _fseeki64
+#define DrContainerTell _ftelli64
+#else
+#define DrContainerSeek fseeko
+#define DrContainerTell ftello
+#endif
+
+static const char DrContainerMagic[8] = { 'P', 'F', 'D', 'R', 'C', '\r', '\n', '\x1a' };
+static const uint16_t DrContainerVersion = 1;
+static const uint16_t DrContainerMinorVersion = 0;
+
+enum DrContainerFlags
+{
+    DrContainerColorCamera = 1      // Demodulate with DemodulateDR(isColor = true)
+};
+
+struct DrContainerHeader
+{
+    char magic[8];
+    uint16_t version;               // Major version, readers reject a newer one
+    uint16_t minorVersion;          // Newer minor versions only append fields to the header
+    uint32_t headerBytes;
+    uint32_t windowWidth;           // Demodulated width: "Window_W" divided by the horizontal binning
+    uint32_t modulatedStride;       // Bytes of a modulated line: "Width" of the camera
+    uint32_t binningHorizontal;
+    uint32_t binningVertical;
+    uint32_t flags;
+    char pixelFormat[16];           // PixelFormats.h name of the demodulated image, e.g. "BayerGR8"
+    uint32_t frameCount;            // 0 until the writer is closed
+    uint64_t indexOffset;           // 0 until the writer is closed
+
+    bool IsColorCamera() const { return (flags & DrContainerColorCamera) != 0; }
+    FramePixelFormat GetPixelFormat() const { return ParsePixelFormat(pixelFormat); }
+};
+
+struct DrContainerFrame
+{
+    uint64_t offset;                // File offset of the modulated data
+    uint64_t timestamp;             // Camera timestamp (PFBuffer::GetTimestamp())
+    uint64_t frameId;               // Frame counter or block ID
+    uint32_t lines;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(DrContainerHeader) == 64, "DrContainerHeader is part of the file format");
+static_assert(sizeof(DrContainerFrame) == 32, "DrContainerFrame is part of the file format");
+
+inline DrContainerHeader MakeDrContainerHeader(uint32_t windowWidth, uint32_t modulatedStride, FramePixelFormat format,
+    uint32_t binningHorizontal = 1, uint32_t binningVertical = 1, uint32_t flags = 0)
+{
+    DrContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DrContainerMagic, sizeof(header.magic));
+    header.version = DrContainerVersion;
+    header.minorVersion = DrContainerMinorVersion;
+    header.headerBytes = sizeof(header);
+    header.windowWidth = windowWidth;
+    header.modulatedStride = modulatedStride;
+    header.binningHorizontal = binningHorizontal;
+    header.binningVertical = binningVertical;
+    header.flags = flags;
+    strncpy(header.pixelFormat, PixelFormatName(format), sizeof(header.pixelFormat) - 1);
+    return header;
+}
+
+class DrContainerWriter
+{
+public:
+    DrContainerWriter()
+        : m_file(nullptr)
+    {
+        memset(&m_header, 0, sizeof(m_header));
+    }
+
+    ~DrContainerWriter()
+    {
+        Close();
+    }
+
+    bool Open(const char *filename, const DrContainerHeader &header)
+    {
+        Close();
+        if (header.windowWidth == 0 || header.modulatedStride == 0)
+            return false;
+        m_file = fopen(filename, "wb");
+        if (m_file == nullptr)
+            return false;
+        m_header = header;
+        m_header.frameCount = 0;
+        m_header.indexOffset = 0;
+        m_index.clear();
+        return WriteHeader();
+    }
+
+    bool IsOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    // Appends lines modulated lines of modulatedStride bytes
+    bool WriteFrame(const uint8_t *modulated, uint32_t lines, uint64_t timestamp, uint64_t frameId)
+    {
+        if (m_file == nullptr || lines == 0)
+            return false;
+        DrContainerFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.offset = (uint64_t)DrContainerTell(m_file) + sizeof(frame);
+        frame.timestamp = timestamp;
+        frame.frameId = frameId;
+        frame.lines = lines;
+        size_t bytes = (size_t)lines * m_header.modulatedStride;
+        if (fwrite(&frame, sizeof(frame), 1, m_file) != 1 || fwrite(modulated, 1, bytes, m_file) != bytes)
+            return false;
+        m_index.push_back(frame);
+        return true;
+    }
+
+    uint32_t GetFrameCount() const
+    {
+        return (uint32_t)m_index.size();
+    }
+
+    // Writes the index and completes the header, false if the file could not be written
+    bool Close()
+    {
+        if (m_file == nullptr)
+            return false;
+        m_header.frameCount = (uint32_t)m_index.size();
+        m_header.indexOffset = (uint64_t)DrContainerTell(m_file);
+        bool ok = m_index.empty() || fwrite(m_index.data(), sizeof(DrContainerFrame), m_index.size(), m_file) == m_index.size();
+        ok = ok && DrContainerSeek(m_file, 0, SEEK_SET) == 0 && WriteHeader();
+        ok = (fclose(m_file) == 0) && ok;
+        m_file = nullptr;
+        return ok;
+    }
+
+private:
+    bool WriteHeader()
+    {
+        return fwrite(&m_header, sizeof(m_header), 1, m_file) == 1;
+    }
+
+    FILE *m_file;
+    DrContainerHeader m_header;
+    std::vector<DrContainerFrame> m_index;
+};
+
+class DrContainerReader
+{
+public:
+    DrContainerReader()
+        : m_file(nullptr), m_fileBytes(0), m_headerless(false), m_recovered(false), m_error("not opened")
+    {
+        memset(&m_header, 0, sizeof(m_header));
+    }
+
+    ~DrContainerReader()
+    {
+        Close();
+    }
+
+    // False for files that are not DR containers; IsHeaderless() tells a plain .dr1 file apart
+    bool Open(const char *filename)
+    {
+        Close();
+        m_headerless = false;
+        m_recovered = false;
+        m_file = fopen(filename, "rb");
+        if (m_file == nullptr)
+            return Fail("could not open the file");
+        DrContainerSeek(m_file, 0, SEEK_END);
+        m_fileBytes = (uint64_t)DrContainerTell(m_file);
+        DrContainerSeek(m_file, 0, SEEK_SET);
+
+        if (fread(&m_header, sizeof(m_header), 1, m_file) != 1 || memcmp(m_header.magic, DrContainerMagic, sizeof(m_header.magic)) != 0)
+        {
+            m_headerless = true;
+            return Fail("no DR container header (plain DR1 data)");
+        }
+        m_header.pixelFormat[sizeof(m_header.pixelFormat) - 1] = '\0';
+        if (m_header.version == 0 || m_header.version > DrContainerVersion)
+            return Fail("unsupported DR container version");
+        if (m_header.headerBytes < sizeof(m_header) || m_header.windowWidth == 0 || m_header.modulatedStride == 0)
+            return Fail("invalid DR container header");
+
+        if (m_header.indexOffset != 0 && ReadIndex())
+            return true;
+        // Interrupted recording: the index is rebuilt from the frame records
+        if (!ScanFrames())
+            return Fail("no frames");
+        m_recovered = true;
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_file != nullptr)
+            fclose(m_file);
+        m_file = nullptr;
+        m_index.clear();
+    }
+
+    const DrContainerHeader &GetHeader() const { return m_header; }
+    uint32_t GetFrameCount() const { return (uint32_t)m_index.size(); }
+    const DrContainerFrame &GetFrame(uint32_t index) const { return m_index[index]; }
+    size_t GetFrameBytes(uint32_t index) const { return (size_t)m_index[index].lines * m_header.modulatedStride; }
+    // Largest frame, the size of a buffer for ReadFrame() of any frame
+    size_t GetMaxFrameBytes() const
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < m_index.size(); i++)
+            bytes = std::max(bytes, (size_t)m_index[i].lines * m_header.modulatedStride);
+        return bytes;
+    }
+    bool IsHeaderless() const { return m_headerless; }
+    bool IsRecovered() const { return m_recovered; }
+    const char *GetError() const { return m_error; }
+
+    // Reads the modulated data of one frame into modulated (GetFrameBytes(index) bytes)
+    bool ReadFrame(uint32_t index, uint8_t *modulated)
+    {
+        if (m_file == nullptr || index >= m_index.size())
+            return false;
+        size_t bytes = GetFrameBytes(index);
+        return DrContainerSeek(m_file, (int64_t)m_index[index].offset, SEEK_SET) == 0 &&
+            fread(modulated, 1, bytes, m_file) == bytes;
+    }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "DR container v%u.%u: %u frames, Window_W %u, modulated stride %u, binning %ux%u, %s, %s camera%s\n",
+            (unsigned)m_header.version, (unsigned)m_header.minorVersion, GetFrameCount(), m_header.windowWidth, m_header.modulatedStride, m_header.binningHorizontal,
+            m_header.binningVertical, m_header.pixelFormat, m_header.IsColorCamera() ? "color" : "mono",
+            m_recovered ? " (index rebuilt, recording was not closed)" : "");
+    }
+
+private:
+    bool Fail(const char *error)
+    {
+        m_error = error;
+        Close();
+        return false;
+    }
+
+    bool IsValidFrame(const DrContainerFrame &frame) const
+    {
+        return frame.lines > 0 && frame.offset >= m_header.headerBytes + sizeof(DrContainerFrame) &&
+            frame.offset <= m_fileBytes && (uint64_t)frame.lines * m_header.modulatedStride <= m_fileBytes - frame.offset;
+    }
+
+    bool ReadIndex()
+    {
+        uint64_t indexBytes = (uint64_t)m_header.frameCount * sizeof(DrContainerFrame);
+        if (m_header.frameCount == 0 || m_header.indexOffset > m_fileBytes || indexBytes > m_fileBytes - m_header.indexOffset)
+            return false;
+        m_index.resize(m_header.frameCount);
+        if (DrContainerSeek(m_file, (int64_t)m_header.indexOffset, SEEK_SET) != 0 ||
+            fread(m_index.data(), sizeof(DrContainerFrame), m_index.size(), m_file) != m_index.size())
+            return false;
+        for (size_t i = 0; i < m_index.size(); i++)
+            if (!IsValidFrame(m_index[i]))
+                return false;
+        return true;
+    }
+
+    // Walks the frame records from the header on, up to the first incomplete frame
+    bool ScanFrames()
+    {
+        m_index.clear();
+        uint64_t position = m_header.headerBytes;
+        DrContainerFrame frame;
+        while (DrContainerSeek(m_file, (int64_t)position, SEEK_SET) == 0 && fread(&frame, sizeof(frame), 1, m_file) == 1)
+        {
+            if (frame.offset != position + sizeof(frame) || !IsValidFrame(frame))
+                break;
+            m_index.push_back(frame);
+            position = frame.offset + (uint64_t)frame.lines * m_header.modulatedStride;
+        }
+        return !m_index.empty();
+    }
+
+    FILE *m_file;
+    uint64_t m_fileBytes;
+    DrContainerHeader m_header;
+    std::vector<DrContainerFrame> m_index;
+    bool m_headerless;
+    bool m_recovered;
+    const char *m_error;
+};
@@ -0,0 +1,516 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DrDebayer.h
+//
+//  \brief
+//  Double rate demodulation and bilinear debayering of color frames in one pass over row strips,
+//  with optional white balance gains.
+//
+//  Description: a color double rate frame is demodulated into a Bayer mosaic (DemodulateDR(),
+//  pfDoubleRate_DeModulateImage()) and then converted to color in a second full frame pass. At
+//  full rate both passes stream the whole mosaic through main memory: written by the first,
+//  read back by the second.
+//
+//  FusedDrDebayer demodulates the frame in strips of a few rows into a scratch buffer sized to
+//  stay in the L2 cache and debayers every strip into the color image right away, so the mosaic
+//  never leaves the cache. The bilinear interpolation needs one row above and below: the last
+//  two demodulated rows of a strip are carried over to the next one, nothing is demodulated
+//  twice. Frame borders are mirrored, which keeps the Bayer phase.
+//
+//  The demodulation itself stays in the SDK and is passed in as a callback that demodulates a
+//  band of rows. This relies on the rows of a frame being demodulated independently of each
+//  other; the first Process() call checks it against a whole frame demodulation and falls back
+//  to demodulating the whole frame (then debayering it strip by strip) when the results differ
+//  (DrRowDemodulation.h).
+//
+//      FusedDrDebayer debayer;
+//      debayer.Prepare(modWidth, demodWidth, height, FormatBayerGR8);
+//      debayer.SetDemodulate([&](const uint8_t *mod, uint8_t *demod, uint32_t rows)
+//      {
+//          return pfDoubleRate_DeModulateImage(demod, (unsigned char*)mod, demodWidth, rows, modWidth)
+//              == PFDOUBLERATE_SUCCESS;
+//      });
+//      debayer.SetWhiteBalance(1.8f, 1.0f, 1.5f);
+//      debayer.Process(modImage, bgr, demodWidth * 3);
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "CpuDispatch.h"
+#include "DrRowDemodulation.h"
+#include "PixelFormats.h"
+
+// Channel order of the color pixels written by the debayering
+enum DebayerOrder
+{
+    DebayerBGR,     // OpenCV
+    DebayerRGB      // PixelRGB8
+};
+
+// White balance of the three channels (R, G, B): 8.8 fixed point gains for the SIMD kernels and
+// the same values as lookup tables for the scalar one, table[c][v] = min(v * gain, 255)
+struct DebayerGains
+{
+    uint16_t fixed[3];
+    uint8_t table[3][256];
+
+    DebayerGains()
+    {
+        Set(1.0f, 1.0f, 1.0f);
+    }
+
+    void Set(float red, float green, float blue)
+    {
+        const float gains[3] = { red, green, blue };
+        for (int c = 0; c < 3; c++)
+        {
+            float gain = std::min(std::max(gains[c], 0.0f), 255.99f);
+            fixed[c] = (uint16_t)(gain * 256.0f + 0.5f);
+            // (v * 256 + 128) * gain >> 16, rounded the same way as the SIMD multiply
+            for (uint32_t v = 0; v < 256; v++)
+                table[c][v] = (uint8_t)std::min<uint32_t>(((v * 256 + 128) * fixed[c]) >> 16, 255);
+        }
+    }
+};
+
+// Bilinear interpolation of one pixel, Site is the channel sampled at x (0 = R, 1 = G, 2 = B) and
+// RowColor the other channel of the line (0 or 2). rgb receives R, G, B.
+template <int Site, int RowColor>
+inline void DebayerBilinearPixel(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint32_t xl, uint32_t x, uint32_t xr, uint32_t rgb[3])
+{
+    if (Site == 1)
+    {
+        rgb[RowColor] = (line[xl] + line[xr] + 1) >> 1;
+        rgb[1] = line[x];
+        rgb[2 - RowColor] = (above[x] + below[x] + 1) >> 1;
+    }
+    else
+    {
+        rgb[Site] = line[x];
+        rgb[1] = (line[xl] + line[xr] + above[x] + below[x] + 2) >> 2;
+        rgb[2 - Site] = (above[xl] + above[xr] + below[xl] + below[xr] + 2) >> 2;
+    }
+}
+
+// Applies the white balance and stores the pixel, RedIndex is 2 for BGR and 0 for RGB
+template <int RedIndex>
+inline void DebayerStorePixel(const uint32_t rgb[3], const DebayerGains &gains, uint8_t *dst)
+{
+    dst[RedIndex] = gains.table[0][rgb[0]];
+    dst[1] = gains.table[1][rgb[1]];
+    dst[2 - RedIndex] = gains.table[2][rgb[2]];
+}
+
+// Columns [xBegin, xEnd) of a color line from a mosaic line and its neighbours (mirrored at the
+// top and bottom by the caller, the columns -1 and width are mirrored here). Even is the channel
+// of the even columns, RowColor the color channel of the line.
+template <int Even, int RowColor, int RedIndex>
+inline void DebayerBilinearColumnsT(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint8_t *dst, uint32_t width, uint32_t xBegin, uint32_t xEnd, const DebayerGains &gains)
+{
+    const int Odd = (Even == 1) ? RowColor : 1;
+    uint32_t rgb[3];
+    uint32_t x = xBegin;
+
+    // Pixels with a mirrored neighbour and the ones before the first odd column
+    for (; x < xEnd && (x == 0 || (x & 1) == 0 || x + 1 >= width); x++)
+    {
+        uint32_t xl = (x > 0) ? x - 1 : 1;
+        uint32_t xr = (x + 1 < width) ? x + 1 : x - 1;
+        if (x & 1)
+            DebayerBilinearPixel<Odd, RowColor>(above, line, below, xl, x, xr, rgb);
+        else
+            DebayerBilinearPixel<Even, RowColor>(above, line, below, xl, x, xr, rgb);
+        DebayerStorePixel<RedIndex>(rgb, gains, dst + 3 * x);
+    }
+    // Interior in pairs of an odd and an even column, the phase is fixed within the loop
+    for (; x + 1 < xEnd && x + 2 < width; x += 2)
+    {
+        DebayerBilinearPixel<Odd, RowColor>(above, line, below, x - 1, x, x + 1, rgb);
+        DebayerStorePixel<RedIndex>(rgb, gains, dst + 3 * x);
+        DebayerBilinearPixel<Even, RowColor>(above, line, below, x, x + 1, x + 2, rgb);
+        DebayerStorePixel<RedIndex>(rgb, gains, dst + 3 * (x + 1));
+    }
+    for (; x < xEnd; x++)
+    {
+        uint32_t xr = (x + 1 < width) ? x + 1 : x - 1;
+        if (x & 1)
+            DebayerBilinearPixel<Odd, RowColor>(above, line, below, x - 1, x, xr, rgb);
+        else
+            DebayerBilinearPixel<Even, RowColor>(above, line, below, x - 1, x, xr, rgb);
+        DebayerStorePixel<RedIndex>(rgb, gains, dst + 3 * x);
+    }
+}
+
+// Bayer pattern of a line: channel of the even columns and the color channel (R or B) of the line
+inline void DebayerLinePhase(FramePixelFormat pattern, uint32_t y, int &even, int &rowColor)
+{
+    bool redFirstLine = (pattern == FormatBayerGR8 || pattern == FormatBayerRG8);
+    bool greenFirst = (pattern == FormatBayerGR8 || pattern == FormatBayerGB8);
+    if (y & 1)
+    {
+        redFirstLine = !redFirstLine;
+        greenFirst = !greenFirst;
+    }
+    rowColor = redFirstLine ? 0 : 2;
+    even = greenFirst ? 1 : rowColor;
+}
+
+inline void DebayerBilinearColumns(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint8_t *dst, uint32_t width, uint32_t y, FramePixelFormat pattern, const DebayerGains &gains,
+    DebayerOrder order, uint32_t xBegin, uint32_t xEnd)
+{
+    int even, rowColor;
+    DebayerLinePhase(pattern, y, even, rowColor);
+    // One instantiation per line phase and channel order, nothing is decided per pixel
+    switch ((rowColor == 0 ? 0 : 2) + (even == 1 ? 0 : 1) + (order == DebayerBGR ? 0 : 4))
+    {
+    case 0: DebayerBilinearColumnsT<1, 0, 2>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 1: DebayerBilinearColumnsT<0, 0, 2>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 2: DebayerBilinearColumnsT<1, 2, 2>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 3: DebayerBilinearColumnsT<2, 2, 2>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 4: DebayerBilinearColumnsT<1, 0, 0>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 5: DebayerBilinearColumnsT<0, 0, 0>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    case 6: DebayerBilinearColumnsT<1, 2, 0>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    default: DebayerBilinearColumnsT<2, 2, 0>(above, line, below, dst, width, xBegin, xEnd, gains); break;
+    }
+}
+
+inline void DebayerBilinearLineScalar(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint8_t *dst, uint32_t width, uint32_t y, FramePixelFormat pattern, const DebayerGains &gains, DebayerOrder order)
+{
+    DebayerBilinearColumns(above, line, below, dst, width, y, pattern, gains, order, 0, width);
+}
+
+#if PF_SIMD_X86
+// (a + b + c + d + 2) >> 2 per byte
+PF_TARGET_SSE42 inline __m128i DebayerAverage4Sse42(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+        _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+        _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// min((v * 256 + 128) * gain >> 16, 255) per byte, as DebayerGains::table
+PF_TARGET_SSE42 inline __m128i DebayerGainSse42(__m128i v, __m128i gain)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i max = _mm_set1_epi16(255);
+    __m128i lo = _mm_mulhi_epu16(_mm_or_si128(_mm_unpacklo_epi8(zero, v), half), gain);
+    __m128i hi = _mm_mulhi_epu16(_mm_or_si128(_mm_unpackhi_epi8(zero, v), half), gain);
+    return _mm_packus_epi16(_mm_min_epu16(lo, max), _mm_min_epu16(hi, max));
+}
+
+// 16 pixels, three planes interleaved into 48 bytes
+PF_TARGET_SSE42 inline void DebayerStore16Sse42(__m128i p0, __m128i p1, __m128i p2, uint8_t *dst)
+{
+    const __m128i a0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i a1 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i a2 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i b0 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i b1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i b2 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i c0 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i c1 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i c2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+    _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, a0),
+        _mm_shuffle_epi8(p1, a1)), _mm_shuffle_epi8(p2, a2)));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, b0),
+        _mm_shuffle_epi8(p1, b1)), _mm_shuffle_epi8(p2, b2)));
+    _mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, c0),
+        _mm_shuffle_epi8(p1, c1)), _mm_shuffle_epi8(p2, c2)));
+}
+
+// Blocks of 16 columns starting at column 1, the border columns and the rest are scalar
+PF_TARGET_SSE42 inline void DebayerBilinearLineSse42(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint8_t *dst, uint32_t width, uint32_t y, FramePixelFormat pattern, const DebayerGains &gains, DebayerOrder order)
+{
+    int even, rowColor;
+    DebayerLinePhase(pattern, y, even, rowColor);
+    // A block starts on an odd column: lanes 0, 2, ... are odd columns
+    bool greenOdd = (even != 1);
+    const __m128i greenSites = greenOdd ? _mm_set1_epi16(0x00FF) : _mm_set1_epi16((short)0xFF00);
+    int redIndex = (order == DebayerBGR) ? 2 : 0;
+    const __m128i redGain = _mm_set1_epi16((short)gains.fixed[0]);
+    const __m128i greenGain = _mm_set1_epi16((short)gains.fixed[1]);
+    const __m128i blueGain = _mm_set1_epi16((short)gains.fixed[2]);
+
+    uint32_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        __m128i left = _mm_loadu_si128((const __m128i*)(line + x - 1));
+        __m128i center = _mm_loadu_si128((const __m128i*)(line + x));
+        __m128i right = _mm_loadu_si128((const __m128i*)(line + x + 1));
+        __m128i up = _mm_loadu_si128((const __m128i*)(above + x));
+        __m128i down = _mm_loadu_si128((const __m128i*)(below + x));
+        __m128i upLeft = _mm_loadu_si128((const __m128i*)(above + x - 1));
+        __m128i upRight = _mm_loadu_si128((const __m128i*)(above + x + 1));
+        __m128i downLeft = _mm_loadu_si128((const __m128i*)(below + x - 1));
+        __m128i downRight = _mm_loadu_si128((const __m128i*)(below + x + 1));
+
+        // Green sites: the line color from left and right, the other one from up and down.
+        // Color sites: green from the cross, the other color from the diagonals.
+        __m128i green = _mm_blendv_epi8(DebayerAverage4Sse42(left, right, up, down), center, greenSites);
+        __m128i lineColor = _mm_blendv_epi8(center, _mm_avg_epu8(left, right), greenSites);
+        __m128i otherColor = _mm_blendv_epi8(DebayerAverage4Sse42(upLeft, upRight, downLeft, downRight),
+            _mm_avg_epu8(up, down), greenSites);
+
+        __m128i red = _mm_setzero_si128(), blue = _mm_setzero_si128();
+        if (rowColor == 0)
+        {
+            red = DebayerGainSse42(lineColor, redGain);
+            blue = DebayerGainSse42(otherColor, blueGain);
+        }
+        else
+        {
+            red = DebayerGainSse42(otherColor, redGain);
+            blue = DebayerGainSse42(lineColor, blueGain);
+        }
+        green = DebayerGainSse42(green, greenGain);
+        if (redIndex == 2)
+            DebayerStore16Sse42(blue, green, red, dst + 3 * x);
+        else
+            DebayerStore16Sse42(red, green, blue, dst + 3 * x);
+    }
+    DebayerBilinearColumns(above, line, below, dst, width, y, pattern, gains, order, 0, 1);
+    DebayerBilinearColumns(above, line, below, dst, width, y, pattern, gains, order, x, width);
+}
+#endif
+
+// Debayers line y of the frame, above and below are the neighbouring mosaic lines
+inline void DebayerBilinearLine(const uint8_t *above, const uint8_t *line, const uint8_t *below,
+    uint8_t *dst, uint32_t width, uint32_t y, FramePixelFormat pattern, const DebayerGains &gains, DebayerOrder order)
+{
+    typedef void (*LineFunction)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, uint32_t, uint32_t,
+        FramePixelFormat, const DebayerGains&, DebayerOrder);
+#if PF_SIMD_X86
+    static const LineFunction function = SelectKernel<LineFunction>(DebayerBilinearLineScalar, DebayerBilinearLineSse42,
+        nullptr, nullptr, nullptr);
+#else
+    static const LineFunction function = DebayerBilinearLineScalar;
+#endif
+    function(above, line, below, dst, width, y, pattern, gains, order);
+}
+
+// Debayers the lines [rowBegin, rowEnd) of a whole mosaic frame (the two pass reference)
+inline void DebayerBilinear(const uint8_t *mosaic, size_t mosaicStride, uint32_t width, uint32_t height,
+    FramePixelFormat pattern, const DebayerGains &gains, DebayerOrder order,
+    uint8_t *color, size_t colorStride, uint32_t rowBegin = 0, uint32_t rowEnd = UINT32_MAX)
+{
+    rowEnd = std::min(rowEnd, height);
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+        const uint8_t *line = mosaic + y * mosaicStride;
+        const uint8_t *above = mosaic + ((y > 0) ? y - 1 : 1) * mosaicStride;
+        const uint8_t *below = mosaic + ((y + 1 < height) ? y + 1 : y - 1) * mosaicStride;
+        DebayerBilinearLine(above, line, below, color + y * colorStride, width, y, pattern, gains, order);
+    }
+}
+
+class FusedDrDebayer
+{
+public:
+    FusedDrDebayer()
+        : m_modStride(0), m_width(0), m_height(0), m_stripRows(0), m_pattern(FormatBayerGR8),
+          m_order(DebayerBGR)
+    {
+    }
+
+    // modStride: bytes of a modulated line; width, height: demodulated frame; pattern: Bayer
+    // pattern of the demodulated mosaic; stripRows 0 sizes the strips from DrStripBudgetBytes
+    bool Prepare(uint32_t modStride, uint32_t width, uint32_t height, FramePixelFormat pattern,
+        DebayerOrder order = DebayerBGR, uint32_t stripRows = 0)
+    {
+        if (width < 2 || height < 2 || modStride == 0)
+            return false;
+        if (pattern != FormatBayerGR8 && pattern != FormatBayerRG8 && pattern != FormatBayerGB8 && pattern != FormatBayerBG8)
+            return false;
+        m_modStride = modStride;
+        m_width = width;
+        m_height = height;
+        m_pattern = pattern;
+        m_order = order;
+        // Modulated input, mosaic and color output of a row
+        m_stripRows = (stripRows == 0) ? DrStripRows((size_t)modStride + 4 * (size_t)width, 8, height) :
+            std::min(std::max(stripRows, 8u), height);
+        // Two extra lines for the carried over neighbours
+        m_strip.assign((size_t)(m_stripRows + 2) * width, 0);
+        m_rowCheck.Reset();
+        return true;
+    }
+
+    void SetDemodulate(DrDemodulateRows demodulate)
+    {
+        m_demodulate = demodulate;
+    }
+
+    // Gains of the red, green and blue channels, applied after the interpolation
+    void SetWhiteBalance(float red, float green, float blue)
+    {
+        m_gains.Set(red, green, blue);
+    }
+
+    // Demodulates and debayers one frame into color (3 bytes per pixel, colorStride per line)
+    bool Process(const uint8_t *modulated, uint8_t *color, size_t colorStride)
+    {
+        if (!m_demodulate || m_strip.empty())
+            return false;
+        if (!m_rowCheck.IsChecked())
+            return CheckAndProcess(modulated, color, colorStride);
+        if (!m_rowCheck.IsIndependent())
+            return ProcessTwoPass(modulated, color, colorStride);
+        return ProcessStrips(modulated, color, colorStride, nullptr, nullptr);
+    }
+
+    // False when the first frame showed that rows can not be demodulated in strips
+    bool IsFused() const
+    {
+        return m_rowCheck.IsIndependent();
+    }
+
+    uint32_t GetStripRows() const
+    {
+        return m_stripRows;
+    }
+
+    const DebayerGains &GetGains() const
+    {
+        return m_gains;
+    }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "Color DR: %ux%u %s -> %s, gains R %.2f G %.2f B %.2f, ", m_width, m_height,
+            PixelFormatName(m_pattern), (m_order == DebayerBGR) ? "BGR8" : "RGB8",
+            m_gains.fixed[0] / 256.0, m_gains.fixed[1] / 256.0, m_gains.fixed[2] / 256.0);
+        if (!m_rowCheck.IsChecked())
+            fprintf(out, "strips of %u rows\n", m_stripRows);
+        else if (m_rowCheck.IsIndependent())
+            fprintf(out, "fused in strips of %u rows (%zu KB scratch)\n", m_stripRows, m_strip.size() / 1024);
+        else
+            fprintf(out, "rows do not demodulate independently, whole frame demodulation\n");
+    }
+
+private:
+    // reference: whole frame demodulation the strips are compared with (first frame only), matches
+    // is cleared when they differ. Returns false when the demodulation fails.
+    bool ProcessStrips(const uint8_t *modulated, uint8_t *color, size_t colorStride, const uint8_t *reference,
+        bool *matches)
+    {
+        uint8_t *strip = m_strip.data();
+        uint32_t base = 0;          // frame line of strip line 0
+        uint32_t demodulated = 0;   // frame lines demodulated so far
+        for (uint32_t y0 = 0; y0 < m_height; y0 += m_stripRows)
+        {
+            uint32_t y1 = std::min(y0 + m_stripRows, m_height);
+            if (y0 > 0)
+            {
+                // Keep the lines y0 - 1 and y0, demodulated with the previous strip
+                memmove(strip, strip + (size_t)(y0 - 1 - base) * m_width, (size_t)(demodulated - (y0 - 1)) * m_width);
+                base = y0 - 1;
+            }
+            // Lines up to y1 (the neighbour below the strip)
+            uint32_t end = std::min(y1 + 1, m_height);
+            if (end > demodulated)
+            {
+                uint8_t *target = strip + (size_t)(demodulated - base) * m_width;
+                if (!m_demodulate(modulated + (size_t)demodulated * m_modStride, target, end - demodulated))
+                    return false;
+                if (reference != nullptr &&
+                    memcmp(target, reference + (size_t)demodulated * m_width, (size_t)(end - demodulated) * m_width) != 0)
+                {
+                    *matches = false;
+                    return true;
+                }
+                demodulated = end;
+            }
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                const uint8_t *line = strip + (size_t)(y - base) * m_width;
+                const uint8_t *above = strip + (size_t)(((y > 0) ? y - 1 : 1) - base) * m_width;
+                const uint8_t *below = strip + (size_t)(((y + 1 < m_height) ? y + 1 : y - 1) - base) * m_width;
+                DebayerBilinearLine(above, line, below, color + y * colorStride, m_width, y, m_pattern, m_gains, m_order);
+            }
+        }
+        return true;
+    }
+
+    bool ProcessTwoPass(const uint8_t *modulated, uint8_t *color, size_t colorStride)
+    {
+        if (!m_rowCheck.DemodulateFrame(m_demodulate, modulated))
+            return false;
+        DebayerBilinear(m_rowCheck.GetReference(), m_width, m_width, m_height, m_pattern, m_gains, m_order, color, colorStride);
+        return true;
+    }
+
+    // First frame: demodulates it whole and in strips, the strips are only used when they match.
+    // A demodulation error leaves the check open for the next frame.
+    bool CheckAndProcess(const uint8_t *modulated, uint8_t *color, size_t colorStride)
+    {
+        if (!m_rowCheck.DemodulateReference(m_demodulate, modulated, m_width, m_height))
+            return false;
+        bool matches = true;
+        if (!ProcessStrips(modulated, color, colorStride, m_rowCheck.GetReference(), &matches))
+            return false;
+        if (!matches)
+            DebayerBilinear(m_rowCheck.GetReference(), m_width, m_width, m_height, m_pattern, m_gains, m_order, color, colorStride);
+        m_rowCheck.SetResult(matches);
+        return true;
+    }
+
+    uint32_t m_modStride;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_stripRows;
+    FramePixelFormat m_pattern;
+    DebayerOrder m_order;
+    DebayerGains m_gains;
+    DrDemodulateRows m_demodulate;
+    std::vector<uint8_t> m_strip;
+    DrRowCheck m_rowCheck;
+};
@@ -0,0 +1,214 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DrRoiDemodulator.h
+//
+//  \brief
+//  Demodulation of a rectangle of a double rate frame into a compact image.
+//
+//  Description: pfDoubleRate_DeModulateImage() and DemodulateDR() always demodulate the whole
+//  frame, also when only a band of it is inspected. DrRoiDemodulator passes only the modulated
+//  lines of the rectangle to the demodulation, the cost follows the height of the rectangle.
+//
+//  The columns can not be reduced the same way: the modulation of a line interleaves pixels from
+//  all over the line and the demodulation is a closed library that works on whole lines. The
+//  lines of the rectangle are demodulated in full width into a small scratch strip and only the
+//  columns of the rectangle are copied to the output. A rectangle of full width with a
+//  contiguous output is demodulated in place, without a copy.
+//
+//  Like FusedDrDebayer (DrDebayer.h) this relies on the lines of a frame being demodulated
+//  independently of each other. The first Process() call after Prepare() or a new rectangle
+//  compares the rectangle with a whole frame demodulation and, when they differ, keeps
+//  demodulating the whole frame and cropping it (DrRowDemodulation.h).
+//
+//      DrRoiDemodulator roi;
+//      roi.Prepare(modWidth, demodWidth, height);
+//      roi.SetDemodulate(demodulateRows);
+//      roi.SetRegion(0, 1000, demodWidth, 64);
+//      roi.Process(modImage, band, demodWidth);
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "DrRowDemodulation.h"
+
+class DrRoiDemodulator
+{
+public:
+    DrRoiDemodulator()
+        : m_modStride(0), m_width(0), m_height(0), m_x(0), m_y(0), m_roiWidth(0), m_roiHeight(0)
+    {
+    }
+
+    // modStride: bytes of a modulated line; width, height: demodulated frame (one byte per pixel)
+    bool Prepare(uint32_t modStride, uint32_t width, uint32_t height)
+    {
+        if (modStride == 0 || width == 0 || height == 0)
+            return false;
+        m_modStride = modStride;
+        m_width = width;
+        m_height = height;
+        // Scratch strip of full width lines for rectangles narrower than the frame: modulated
+        // input, demodulated line and cropped output of a row
+        m_strip.assign((size_t)DrStripRows((size_t)modStride + 2 * (size_t)width, 1, height) * width, 0);
+        m_rowCheck.Reset();
+        return SetRegion(0, 0, width, height);
+    }
+
+    void SetDemodulate(DrDemodulateRows demodulate)
+    {
+        m_demodulate = demodulate;
+    }
+
+    // Rectangle in demodulated pixels, false when it is empty or does not fit into the frame.
+    // A new rectangle is checked again with the next frame.
+    bool SetRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+    {
+        if (width == 0 || height == 0 || x >= m_width || y >= m_height ||
+            width > m_width - x || height > m_height - y)
+            return false;
+        if (x != m_x || y != m_y || width != m_roiWidth || height != m_roiHeight)
+            m_rowCheck.Reset();
+        m_x = x;
+        m_y = y;
+        m_roiWidth = width;
+        m_roiHeight = height;
+        return true;
+    }
+
+    // Demodulates the rectangle of one frame into dst, dstStride bytes per output line
+    bool Process(const uint8_t *modulated, uint8_t *dst, size_t dstStride)
+    {
+        if (!m_demodulate || m_strip.empty())
+            return false;
+        if (!m_rowCheck.IsChecked())
+            return CheckAndProcess(modulated, dst, dstStride);
+        if (!m_rowCheck.IsIndependent())
+            return ProcessFrame(modulated, dst, dstStride);
+        return ProcessRows(modulated, dst, dstStride);
+    }
+
+    // False when the first frame showed that lines can not be demodulated on their own
+    bool IsReduced() const
+    {
+        return m_rowCheck.IsIndependent();
+    }
+
+    uint32_t GetWidth() const
+    {
+        return m_roiWidth;
+    }
+
+    uint32_t GetHeight() const
+    {
+        return m_roiHeight;
+    }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "ROI demodulation: %ux%u at (%u, %u) of %ux%u, ", m_roiWidth, m_roiHeight, m_x, m_y, m_width, m_height);
+        if (m_rowCheck.IsChecked() && !m_rowCheck.IsIndependent())
+            fprintf(out, "lines do not demodulate independently, whole frame demodulation\n");
+        else
+            fprintf(out, "%.1f%% of the lines demodulated%s\n", 100.0 * m_roiHeight / m_height,
+                (m_roiWidth == m_width) ? "" : ", columns cropped");
+    }
+
+private:
+    bool ProcessRows(const uint8_t *modulated, uint8_t *dst, size_t dstStride)
+    {
+        const uint8_t *source = modulated + (size_t)m_y * m_modStride;
+        // Full lines into a contiguous output need no scratch
+        if (m_roiWidth == m_width && dstStride == m_width)
+            return m_demodulate(source, dst, m_roiHeight);
+
+        uint32_t stripRows = (uint32_t)(m_strip.size() / m_width);
+        for (uint32_t row = 0; row < m_roiHeight; row += stripRows)
+        {
+            uint32_t rows = std::min(stripRows, m_roiHeight - row);
+            if (!m_demodulate(source + (size_t)row * m_modStride, m_strip.data(), rows))
+                return false;
+            for (uint32_t r = 0; r < rows; r++)
+                memcpy(dst + (row + r) * dstStride, m_strip.data() + (size_t)r * m_width + m_x, m_roiWidth);
+        }
+        return true;
+    }
+
+    bool ProcessFrame(const uint8_t *modulated, uint8_t *dst, size_t dstStride)
+    {
+        if (!m_rowCheck.DemodulateFrame(m_demodulate, modulated))
+            return false;
+        CropFrame(dst, dstStride);
+        return true;
+    }
+
+    void CropFrame(uint8_t *dst, size_t dstStride) const
+    {
+        for (uint32_t r = 0; r < m_roiHeight; r++)
+            memcpy(dst + r * dstStride, m_rowCheck.GetReference() + (size_t)(m_y + r) * m_width + m_x, m_roiWidth);
+    }
+
+    // First frame of a rectangle: it is compared with the crop of a whole frame demodulation.
+    // A demodulation error leaves the check open for the next frame.
+    bool CheckAndProcess(const uint8_t *modulated, uint8_t *dst, size_t dstStride)
+    {
+        if (!m_rowCheck.DemodulateReference(m_demodulate, modulated, m_width, m_height))
+            return false;
+        if (!ProcessRows(modulated, dst, dstStride))
+            return false;
+        bool matches = true;
+        for (uint32_t r = 0; matches && r < m_roiHeight; r++)
+            matches = memcmp(dst + r * dstStride, m_rowCheck.GetReference() + (size_t)(m_y + r) * m_width + m_x, m_roiWidth) == 0;
+        if (!matches)
+            CropFrame(dst, dstStride);
+        m_rowCheck.SetResult(matches);
+        return true;
+    }
+
+    uint32_t m_modStride;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_x;
+    uint32_t m_y;
+    uint32_t m_roiWidth;
+    uint32_t m_roiHeight;
+    DrDemodulateRows m_demodulate;
+    std::vector<uint8_t> m_strip;
+    DrRowCheck m_rowCheck;
+};
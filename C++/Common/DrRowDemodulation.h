@@ -0,0 +1,124 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DrRowDemodulation.h
+//
+//  \brief
+//  Demodulation of double rate frames in bands of rows, with the check that a band gives the same
+//  lines as a whole frame demodulation.
+//
+//  Description: FusedDrDebayer (DrDebayer.h) and DrRoiDemodulator (DrRoiDemodulator.h) pass only
+//  some rows of a frame at a time to the demodulation of the SDK. That is only correct when the
+//  rows of a frame are demodulated independently of each other, which the SDK does not promise.
+//  DrRowCheck holds the state of the check both of them run on their first frame:
+//
+//  1. DemodulateReference() demodulates the whole frame. A failure is an error of that frame,
+//     the check stays open and is repeated with the next one.
+//  2. The caller demodulates its bands and compares them with GetReference().
+//  3. SetResult() records the outcome. When the bands differ, the reference buffer is kept and
+//     DemodulateFrame() fills it for every following frame (the fallback); otherwise it is freed.
+//
+//  Reset() starts over, e.g. when the region of the bands changes.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Demodulates rows lines of modulated data (modulated stride) into demodulated (width stride)
+typedef std::function<bool(const uint8_t *modulated, uint8_t *demodulated, uint32_t rows)> DrDemodulateRows;
+
+// Scratch budget of a strip: the modulated input, the demodulated lines and the output of a strip
+// should stay in the L2 cache
+static const size_t DrStripBudgetBytes = 512 * 1024;
+
+// Rows of a strip for bytesPerRow of input, scratch and output per row, at least minimumRows
+inline uint32_t DrStripRows(size_t bytesPerRow, uint32_t minimumRows, uint32_t height)
+{
+    uint32_t rows = (uint32_t)(DrStripBudgetBytes / std::max<size_t>(bytesPerRow, 1));
+    return std::min(std::max(rows, minimumRows), height);
+}
+
+class DrRowCheck
+{
+public:
+    DrRowCheck()
+        : m_height(0), m_checked(false), m_independent(true)
+    {
+    }
+
+    void Reset()
+    {
+        std::vector<uint8_t>().swap(m_frame);
+        m_checked = false;
+        m_independent = true;
+    }
+
+    bool IsChecked() const { return m_checked; }
+    // True until a check showed that bands differ from the whole frame
+    bool IsIndependent() const { return m_independent; }
+
+    // Whole frame demodulation of the frame the bands are checked on. False if it failed.
+    bool DemodulateReference(const DrDemodulateRows &demodulate, const uint8_t *modulated, uint32_t width, uint32_t height)
+    {
+        m_frame.assign((size_t)width * height, 0);
+        m_height = height;
+        return demodulate(modulated, m_frame.data(), height);
+    }
+
+    const uint8_t *GetReference() const { return m_frame.data(); }
+
+    // Outcome of the comparison; the whole frame buffer is only kept for the fallback
+    void SetResult(bool independent)
+    {
+        m_checked = true;
+        m_independent = independent;
+        if (independent)
+            std::vector<uint8_t>().swap(m_frame);
+    }
+
+    // Fallback after a failed check: the whole frame, read with GetReference()
+    bool DemodulateFrame(const DrDemodulateRows &demodulate, const uint8_t *modulated)
+    {
+        return demodulate(modulated, m_frame.data(), m_height);
+    }
+
+private:
+    std::vector<uint8_t> m_frame;
+    uint32_t m_height;
+    bool m_checked;
+    bool m_independent;
+};
@@ -0,0 +1,147 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DrStreamSynthesizer.h
+//
+//  \brief
+//  Multi frame double rate (DR1) streams of any height and length made from captured frames, to
+//  benchmark the demodulation at realistic data volumes without a camera.
+//
+//  Description: the double rate modulation is done by the camera and is not documented;
+//  pfDoubleRate_GetModulatedWidth() gives the length of a modulated line, not how pixels are
+//  coded into it (the captured data is not a rearrangement of 8 bit pixels). New DR data can
+//  therefore not be made from arbitrary images. What the demodulation does allow is recombining
+//  captured lines: a modulated line is demodulated on its own, so lines of captured frames can be
+//  put together into new frames.
+//
+//  DrStreamSynthesizer keeps the lines of one or more captured frames of the same width and makes
+//  frame n of a stream from them: the first two lines are always the first two captured lines
+//  (pfDoubleRate_GetDeModulatedWidth() reads the start of the frame), the others cycle through
+//  the captured lines from a start that moves by an even number of lines per frame. Even lines
+//  stay even, which keeps the layout of color frames, and consecutive frames differ, so a cache
+//  can not hold a repeated frame.
+//
+//  GetSourceLine() tells which captured line a synthetic line came from; demodulating both and
+//  comparing checks that the synthetic frames are valid DR data.
+//
+//      DrStreamSynthesizer synthesizer;
+//      synthesizer.AddFrame(modImage, modWidth, Height);
+//      for (uint64_t n = 0; n < frames; n++)
+//      {
+//          synthesizer.MakeFrame(n, 3072, frame);
+//          fwrite(frame, 1, (size_t)modWidth * 3072, stream);
+//      }
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+class DrStreamSynthesizer
+{
+public:
+    // Lines shared by every synthetic frame, the start of the frame
+    static const uint32_t HeadLines = 2;
+
+    DrStreamSynthesizer()
+        : m_modStride(0), m_lines(0)
+    {
+    }
+
+    // Adds the lines of a captured modulated frame, all frames must have the same line length.
+    // False for a frame of another line length or of less than two lines.
+    bool AddFrame(const uint8_t *modulated, uint32_t modStride, uint32_t lines)
+    {
+        if (modStride == 0 || lines == 0 || (m_modStride != 0 && modStride != m_modStride))
+            return false;
+        m_modStride = modStride;
+        // An odd line count would put the next frame's even lines on odd positions
+        lines &= ~1u;
+        if (lines == 0)
+            return false;
+        m_data.insert(m_data.end(), modulated, modulated + (size_t)modStride * lines);
+        m_lines += lines;
+        return true;
+    }
+
+    uint32_t GetModulatedStride() const
+    {
+        return m_modStride;
+    }
+
+    uint32_t GetSourceLines() const
+    {
+        return m_lines;
+    }
+
+    // Captured line that line y of frame n is made of
+    uint32_t GetSourceLine(uint64_t n, uint32_t y) const
+    {
+        if (m_lines == 0)
+            return 0;
+        if (y < HeadLines || m_lines <= HeadLines)
+            return y % m_lines;
+        uint32_t cycle = m_lines - HeadLines;
+        // The start moves by 74 lines per frame, even, and stays even modulo the even cycle
+        uint64_t start = (n * 74) % cycle;
+        return HeadLines + (uint32_t)((start + (y - HeadLines)) % cycle);
+    }
+
+    const uint8_t *GetLine(uint32_t sourceLine) const
+    {
+        return m_data.data() + (size_t)sourceLine * m_modStride;
+    }
+
+    // Frame n with height lines into modulated (height * modStride bytes), false without captured lines
+    bool MakeFrame(uint64_t n, uint32_t height, uint8_t *modulated) const
+    {
+        if (m_lines == 0)
+            return false;
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(modulated + (size_t)y * m_modStride, GetLine(GetSourceLine(n, y)), m_modStride);
+        return true;
+    }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "DR stream synthesizer: %u captured lines of %u bytes\n", m_lines, m_modStride);
+    }
+
+private:
+    uint32_t m_modStride;
+    uint32_t m_lines;
+    std::vector<uint8_t> m_data;
+};
@@ -0,0 +1,231 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file FrameBufferPool.h
+//
+//  \brief
+//  Frame memory allocated once before the acquisition starts, so no page fault happens while
+//  frames are being processed.
+//
+//  Description: memory returned by malloc() or ReserveImage() is only mapped by the kernel when
+//  it is written for the first time. Each 4 KB page then costs a page fault (and zeroing) in the
+//  middle of the acquisition, which is enough to lose frames in the first seconds of a recording.
+//  The pool avoids this:
+//
+//  1. One block for all frames, backed by 2 MB huge pages if available (MAP_HUGETLB, then
+//     transparent huge pages with madvise()), with normal pages as fallback.
+//  2. Every frame starts on a 64 byte boundary (cache line, AVX-512 register width).
+//  3. All pages are written once at allocation and locked with mlock() (VirtualLock() on Windows),
+//     so they cannot be swapped out. Locking needs a sufficient RLIMIT_MEMLOCK ("ulimit -l");
+//     if it fails the pool still works with pre-faulted pages and reports it.
+//
+//  The ring buffers of PFStream are allocated by the SDK; the pool is for the memory the
+//  application owns, such as demodulation targets, conversions and recording queues.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class FrameBufferPool
+{
+public:
+    static const size_t Alignment = 64;
+    static const size_t HugePageSize = 2 * 1024 * 1024;
+
+    FrameBufferPool()
+        : m_memory(nullptr), m_mappedBytes(0), m_frameBytes(0), m_frameStride(0), m_frameCount(0),
+          m_hugePages(false), m_locked(false)
+    {
+    }
+
+    ~FrameBufferPool()
+    {
+        Release();
+    }
+
+    // Allocates, pre-faults and optionally locks frameCount frames of frameBytes each
+    bool Allocate(size_t frameBytes, int frameCount, bool useHugePages = true, bool lockMemory = true)
+    {
+        Release();
+        if (frameBytes == 0 || frameCount <= 0)
+            return false;
+
+        m_frameBytes = frameBytes;
+        m_frameStride = (frameBytes + Alignment - 1) & ~(Alignment - 1);
+        m_frameCount = frameCount;
+        size_t totalBytes = m_frameStride * (size_t)frameCount;
+
+#ifdef WIN32
+        (void)useHugePages;
+        m_mappedBytes = totalBytes;
+        m_memory = (uint8_t *)VirtualAlloc(NULL, m_mappedBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (m_memory == nullptr)
+            return false;
+        Touch();
+        if (lockMemory)
+        {
+            // The working set must be large enough to lock the whole pool
+            SIZE_T minimum, maximum;
+            HANDLE process = GetCurrentProcess();
+            if (GetProcessWorkingSetSize(process, &minimum, &maximum))
+                SetProcessWorkingSetSize(process, minimum + m_mappedBytes, maximum + m_mappedBytes);
+            m_locked = VirtualLock(m_memory, m_mappedBytes) != 0;
+        }
+#else
+        void *memory = MAP_FAILED;
+        if (useHugePages)
+        {
+#ifdef MAP_HUGETLB
+            // Explicit huge pages, only if the administrator reserved them (vm.nr_hugepages)
+            m_mappedBytes = (totalBytes + HugePageSize - 1) & ~(HugePageSize - 1);
+            memory = mmap(NULL, m_mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            m_hugePages = (memory != MAP_FAILED);
+#endif
+        }
+        if (memory == MAP_FAILED)
+        {
+            size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+            m_mappedBytes = (totalBytes + pageSize - 1) & ~(pageSize - 1);
+            memory = mmap(NULL, m_mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+            {
+                memory = nullptr;
+                m_mappedBytes = 0;
+                return false;
+            }
+#ifdef MADV_HUGEPAGE
+            // Transparent huge pages, must be requested before the pages are touched
+            if (useHugePages)
+                madvise(memory, m_mappedBytes, MADV_HUGEPAGE);
+#endif
+        }
+        m_memory = (uint8_t *)memory;
+        Touch();
+        if (lockMemory)
+            m_locked = (mlock(m_memory, m_mappedBytes) == 0);
+#endif
+
+        m_free.clear();
+        for (int i = frameCount - 1; i >= 0; i--)
+            m_free.push_back(i);
+        return true;
+    }
+
+    void Release()
+    {
+        if (m_memory == nullptr)
+            return;
+#ifdef WIN32
+        if (m_locked)
+            VirtualUnlock(m_memory, m_mappedBytes);
+        VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+        if (m_locked)
+            munlock(m_memory, m_mappedBytes);
+        munmap(m_memory, m_mappedBytes);
+#endif
+        m_memory = nullptr;
+        m_mappedBytes = 0;
+        m_frameCount = 0;
+        m_hugePages = false;
+        m_locked = false;
+        m_free.clear();
+    }
+
+    // Direct access to frame i
+    uint8_t *GetFrame(int index) const
+    {
+        return (index >= 0 && index < m_frameCount) ? m_memory + (size_t)index * m_frameStride : nullptr;
+    }
+
+    // Takes a free frame, nullptr if all frames are in use
+    uint8_t *Acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.empty())
+            return nullptr;
+        int index = m_free.back();
+        m_free.pop_back();
+        return GetFrame(index);
+    }
+
+    // Gives back a frame taken with Acquire()
+    void Return(uint8_t *frame)
+    {
+        if (frame == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back((int)((size_t)(frame - m_memory) / m_frameStride));
+    }
+
+    size_t GetFrameBytes() const { return m_frameBytes; }
+    size_t GetFrameStride() const { return m_frameStride; }
+    int GetFrameCount() const { return m_frameCount; }
+    bool IsHugePages() const { return m_hugePages; }
+    bool IsLocked() const { return m_locked; }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "Frame pool: %d x %zu bytes, %.1f MB, %s pages, %s\n", m_frameCount, m_frameBytes,
+            m_mappedBytes / (1024.0 * 1024.0), m_hugePages ? "2 MB huge" : "normal",
+            m_locked ? "locked" : "not locked (check ulimit -l)");
+    }
+
+private:
+    // Writes every page once so the kernel maps it now and not during the acquisition
+    void Touch()
+    {
+        memset(m_memory, 0, m_mappedBytes);
+    }
+
+    uint8_t *m_memory;
+    size_t m_mappedBytes;
+    size_t m_frameBytes;
+    size_t m_frameStride;
+    int m_frameCount;
+    bool m_hugePages;
+    bool m_locked;
+    std::mutex m_mutex;
+    std::vector<int> m_free;
+};
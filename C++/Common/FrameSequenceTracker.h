@@ -0,0 +1,256 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file FrameSequenceTracker.h
+//
+//  \brief
+//  Frame loss accounting based on the frame counter (block ID) of every received buffer.
+//
+//  Description: the tracker is fed with the frame counter and the host arrival time of each buffer
+//  returned by PFStream::GetNextBuffer(). It takes care of:
+//
+//  1. Counter wraparound. GigE Vision block IDs are 16 bit and skip 0 (65535 is followed by 1).
+//     If a counter above the configured maximum is seen (U3V uses 64 bit block IDs) the tracker
+//     switches to 64 bit arithmetic automatically.
+//  2. Stream restarts. A jump backwards, or forwards by more than half of the counter range, is
+//     counted as a restart instead of as lost frames. Call Restart() after Freeze()/Grab().
+//  3. Burst statistics. Consecutive lost frames are accumulated in a power of two histogram of
+//     burst lengths, which tells single packet drops apart from stalls of the consumer.
+//  4. Inter-frame intervals. Arrival intervals are recorded in a LatencyHistogram so the report
+//     shows percentiles of the host side cadence.
+//
+//  CrossCheck() compares the own count with StreamStatistics::m_lostFrames reported by the SDK.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cinttypes>
+
+#include "LatencyHistogram.h"
+
+class FrameSequenceTracker
+{
+public:
+    // Bursts of 1, 2, 3-4, 5-8, ... 16385-32768 and longer
+    static const int BurstBucketCount = 17;
+
+    FrameSequenceTracker(uint64_t counterMax = 65535, bool skipZero = true)
+        : m_counterMax(counterMax), m_skipZero(skipZero)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_wide = false;
+        m_hasLast = false;
+        m_lastCounter = 0;
+        m_lastArrivalNs = 0;
+        m_received = 0;
+        m_lost = 0;
+        m_duplicates = 0;
+        m_wraps = 0;
+        m_restarts = 0;
+        for (int i = 0; i < BurstBucketCount; i++)
+            m_bursts[i] = 0;
+        m_intervals.Reset();
+    }
+
+    // Call after the acquisition has been restarted (Freeze() and Grab() again).
+    // The next frame is taken as a new reference and the gap is not counted as lost.
+    void Restart()
+    {
+        if (m_hasLast)
+            m_restarts++;
+        m_hasLast = false;
+    }
+
+    // Accounts one received buffer. Returns the number of frames lost right before it.
+    uint64_t Update(int64_t frameCounter, uint64_t arrivalNs)
+    {
+        uint64_t counter = (uint64_t)frameCounter;
+        uint64_t lost = 0;
+
+        if (!m_wide && counter > m_counterMax)
+            m_wide = true;
+
+        if (m_hasLast)
+        {
+            uint64_t distance = Distance(m_lastCounter, counter);
+            if (distance == 0)
+            {
+                // Same block ID again (resend); neither new nor lost
+                m_duplicates++;
+                return 0;
+            }
+            else if (distance > HalfRange())
+            {
+                // Backwards or far away: the camera counter was reset
+                m_restarts++;
+            }
+            else
+            {
+                if (counter < m_lastCounter)
+                    m_wraps++;
+                lost = distance - 1;
+                if (lost)
+                {
+                    m_lost += lost;
+                    m_bursts[BurstBucket(lost)]++;
+                }
+                m_intervals.Record(arrivalNs - m_lastArrivalNs);
+            }
+        }
+
+        m_hasLast = true;
+        m_lastCounter = counter;
+        m_lastArrivalNs = arrivalNs;
+        m_received++;
+        return lost;
+    }
+
+    uint64_t GetReceived() const { return m_received; }
+    uint64_t GetLost() const { return m_lost; }
+    uint64_t GetDuplicates() const { return m_duplicates; }
+    uint64_t GetWraps() const { return m_wraps; }
+    uint64_t GetRestarts() const { return m_restarts; }
+    uint64_t GetBurstCount(int bucket) const { return m_bursts[bucket]; }
+    const LatencyHistogram &GetIntervals() const { return m_intervals; }
+
+    // Difference between the frames counted as lost by the tracker and by the SDK.
+    // A positive value means the tracker saw gaps the stream did not report (e.g. frames
+    // dropped because the ring buffer was full); a negative value means the SDK counted
+    // frames as lost that were still delivered, typically corrupt frames.
+    int64_t CrossCheck(uint64_t sdkLostFrames) const
+    {
+        return (int64_t)m_lost - (int64_t)sdkLostFrames;
+    }
+
+    void PrintReport(FILE *out, uint64_t sdkLostFrames) const
+    {
+        uint64_t expected = m_received + m_lost;
+        fprintf(out, "Frames received: %" PRIu64 " Lost: %" PRIu64 " (%.3f%%) Duplicates: %" PRIu64
+            " Wraps: %" PRIu64 " Restarts: %" PRIu64 "\n",
+            m_received, m_lost, expected ? m_lost * 100.0 / (double)expected : 0.0,
+            m_duplicates, m_wraps, m_restarts);
+
+        if (m_lost)
+        {
+            fprintf(out, "Lost frame bursts (length: count):");
+            for (int i = 0; i < BurstBucketCount; i++)
+            {
+                if (m_bursts[i] == 0)
+                    continue;
+                uint64_t low = (i == 0) ? 1 : (1ull << (i - 1)) + 1;
+                uint64_t high = 1ull << i;
+                if (i == BurstBucketCount - 1)
+                    fprintf(out, " >%" PRIu64 ": %" PRIu64, low - 1, m_bursts[i]);
+                else if (low == high)
+                    fprintf(out, " %" PRIu64 ": %" PRIu64, low, m_bursts[i]);
+                else
+                    fprintf(out, " %" PRIu64 "-%" PRIu64 ": %" PRIu64, low, high, m_bursts[i]);
+            }
+            fprintf(out, "\n");
+        }
+
+        m_intervals.Print(out, "Frame interval");
+
+        int64_t difference = CrossCheck(sdkLostFrames);
+        if (difference == 0)
+            fprintf(out, "Lost frames match stream statistics (%" PRIu64 ")\n", sdkLostFrames);
+        else
+            fprintf(out, "Lost frames differ from stream statistics: tracker %" PRIu64 " stream %" PRIu64 " (%+" PRId64 ")\n",
+                m_lost, sdkLostFrames, difference);
+    }
+
+    // Forward distance from last to current counter, modulo the counter range
+    uint64_t Distance(uint64_t last, uint64_t current) const
+    {
+        if (m_wide)
+            return current - last;
+        uint64_t range = Range();
+        uint64_t from = (last < First()) ? 0 : last - First();
+        uint64_t to = (current < First()) ? 0 : current - First();
+        return (to + range - from) % range;
+    }
+
+    // True if current is ahead of last by less than half of the counter range
+    bool IsAhead(uint64_t last, uint64_t current) const
+    {
+        uint64_t distance = Distance(last, current);
+        return distance != 0 && distance <= HalfRange();
+    }
+
+    // Counter following counter, with the wraparound of the block ID
+    uint64_t Next(uint64_t counter) const
+    {
+        if (m_wide)
+            return counter + 1;
+        return (counter >= m_counterMax) ? First() : counter + 1;
+    }
+
+private:
+    uint64_t First() const { return (m_skipZero && !m_wide) ? 1 : 0; }
+
+    // Number of distinct counter values; 0 stands for 2^64
+    uint64_t Range() const { return m_wide ? 0 : m_counterMax - First() + 1; }
+
+    uint64_t HalfRange() const { return m_wide ? (UINT64_MAX / 2) : Range() / 2; }
+
+    static int BurstBucket(uint64_t length)
+    {
+        int bucket = 0;
+        uint64_t limit = 1;
+        while (length > limit && bucket < BurstBucketCount - 1)
+        {
+            limit <<= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    uint64_t m_counterMax;
+    bool m_skipZero;
+    bool m_wide;
+    bool m_hasLast;
+    uint64_t m_lastCounter;
+    uint64_t m_lastArrivalNs;
+    uint64_t m_received;
+    uint64_t m_lost;
+    uint64_t m_duplicates;
+    uint64_t m_wraps;
+    uint64_t m_restarts;
+    uint64_t m_bursts[BurstBucketCount];
+    LatencyHistogram m_intervals;
+};
@@ -0,0 +1,167 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ImageView.h
+//
+//  \brief
+//  Non owning view of an image in memory: pointer, width, height, stride and pixel format.
+//
+//  Description: frames are reached through the pointer of PFBuffer::GetRawData(), a PFImage or
+//  a frame of FrameBufferPool. An ImageView describes such memory without owning or copying it,
+//  so crops and tiles handed to later processing stages cost nothing:
+//
+//      ImageView frame(pfBuffer->GetRawData(), width, height, FormatMono8);
+//      ImageView target = frame.Crop(x, y, 64, 64);       // same memory, stride of the frame
+//      for (uint32_t row = 0; row < frame.TileRows(256); row++)
+//          for (uint32_t column = 0; column < frame.TileColumns(256); column++)
+//              Process(frame.Tile(column, row, 256, 256));
+//
+//  The stride is in bytes. Crops of Bayer images keep the color order right (the format of the
+//  view changes when the crop starts on an odd line or column). Crops of packed formats (Mono10p,
+//  Mono12p) must start on a whole pixel group (4 and 2 pixels), otherwise the view is empty.
+//
+//  A view is only valid as long as the memory it points to: a view of a PFBuffer must not be used
+//  after ReleaseBuffer(). ImageViewOpenCV.h turns a view into a cv::Mat header without copying.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "PixelFormats.h"
+
+class ImageView
+{
+public:
+    ImageView()
+        : m_data(nullptr), m_width(0), m_height(0), m_stride(0), m_format(FormatUnknown)
+    {
+    }
+
+    // Lines without padding
+    ImageView(uint8_t *data, uint32_t width, uint32_t height, FramePixelFormat format)
+        : m_data(data), m_width(width), m_height(height), m_stride((size_t)PixelFormatLineBytes(format, width)), m_format(format)
+    {
+    }
+
+    ImageView(uint8_t *data, uint32_t width, uint32_t height, size_t stride, FramePixelFormat format)
+        : m_data(data), m_width(width), m_height(height), m_stride(stride), m_format(format)
+    {
+    }
+
+    uint8_t *GetData() const { return m_data; }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    size_t GetStride() const { return m_stride; }
+    FramePixelFormat GetFormat() const { return m_format; }
+
+    bool IsEmpty() const { return m_data == nullptr || m_width == 0 || m_height == 0; }
+
+    // Bytes of the pixels of one line, without padding
+    size_t GetLineBytes() const { return (size_t)PixelFormatLineBytes(m_format, m_width); }
+
+    // No padding between the lines, the view can be handed on as one block
+    bool IsContiguous() const { return m_stride == GetLineBytes(); }
+
+    size_t GetSizeInBytes() const { return m_height == 0 ? 0 : m_stride * (m_height - 1) + GetLineBytes(); }
+
+    uint8_t *Line(uint32_t y) const { return m_data + (size_t)y * m_stride; }
+
+    template <class T>
+    T *LineAs(uint32_t y) const { return (T *)Line(y); }
+
+    // Sub-rectangle on the same memory, clipped to the view
+    ImageView Crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+    {
+        if (x >= m_width || y >= m_height)
+            return ImageView();
+        if (width > m_width - x)
+            width = m_width - x;
+        if (height > m_height - y)
+            height = m_height - y;
+
+        const PixelFormatInfo *info = FindPixelFormat(m_format);
+        if (info == nullptr)
+            return ImageView();
+        // Packed pixels: start on a byte boundary, i.e. on a whole pixel group
+        uint64_t startBits = (uint64_t)x * info->bitsPerPixel;
+        if (startBits % 8 != 0)
+            return ImageView();
+
+        return ImageView(Line(y) + startBits / 8, width, height, m_stride, CropBayerFormat(m_format, x, y));
+    }
+
+    // Tile (column, row) of a grid of tileWidth x tileHeight tiles, the last ones may be smaller
+    ImageView Tile(uint32_t column, uint32_t row, uint32_t tileWidth, uint32_t tileHeight) const
+    {
+        return Crop(column * tileWidth, row * tileHeight, tileWidth, tileHeight);
+    }
+
+    uint32_t TileColumns(uint32_t tileWidth) const { return tileWidth ? (m_width + tileWidth - 1) / tileWidth : 0; }
+    uint32_t TileRows(uint32_t tileHeight) const { return tileHeight ? (m_height + tileHeight - 1) / tileHeight : 0; }
+
+private:
+    // The Bayer format names the colors of the first two pixels of the first line
+    static FramePixelFormat CropBayerFormat(FramePixelFormat format, uint32_t x, uint32_t y)
+    {
+        if (x & 1)
+        {
+            switch (format)
+            {
+            case FormatBayerGR8: format = FormatBayerRG8; break;
+            case FormatBayerRG8: format = FormatBayerGR8; break;
+            case FormatBayerGB8: format = FormatBayerBG8; break;
+            case FormatBayerBG8: format = FormatBayerGB8; break;
+            default: break;
+            }
+        }
+        if (y & 1)
+        {
+            switch (format)
+            {
+            case FormatBayerGR8: format = FormatBayerBG8; break;
+            case FormatBayerBG8: format = FormatBayerGR8; break;
+            case FormatBayerRG8: format = FormatBayerGB8; break;
+            case FormatBayerGB8: format = FormatBayerRG8; break;
+            default: break;
+            }
+        }
+        return format;
+    }
+
+    uint8_t *m_data;
+    uint32_t m_width;
+    uint32_t m_height;
+    size_t m_stride;
+    FramePixelFormat m_format;
+};
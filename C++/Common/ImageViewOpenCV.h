@@ -0,0 +1,89 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ImageViewOpenCV.h
+//
+//  \brief
+//  cv::Mat headers over ImageView memory and back, without copying the pixels.
+//
+//  Description: ToMat() returns a Mat that points to the memory of the view with its stride, so
+//  imshow(), ROI operations and the OpenCV algorithms work on frames, crops and tiles in place.
+//  The Mat does not own the memory: it is only valid as long as the view is (for a PFBuffer, until
+//  ReleaseBuffer()). Packed formats have no OpenCV type and give an empty Mat; unpack them first
+//  (PackedPixels.h).
+//
+//  Only include this header in examples that link OpenCV; ImageView.h does not depend on it.
+//
+*/
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include "ImageView.h"
+
+// OpenCV type of a pixel format, -1 if OpenCV has none
+inline int OpenCvType(FramePixelFormat format)
+{
+    switch (format)
+    {
+    case FormatMono8:
+    case FormatBayerGR8:
+    case FormatBayerRG8:
+    case FormatBayerGB8:
+    case FormatBayerBG8:
+        return CV_8UC1;
+    case FormatMono16:
+        return CV_16UC1;
+    case FormatRGB8:
+    case FormatBGR8:
+        return CV_8UC3;
+    default:
+        return -1;
+    }
+}
+
+// Mat header over the view, no copy
+inline cv::Mat ToMat(const ImageView &view)
+{
+    int type = OpenCvType(view.GetFormat());
+    if (view.IsEmpty() || type < 0)
+        return cv::Mat();
+    return cv::Mat((int)view.GetHeight(), (int)view.GetWidth(), type, view.GetData(), view.GetStride());
+}
+
+// View of the memory of a Mat, e.g. a preview image the tone mapper writes into
+inline ImageView FromMat(cv::Mat &mat, FramePixelFormat format)
+{
+    if (mat.empty() || mat.type() != OpenCvType(format))
+        return ImageView();
+    return ImageView(mat.data, (uint32_t)mat.cols, (uint32_t)mat.rows, (size_t)mat.step, format);
+}
@@ -0,0 +1,225 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file LatencyHistogram.h
+//
+//  \brief
+//  Fixed size log-linear histogram for latencies and intervals (HdrHistogram style buckets).
+//
+//  Description: values below 128 are counted exactly. Above that, every power of two is split in
+//  64 linear sub-buckets, so the relative error of any reported percentile is below 1.6%
+//  over the whole 64 bit range. Recording is a couple of integer operations and never allocates.
+//
+//  Record() must be called from a single thread. The counters are atomics with relaxed ordering,
+//  so other threads (telemetry, exporters) may read percentiles while the owner keeps recording.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+class LatencyHistogram
+{
+public:
+    static const int SubBucketBits = 7;
+    static const uint64_t SubBucketCount = 1ull << SubBucketBits;   // 128
+    static const uint64_t SubBucketHalf = SubBucketCount / 2;      // 64
+    static const int BucketCount = (int)((64 - SubBucketBits + 1) * SubBucketHalf + SubBucketHalf);
+
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (int i = 0; i < BucketCount; i++)
+            m_counts[i].store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_min.store(UINT64_MAX, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    // Single writer: plain load/store instead of locked read-modify-write
+    void Record(uint64_t value)
+    {
+        std::atomic<uint64_t> &bucket = m_counts[BucketIndex(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_sum.store(m_sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if (value < m_min.load(std::memory_order_relaxed))
+            m_min.store(value, std::memory_order_relaxed);
+        if (value > m_max.load(std::memory_order_relaxed))
+            m_max.store(value, std::memory_order_relaxed);
+    }
+
+    uint64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t GetSum() const { return m_sum.load(std::memory_order_relaxed); }
+    uint64_t GetMax() const { return m_max.load(std::memory_order_relaxed); }
+    uint64_t GetMin() const
+    {
+        uint64_t min = m_min.load(std::memory_order_relaxed);
+        return (min == UINT64_MAX) ? 0 : min;
+    }
+    double GetMean() const
+    {
+        uint64_t count = GetCount();
+        return count ? (double)GetSum() / (double)count : 0.0;
+    }
+
+    // Value below which the given percentage (0..100) of the samples fall.
+    // The upper edge of the matching bucket is returned, clamped to the recorded maximum.
+    uint64_t GetValueAtPercentile(double percentile) const
+    {
+        uint64_t count = GetCount();
+        if (count == 0)
+            return 0;
+        if (percentile >= 100.0)
+            return GetMax();
+        uint64_t target = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+        if (target < 1)
+            target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BucketCount; i++)
+        {
+            seen += m_counts[i].load(std::memory_order_relaxed);
+            if (seen >= target)
+            {
+                uint64_t value = BucketUpperEdge(i);
+                return (value > GetMax()) ? GetMax() : value;
+            }
+        }
+        return GetMax();
+    }
+
+    int GetBucketCount() const { return BucketCount; }
+    uint64_t GetBucketValue(int index) const { return m_counts[index].load(std::memory_order_relaxed); }
+
+    // Smallest value counted in the given bucket
+    static uint64_t BucketLowerEdge(int index)
+    {
+        if ((uint64_t)index < SubBucketCount)
+            return (uint64_t)index;
+        int shift = index / (int)SubBucketHalf - 1;
+        uint64_t mantissa = (uint64_t)index - (uint64_t)shift * SubBucketHalf;
+        return mantissa << shift;
+    }
+
+    // Largest value counted in the given bucket
+    static uint64_t BucketUpperEdge(int index)
+    {
+        if (index + 1 >= BucketCount)
+            return UINT64_MAX;
+        return BucketLowerEdge(index + 1) - 1;
+    }
+
+    static int BucketIndex(uint64_t value)
+    {
+        if (value < SubBucketCount)
+            return (int)value;
+        int msb = 63 - CountLeadingZeros(value);
+        int shift = msb - (SubBucketBits - 1);
+        return (int)((uint64_t)shift * SubBucketHalf + (value >> shift));
+    }
+
+    // Prints count, mean and the usual percentiles. Values are divided by unitDivisor,
+    // i.e. 1000.0 to print nanosecond samples in microseconds.
+    void Print(FILE *out, const char *name, double unitDivisor = 1000.0, const char *unit = "us") const
+    {
+        if (GetCount() == 0)
+        {
+            fprintf(out, "%s: no samples\n", name);
+            return;
+        }
+        fprintf(out, "%s (%s): n=%llu min=%.1f mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            name, unit, (unsigned long long)GetCount(),
+            GetMin() / unitDivisor, GetMean() / unitDivisor,
+            GetValueAtPercentile(50.0) / unitDivisor, GetValueAtPercentile(90.0) / unitDivisor,
+            GetValueAtPercentile(99.0) / unitDivisor, GetValueAtPercentile(99.9) / unitDivisor,
+            GetMax() / unitDivisor);
+    }
+
+    // Prints the sample count per power of two range with a bar, as a quick view of the shape
+    // of the distribution (e.g. a second mode caused by scheduling or interrupt coalescing).
+    void PrintDistribution(FILE *out, double unitDivisor = 1000.0, const char *unit = "us") const
+    {
+        uint64_t count = GetCount();
+        if (count == 0)
+            return;
+        uint64_t rangeCount[65] = { 0 };
+        for (int i = 0; i < BucketCount; i++)
+        {
+            uint64_t value = m_counts[i].load(std::memory_order_relaxed);
+            if (value == 0)
+                continue;
+            uint64_t low = BucketLowerEdge(i);
+            rangeCount[low ? 64 - CountLeadingZeros(low) : 0] += value;
+        }
+        for (int range = 0; range < 65; range++)
+        {
+            if (rangeCount[range] == 0)
+                continue;
+            double low = range ? (double)(1ull << (range - 1)) : 0.0;
+            double high = (range < 64) ? (double)(1ull << range) : 18446744073709551616.0;
+            int bar = (int)(rangeCount[range] * 50 / count);
+            fprintf(out, "  [%10.1f, %10.1f) %s %10llu ", low / unitDivisor, high / unitDivisor, unit,
+                (unsigned long long)rangeCount[range]);
+            for (int i = 0; i < bar; i++)
+                fputc('#', out);
+            fputc('\n', out);
+        }
+    }
+
+private:
+    static int CountLeadingZeros(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - (int)index;
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+
+    std::atomic<uint64_t> m_counts[BucketCount];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+};
@@ -0,0 +1,428 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file MetricsExporter.h
+//
+//  \brief
+//  Acquisition health metrics in the Prometheus text format, served over HTTP and/or written as
+//  a node_exporter textfile collector file.
+//
+//  Description: MetricsRegistry holds counters, gauges and histograms. The grab loop updates them
+//  with single relaxed atomic operations (MetricCounter::Add(), MetricGauge::Set(),
+//  LatencyHistogram::Record()), no lock and no formatting. The exporter thread renders the
+//  registry when it is scraped or when the textfile is due:
+//
+//      ListenHttp("127.0.0.1", 9464)   GET /metrics on that port, for a Prometheus scrape job
+//      SetTextFile("/var/lib/node_exporter/pf.prom", 5 s)
+//                                      Rewritten atomically (temporary file + rename) so the
+//                                      node_exporter never reads half a file
+//
+//  Values that are expensive or not owned by the grab loop (GetStreamStatistics(), ages) are
+//  refreshed by the collector callback, called on the exporter thread before every render. A
+//  total counted elsewhere stays a counter, the collector copies it in with MetricCounter::Set().
+//  Latency histograms are LatencyHistogram objects in ns, exported in seconds with fixed bucket
+//  bounds from 10 us to 1 s.
+//
+//  Metric names and labels are taken as given, use the Prometheus conventions (snake case,
+//  _total for counters, base units).
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "HostClock.h"
+#include "LatencyHistogram.h"
+
+class MetricCounter
+{
+public:
+    MetricCounter() : m_value(0) {}
+    void Add(uint64_t count = 1) { m_value.fetch_add(count, std::memory_order_relaxed); }
+    // For a total counted elsewhere (e.g. by the SDK), copied in by the collector
+    void Set(uint64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    uint64_t Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+class MetricGauge
+{
+public:
+    MetricGauge() : m_bits(0) {}
+
+    // The double is kept as its bit pattern, so the atomic is lock free on every platform
+    void Set(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        m_bits.store(bits, std::memory_order_relaxed);
+    }
+
+    double Get() const
+    {
+        uint64_t bits = m_bits.load(std::memory_order_relaxed);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+private:
+    std::atomic<uint64_t> m_bits;
+};
+
+class MetricsRegistry
+{
+public:
+    // labels is the inside of the braces, e.g. "stage=\"publish\"", or empty
+    MetricCounter &AddCounter(const char *name, const char *help, const char *labels = "")
+    {
+        Entry &entry = AddEntry(CounterType, name, help, labels);
+        entry.counter.reset(new MetricCounter());
+        return *entry.counter;
+    }
+
+    MetricGauge &AddGauge(const char *name, const char *help, const char *labels = "")
+    {
+        Entry &entry = AddEntry(GaugeType, name, help, labels);
+        entry.gauge.reset(new MetricGauge());
+        return *entry.gauge;
+    }
+
+    // The histogram is owned by the caller and must outlive the registry. Values are in ns.
+    void AddHistogram(const char *name, const char *help, const char *labels, const LatencyHistogram *histogram)
+    {
+        Entry &entry = AddEntry(HistogramType, name, help, labels);
+        entry.histogram = histogram;
+    }
+
+    // Called before every render, on the thread that renders
+    void SetCollector(const std::function<void()> &collector)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_collector = collector;
+    }
+
+    // Prometheus text exposition format 0.0.4
+    std::string Render()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_collector)
+            m_collector();
+
+        std::string text;
+        char line[512];
+        const std::string *lastName = nullptr;
+        for (size_t i = 0; i < m_entries.size(); i++)
+        {
+            const Entry &entry = *m_entries[i];
+            // HELP and TYPE once per metric family, entries of one family are registered together
+            if (!lastName || *lastName != entry.name)
+            {
+                static const char *types[] = { "counter", "gauge", "histogram" };
+                snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", entry.name.c_str(), entry.help.c_str(),
+                    entry.name.c_str(), types[entry.type]);
+                text += line;
+                lastName = &entry.name;
+            }
+
+            std::string labels = entry.labels.empty() ? "" : "{" + entry.labels + "}";
+            if (entry.type == CounterType)
+            {
+                snprintf(line, sizeof(line), "%s%s %" PRIu64 "\n", entry.name.c_str(), labels.c_str(), entry.counter->Get());
+                text += line;
+            }
+            else if (entry.type == GaugeType)
+            {
+                snprintf(line, sizeof(line), "%s%s %.6g\n", entry.name.c_str(), labels.c_str(), entry.gauge->Get());
+                text += line;
+            }
+            else
+            {
+                RenderHistogram(text, entry);
+            }
+        }
+        return text;
+    }
+
+private:
+    enum EntryType { CounterType, GaugeType, HistogramType };
+
+    struct Entry
+    {
+        EntryType type;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        const LatencyHistogram *histogram;
+    };
+
+    Entry &AddEntry(EntryType type, const char *name, const char *help, const char *labels)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(std::unique_ptr<Entry>(new Entry()));
+        Entry &entry = *m_entries.back();
+        entry.type = type;
+        entry.name = name;
+        entry.help = help;
+        entry.labels = labels ? labels : "";
+        entry.histogram = nullptr;
+        return entry;
+    }
+
+    // Cumulative buckets from the log linear buckets of LatencyHistogram. A histogram bucket is
+    // counted below a bound if its lower edge is, which is exact to the 1% bucket resolution.
+    static void RenderHistogram(std::string &text, const Entry &entry)
+    {
+        static const uint64_t boundsNs[] = { 10000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+            5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000 };
+        static const int boundCount = (int)(sizeof(boundsNs) / sizeof(boundsNs[0]));
+        const LatencyHistogram &histogram = *entry.histogram;
+        std::string separator = entry.labels.empty() ? "" : entry.labels + ",";
+        std::string labels = entry.labels.empty() ? "" : "{" + entry.labels + "}";
+        char line[512];
+
+        uint64_t cumulative = 0;
+        int bucket = 0;
+        for (int bound = 0; bound <= boundCount; bound++)
+        {
+            uint64_t limit = (bound < boundCount) ? boundsNs[bound] : UINT64_MAX;
+            while (bucket < histogram.GetBucketCount() && LatencyHistogram::BucketLowerEdge(bucket) <= limit)
+                cumulative += histogram.GetBucketValue(bucket++);
+            if (bound < boundCount)
+                snprintf(line, sizeof(line), "%s_bucket{%sle=\"%g\"} %" PRIu64 "\n", entry.name.c_str(),
+                    separator.c_str(), boundsNs[bound] * 1e-9, cumulative);
+            else
+                snprintf(line, sizeof(line), "%s_bucket{%sle=\"+Inf\"} %" PRIu64 "\n", entry.name.c_str(),
+                    separator.c_str(), cumulative);
+            text += line;
+        }
+        // _count from the same bucket pass, so it always equals the +Inf bucket
+        snprintf(line, sizeof(line), "%s_sum%s %.9f\n%s_count%s %" PRIu64 "\n", entry.name.c_str(), labels.c_str(),
+            histogram.GetSum() * 1e-9, entry.name.c_str(), labels.c_str(), cumulative);
+        text += line;
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::function<void()> m_collector;
+};
+
+class MetricsExporter
+{
+public:
+    MetricsExporter(MetricsRegistry &registry)
+        : m_registry(registry), m_listenFd(-1), m_filePeriodNs(0), m_running(false)
+    {
+    }
+
+    ~MetricsExporter()
+    {
+        Stop();
+    }
+
+    // Serves GET /metrics. address is the local address to bind: "127.0.0.1" for this host only,
+    // "0.0.0.0" for all interfaces (the metrics are served without authentication).
+    bool ListenHttp(const char *address, int port)
+    {
+#ifndef WIN32
+        struct sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET, address, &local.sin_addr) != 1)
+            return false;
+
+        m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenFd < 0)
+            return false;
+        int reuse = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(m_listenFd, (struct sockaddr *)&local, sizeof(local)) != 0 || listen(m_listenFd, 4) != 0)
+        {
+            close(m_listenFd);
+            m_listenFd = -1;
+            return false;
+        }
+        return true;
+#else
+        (void)address;
+        (void)port;
+        return false;
+#endif
+    }
+
+    // Rewrites path every periodNs, for the textfile collector of the node_exporter
+    void SetTextFile(const char *path, uint64_t periodNs = 5000000000ULL)
+    {
+        m_filePath = path;
+        m_filePeriodNs = periodNs ? periodNs : 1;
+    }
+
+    void Start()
+    {
+        if (m_running.load())
+            return;
+        m_running.store(true);
+        m_thread = std::thread(&MetricsExporter::Run, this);
+    }
+
+    void Stop()
+    {
+        if (m_running.exchange(false))
+            m_thread.join();
+#ifndef WIN32
+        if (m_listenFd >= 0)
+            close(m_listenFd);
+#endif
+        m_listenFd = -1;
+    }
+
+    bool WriteTextFile()
+    {
+        std::string text = m_registry.Render();
+        std::string temporary = m_filePath + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "w");
+        if (!file)
+            return false;
+        bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+        ok = (fclose(file) == 0) && ok;
+        // rename() replaces the old file atomically
+        return ok && rename(temporary.c_str(), m_filePath.c_str()) == 0;
+    }
+
+private:
+    void Run()
+    {
+        uint64_t nextFileNs = HostNowNs();
+        while (m_running.load())
+        {
+            // Wake up at least every 100 ms to see Stop()
+            int timeoutMs = 100;
+            if (!m_filePath.empty())
+            {
+                uint64_t now = HostNowNs();
+                if (now >= nextFileNs)
+                {
+                    WriteTextFile();
+                    nextFileNs = now + m_filePeriodNs;
+                }
+                uint64_t untilFileMs = (nextFileNs - now) / 1000000;
+                if (untilFileMs < (uint64_t)timeoutMs)
+                    timeoutMs = (int)untilFileMs;
+            }
+
+#ifndef WIN32
+            if (m_listenFd >= 0)
+            {
+                struct pollfd pfd = { m_listenFd, POLLIN, 0 };
+                if (poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN))
+                    ServeClient();
+                continue;
+            }
+#endif
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        }
+    }
+
+#ifndef WIN32
+    void ServeClient()
+    {
+        int fd = accept(m_listenFd, NULL, NULL);
+        if (fd < 0)
+            return;
+
+        // A scraper sends its request at once, don't let a silent client block the exporter
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        char request[2048];
+        ssize_t received = 0;
+        if (poll(&pfd, 1, 1000) > 0)
+            received = recv(fd, request, sizeof(request) - 1, 0);
+        if (received > 0)
+        {
+            request[received] = '\0';
+            std::string response;
+            if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0)
+            {
+                std::string body = m_registry.Render();
+                char header[160];
+                snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+                response = header + body;
+            }
+            else
+            {
+                response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+            size_t sent = 0;
+            while (sent < response.size())
+            {
+                ssize_t count = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (count <= 0)
+                    break;
+                sent += (size_t)count;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    MetricsRegistry &m_registry;
+    int m_listenFd;
+    std::string m_filePath;
+    uint64_t m_filePeriodNs;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
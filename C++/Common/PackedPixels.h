@@ -0,0 +1,319 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file PackedPixels.h
+//
+//  \brief
+//  Unpacking of the GenICam packed formats Mono10p and Mono12p to 16 bit and to 8 bit.
+//
+//  Description: Mono12p carries 12 bit pixels in 1.5 bytes and Mono10p 10 bit pixels in 1.25
+//  bytes, against 2 bytes for Mono16. The bits are packed LSB first: for Mono12p pixel 0 is byte 0
+//  plus the low nibble of byte 1, pixel 1 the high nibble of byte 1 plus byte 2.
+//
+//  Every pixel lies in two consecutive bytes, so the SIMD kernels gather those byte pairs into
+//  16 bit lanes with one shuffle per 128 bit block (8 pixels), move the pixel bits to the top of
+//  the lane with a multiply by a power of two and shift them down. 8 (SSE4.2) or 16 (AVX2) pixels
+//  per iteration, which is far below the cost of reading the frame from memory. The 8 bit variants
+//  shift right by a given amount (bits - 8 keeps the most significant bits) and saturate, e.g. for
+//  a preview; ConvertTo8Kernel of PixelKernels.h runs them over whole frames.
+//
+//  All variants are compiled in; the first call selects the one for the CPU (CpuDispatch.h, PF_SIMD
+//  overrides it). AVX-512 machines use the AVX2 kernels, the unpacking is memory bound there.
+//  Lines of the packed frame start on a byte boundary (srcStride), Width increments of the cameras
+//  keep that exact.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "CpuDispatch.h"
+#include "PixelFormats.h"
+
+inline bool IsPackedPixelFormat(FramePixelFormat format)
+{
+    return format == FormatMono10p || format == FormatMono12p;
+}
+
+// Significant bits per pixel of the packed formats, 0 for the others
+inline int PackedPixelBits(FramePixelFormat format)
+{
+    return (format == FormatMono10p) ? 10 : (format == FormatMono12p) ? 12 : 0;
+}
+
+// Pixel index of a packed line, also used for the tails the vector kernels leave
+inline uint16_t PackedPixelAt(const uint8_t *src, size_t index, int bits)
+{
+    size_t bit = index * (size_t)bits;
+    const uint8_t *p = src + (bit >> 3);
+    return (uint16_t)(((uint32_t)p[0] | ((uint32_t)p[1] << 8)) >> (bit & 7)) & (uint16_t)((1u << bits) - 1);
+}
+
+inline uint8_t Saturate8(uint32_t value)
+{
+    return (uint8_t)(value > 255 ? 255 : value);
+}
+
+inline void UnpackMono12pScalar(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 2 <= pixels; i += 2, src += 3)
+    {
+        dst[i] = (uint16_t)(src[0] | ((src[1] & 0x0F) << 8));
+        dst[i + 1] = (uint16_t)((src[1] >> 4) | (src[2] << 4));
+    }
+    if (i < pixels)
+        dst[i] = (uint16_t)(src[0] | ((src[1] & 0x0F) << 8));
+}
+
+inline void UnpackMono10pScalar(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4, src += 5)
+    {
+        dst[i] = (uint16_t)(src[0] | ((src[1] & 0x03) << 8));
+        dst[i + 1] = (uint16_t)((src[1] >> 2) | ((src[2] & 0x0F) << 6));
+        dst[i + 2] = (uint16_t)((src[2] >> 4) | ((src[3] & 0x3F) << 4));
+        dst[i + 3] = (uint16_t)((src[3] >> 6) | (src[4] << 2));
+    }
+    for (size_t j = 0; i < pixels; i++, j++)
+        dst[i] = PackedPixelAt(src, j, 10);
+}
+
+// value >> shift, saturated to 255
+inline void UnpackMono12pTo8Scalar(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    size_t i = 0;
+    for (; i + 2 <= pixels; i += 2, src += 3)
+    {
+        dst[i] = Saturate8((uint16_t)(src[0] | ((src[1] & 0x0F) << 8)) >> shift);
+        dst[i + 1] = Saturate8((uint16_t)((src[1] >> 4) | (src[2] << 4)) >> shift);
+    }
+    if (i < pixels)
+        dst[i] = Saturate8(PackedPixelAt(src, 0, 12) >> shift);
+}
+
+inline void UnpackMono10pTo8Scalar(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4, src += 5)
+    {
+        dst[i] = Saturate8((uint16_t)(src[0] | ((src[1] & 0x03) << 8)) >> shift);
+        dst[i + 1] = Saturate8((uint16_t)((src[1] >> 2) | ((src[2] & 0x0F) << 6)) >> shift);
+        dst[i + 2] = Saturate8((uint16_t)((src[2] >> 4) | ((src[3] & 0x3F) << 4)) >> shift);
+        dst[i + 3] = Saturate8((uint16_t)((src[3] >> 6) | (src[4] << 2)) >> shift);
+    }
+    for (size_t j = 0; i < pixels; i++, j++)
+        dst[i] = Saturate8(PackedPixelAt(src, j, 10) >> shift);
+}
+
+#if PF_SIMD_X86
+// 8 pixels from 12 (Mono12p) or 10 (Mono10p) bytes, reads 16 bytes
+PF_TARGET_SSE42 inline __m128i UnpackMono12p8Pixels(const uint8_t *src)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    // Even pixels are in bits 0-11 of their byte pair, odd pixels in bits 4-15
+    const __m128i multiplier = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+    __m128i pairs = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), shuffle);
+    return _mm_srli_epi16(_mm_mullo_epi16(pairs, multiplier), 4);
+}
+
+PF_TARGET_SSE42 inline __m128i UnpackMono10p8Pixels(const uint8_t *src)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+    // Pixels start at bit 0, 2, 4 and 6 of their byte pair
+    const __m128i multiplier = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    __m128i pairs = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), shuffle);
+    return _mm_srli_epi16(_mm_mullo_epi16(pairs, multiplier), 6);
+}
+
+// 16 pixels from 24 (Mono12p) or 20 (Mono10p) bytes. Each half reads 16 bytes, so up to 28
+// (resp. 26) bytes must be readable.
+PF_TARGET_AVX2 inline __m256i UnpackMono12p16Pixels(const uint8_t *src)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+        0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m256i multiplier = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1);
+    __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+        _mm_loadu_si128((const __m128i *)(src + 12)), 1);
+    __m256i pairs = _mm256_shuffle_epi8(bytes, shuffle);
+    return _mm256_srli_epi16(_mm256_mullo_epi16(pairs, multiplier), 4);
+}
+
+PF_TARGET_AVX2 inline __m256i UnpackMono10p16Pixels(const uint8_t *src)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9,
+        0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+    const __m256i multiplier = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1, 64, 16, 4, 1);
+    __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+        _mm_loadu_si128((const __m128i *)(src + 10)), 1);
+    __m256i pairs = _mm256_shuffle_epi8(bytes, shuffle);
+    return _mm256_srli_epi16(_mm256_mullo_epi16(pairs, multiplier), 6);
+}
+
+// The loop conditions keep every 16 byte read inside the line: 11 Mono12p pixels are 16.5 bytes,
+// 13 Mono10p pixels 16.25 bytes, 19 and 21 pixels cover the 28 and 26 bytes of the AVX2 reads
+PF_TARGET_SSE42 inline void UnpackMono12pSse42(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 11 <= pixels; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), UnpackMono12p8Pixels(src + i / 2 * 3));
+    UnpackMono12pScalar(src + i / 2 * 3, dst + i, pixels - i);
+}
+
+PF_TARGET_SSE42 inline void UnpackMono10pSse42(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 13 <= pixels; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), UnpackMono10p8Pixels(src + i / 4 * 5));
+    UnpackMono10pScalar(src + i / 4 * 5, dst + i, pixels - i);
+}
+
+PF_TARGET_SSE42 inline void UnpackMono12pTo8Sse42(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 11 <= pixels; i += 8)
+    {
+        __m128i value = _mm_srl_epi16(UnpackMono12p8Pixels(src + i / 2 * 3), count);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(value, value));
+    }
+    UnpackMono12pTo8Scalar(src + i / 2 * 3, dst + i, pixels - i, shift);
+}
+
+PF_TARGET_SSE42 inline void UnpackMono10pTo8Sse42(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 13 <= pixels; i += 8)
+    {
+        __m128i value = _mm_srl_epi16(UnpackMono10p8Pixels(src + i / 4 * 5), count);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(value, value));
+    }
+    UnpackMono10pTo8Scalar(src + i / 4 * 5, dst + i, pixels - i, shift);
+}
+
+PF_TARGET_AVX2 inline void UnpackMono12pAvx2(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 19 <= pixels; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i), UnpackMono12p16Pixels(src + i / 2 * 3));
+    UnpackMono12pScalar(src + i / 2 * 3, dst + i, pixels - i);
+}
+
+PF_TARGET_AVX2 inline void UnpackMono10pAvx2(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 21 <= pixels; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i), UnpackMono10p16Pixels(src + i / 4 * 5));
+    UnpackMono10pScalar(src + i / 4 * 5, dst + i, pixels - i);
+}
+
+PF_TARGET_AVX2 inline void UnpackMono12pTo8Avx2(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 19 <= pixels; i += 16)
+    {
+        __m256i value = _mm256_srl_epi16(UnpackMono12p16Pixels(src + i / 2 * 3), count);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_castsi256_si128(packed));
+    }
+    UnpackMono12pTo8Scalar(src + i / 2 * 3, dst + i, pixels - i, shift);
+}
+
+PF_TARGET_AVX2 inline void UnpackMono10pTo8Avx2(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 21 <= pixels; i += 16)
+    {
+        __m256i value = _mm256_srl_epi16(UnpackMono10p16Pixels(src + i / 4 * 5), count);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_castsi256_si128(packed));
+    }
+    UnpackMono10pTo8Scalar(src + i / 4 * 5, dst + i, pixels - i, shift);
+}
+#endif
+
+typedef void (*UnpackTo16Function)(const uint8_t *src, uint16_t *dst, size_t pixels);
+typedef void (*UnpackTo8Function)(const uint8_t *src, uint8_t *dst, size_t pixels, int shift);
+
+#if PF_SIMD_X86
+#define PF_UNPACK_VARIANTS(name) name##Scalar, name##Sse42, name##Avx2, nullptr, nullptr
+#else
+#define PF_UNPACK_VARIANTS(name) name##Scalar, nullptr, nullptr, nullptr, nullptr
+#endif
+
+inline void UnpackMono12p(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    static const UnpackTo16Function function = SelectKernel<UnpackTo16Function>(PF_UNPACK_VARIANTS(UnpackMono12p));
+    function(src, dst, pixels);
+}
+
+inline void UnpackMono10p(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    static const UnpackTo16Function function = SelectKernel<UnpackTo16Function>(PF_UNPACK_VARIANTS(UnpackMono10p));
+    function(src, dst, pixels);
+}
+
+// value >> shift, saturated to 255
+inline void UnpackMono12pTo8(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    static const UnpackTo8Function function = SelectKernel<UnpackTo8Function>(PF_UNPACK_VARIANTS(UnpackMono12pTo8));
+    function(src, dst, pixels, shift);
+}
+
+inline void UnpackMono10pTo8(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+{
+    static const UnpackTo8Function function = SelectKernel<UnpackTo8Function>(PF_UNPACK_VARIANTS(UnpackMono10pTo8));
+    function(src, dst, pixels, shift);
+}
+
+// Whole frame, line by line. Strides in bytes. Returns false for formats that are not packed.
+inline bool UnpackFrameTo16(FramePixelFormat format, const uint8_t *src, size_t srcStride,
+    uint16_t *dst, size_t dstStride, uint32_t width, uint32_t height)
+{
+    if (!IsPackedPixelFormat(format))
+        return false;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t *line = src + y * srcStride;
+        uint16_t *out = (uint16_t *)((uint8_t *)dst + y * dstStride);
+        if (format == FormatMono12p)
+            UnpackMono12p(line, out, width);
+        else
+            UnpackMono10p(line, out, width);
+    }
+    return true;
+}
@@ -0,0 +1,335 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file PerfCounters.h
+//
+//  \brief
+//  Hardware performance counters (cycles, instructions, cache misses, branches) around
+//  single kernel calls, aggregated per kernel and frame size.
+//
+//  Description: PerfCounters opens one perf_event_open() group for the calling thread, counting
+//  user space only (allowed with the default perf_event_paranoid of 2). Begin() and End() read
+//  the whole group with one read() each, End() returns the difference. The group leader is the
+//  task clock, which always exists, so on machines without a PMU (most VMs) the report still has
+//  the CPU time and the hardware columns are just missing. Counts are scaled if the kernel had to
+//  multiplex the group.
+//
+//  PerfReport sums the calls per (kernel, frame bytes) and prints per call time, bandwidth,
+//  cycles per byte, instructions per cycle (IPC), last level cache misses per KB and the share of
+//  the branches that were mispredicted. As a rule of thumb a kernel with an IPC below 1 and many cache misses per KB waits
+//  for memory (memory bound, gains come from fewer passes over the frame), a kernel with an IPC
+//  of 2 or more and few misses is compute bound (gains come from SIMD or less work per pixel).
+//
+//  On other systems than Linux Open() fails and only the wall time is reported.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "HostClock.h"
+
+enum PerfCounterId
+{
+    PerfTaskClock = 0,      // CPU time of the thread in ns
+    PerfCycles,
+    PerfInstructions,
+    PerfCacheMisses,        // Last level cache misses
+    PerfBranches,           // Retired branch instructions
+    PerfBranchMisses,
+    PerfCounterCount
+};
+
+struct PerfCounterValues
+{
+    uint64_t wallNs;
+    uint64_t value[PerfCounterCount];
+    bool valid[PerfCounterCount];
+};
+
+class PerfCounters
+{
+public:
+    PerfCounters()
+        : m_leaderFd(-1), m_beginNs(0)
+    {
+        for (int i = 0; i < PerfCounterCount; i++)
+        {
+            m_fd[i] = -1;
+            m_id[i] = 0;
+        }
+        memset(&m_begin, 0, sizeof(m_begin));
+        m_error = "not opened";
+    }
+
+    ~PerfCounters()
+    {
+        Close();
+    }
+
+    // Counts the calling thread on any CPU. Returns false if not even the task clock is available.
+    bool Open()
+    {
+#ifdef __linux__
+        static const uint32_t types[PerfCounterCount] = { PERF_TYPE_SOFTWARE, PERF_TYPE_HARDWARE,
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+        static const uint64_t configs[PerfCounterCount] = { PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES };
+
+        Close();
+        for (int i = 0; i < PerfCounterCount; i++)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = (m_leaderFd < 0) ? 1 : 0;
+
+            m_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, m_leaderFd, 0);
+            if (m_fd[i] < 0)
+            {
+                if (i == PerfTaskClock)
+                {
+                    m_error = strerror(errno);
+                    return false;
+                }
+                continue;
+            }
+            ioctl(m_fd[i], PERF_EVENT_IOC_ID, &m_id[i]);
+            if (m_leaderFd < 0)
+                m_leaderFd = m_fd[i];
+        }
+        if (m_fd[PerfCycles] < 0)
+            m_error = "no hardware counters (PMU not available)";
+        else
+            m_error = "";
+        ioctl(m_leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        m_error = "perf_event_open() is Linux only";
+        return false;
+#endif
+    }
+
+    void Close()
+    {
+#ifdef __linux__
+        for (int i = PerfCounterCount - 1; i >= 0; i--)
+        {
+            if (m_fd[i] >= 0)
+                close(m_fd[i]);
+            m_fd[i] = -1;
+        }
+#endif
+        m_leaderFd = -1;
+    }
+
+    bool IsOpen() const { return m_leaderFd >= 0; }
+    bool HasHardwareCounters() const { return m_fd[PerfCycles] >= 0; }
+    // Why Open() failed or why there are no hardware counters, empty if all is available
+    const char *GetError() const { return m_error; }
+
+    void Begin()
+    {
+        ReadGroup(m_begin);
+        m_beginNs = HostNowNs();
+    }
+
+    PerfCounterValues End()
+    {
+        PerfCounterValues result;
+        uint64_t endNs = HostNowNs();
+        ReadGroup(result);
+        result.wallNs = endNs - m_beginNs;
+        for (int i = 0; i < PerfCounterCount; i++)
+        {
+            result.valid[i] = result.valid[i] && m_begin.valid[i];
+            result.value[i] = result.valid[i] ? result.value[i] - m_begin.value[i] : 0;
+        }
+        return result;
+    }
+
+private:
+    void ReadGroup(PerfCounterValues &values)
+    {
+        memset(&values, 0, sizeof(values));
+#ifdef __linux__
+        if (m_leaderFd < 0)
+            return;
+
+        // nr, time_enabled, time_running, { value, id } * nr
+        uint64_t data[3 + 2 * PerfCounterCount];
+        if (read(m_leaderFd, data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)))
+            return;
+        uint64_t count = data[0];
+        double scale = (data[2] > 0 && data[2] < data[1]) ? (double)data[1] / (double)data[2] : 1.0;
+        for (uint64_t n = 0; n < count && n < PerfCounterCount; n++)
+        {
+            for (int i = 0; i < PerfCounterCount; i++)
+            {
+                if (m_fd[i] >= 0 && m_id[i] == data[4 + 2 * n])
+                {
+                    values.value[i] = (uint64_t)(data[3 + 2 * n] * scale);
+                    values.valid[i] = true;
+                }
+            }
+        }
+#endif
+    }
+
+    int m_fd[PerfCounterCount];
+    uint64_t m_id[PerfCounterCount];
+    int m_leaderFd;
+    PerfCounterValues m_begin;
+    uint64_t m_beginNs;
+    const char *m_error;
+};
+
+class PerfReport
+{
+public:
+    void Add(const char *kernel, uint64_t frameBytes, const PerfCounterValues &values)
+    {
+        Totals &totals = m_totals[std::make_pair(std::string(kernel), frameBytes)];
+        totals.calls++;
+        totals.wallNs += values.wallNs;
+        for (int i = 0; i < PerfCounterCount; i++)
+        {
+            if (values.valid[i])
+            {
+                totals.value[i] += values.value[i];
+                totals.validCalls[i]++;
+            }
+        }
+    }
+
+    void Reset() { m_totals.clear(); }
+    bool IsEmpty() const { return m_totals.empty(); }
+
+    void Print(FILE *out) const
+    {
+        fprintf(out, "%-24s %10s %7s %10s %8s %8s %9s %6s %11s %8s\n", "Kernel", "Bytes", "Calls", "us/call",
+            "GB/s", "CPU %", "Cycles/B", "IPC", "LLC miss/KB", "Br miss%");
+        for (std::map<Key, Totals>::const_iterator it = m_totals.begin(); it != m_totals.end(); ++it)
+        {
+            const Totals &t = it->second;
+            double bytes = (double)it->first.second * t.calls;
+            fprintf(out, "%-24s %10" PRIu64 " %7" PRIu64 " %10.1f %8.2f", it->first.first.c_str(), it->first.second,
+                t.calls, t.wallNs * 1e-3 / t.calls, t.wallNs ? bytes / t.wallNs : 0.0);
+            PrintColumn(out, t, PerfTaskClock, " %8.1f", t.wallNs ? 100.0 * t.value[PerfTaskClock] / t.wallNs : 0.0);
+            PrintColumn(out, t, PerfCycles, " %9.2f", bytes > 0 ? t.value[PerfCycles] / bytes : 0.0);
+            PrintColumn(out, t, PerfInstructions, " %6.2f",
+                t.value[PerfCycles] ? (double)t.value[PerfInstructions] / t.value[PerfCycles] : 0.0);
+            PrintColumn(out, t, PerfCacheMisses, " %11.2f", bytes > 0 ? t.value[PerfCacheMisses] * 1024.0 / bytes : 0.0);
+            PrintColumn(out, t, t.validCalls[PerfBranches] < t.validCalls[PerfBranchMisses] ? PerfBranches : PerfBranchMisses,
+                " %8.3f", t.value[PerfBranches] ? 100.0 * t.value[PerfBranchMisses] / t.value[PerfBranches] : 0.0);
+            fprintf(out, "\n");
+        }
+    }
+
+private:
+    typedef std::pair<std::string, uint64_t> Key;
+
+    struct Totals
+    {
+        uint64_t calls;
+        uint64_t wallNs;
+        uint64_t value[PerfCounterCount];
+        uint64_t validCalls[PerfCounterCount];
+
+        Totals() { memset(this, 0, sizeof(*this)); }
+    };
+
+    // Columns of counters that were not available in every call are shown as n/a
+    static void PrintColumn(FILE *out, const Totals &totals, int counter, const char *format, double value)
+    {
+        if (totals.validCalls[counter] == totals.calls && totals.calls > 0)
+        {
+            fprintf(out, format, value);
+        }
+        else
+        {
+            char width[16];
+            snprintf(width, sizeof(width), " %%%ds", atoi(format + 2));
+            fprintf(out, width, "n/a");
+        }
+    }
+
+    std::map<Key, Totals> m_totals;
+};
+
+// Measures the enclosing scope as one call of a kernel
+class PerfScope
+{
+public:
+    PerfScope(PerfCounters &counters, PerfReport &report, const char *kernel, uint64_t frameBytes)
+        : m_counters(counters), m_report(report), m_kernel(kernel), m_frameBytes(frameBytes)
+    {
+        m_counters.Begin();
+    }
+
+    ~PerfScope()
+    {
+        m_report.Add(m_kernel, m_frameBytes, m_counters.End());
+    }
+
+private:
+    PerfScope(const PerfScope &);
+    PerfScope &operator=(const PerfScope &);
+
+    PerfCounters &m_counters;
+    PerfReport &m_report;
+    const char *m_kernel;
+    uint64_t m_frameBytes;
+};
@@ -0,0 +1,149 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file PeriodicTimer.h
+//
+//  \brief
+//  Fixed rate timer with absolute deadlines, used to send software triggers at an exact cadence.
+//
+//  Description: deadlines are computed as start + n * period, so sleep and scheduling errors never
+//  accumulate into a drift of the rate. On Linux the thread sleeps with clock_nanosleep() on
+//  CLOCK_MONOTONIC (TIMER_ABSTIME) and, if spinNs is set, wakes up that much earlier and busy waits
+//  for the rest. A spin of 50-100 us removes most of the wakeup latency of a non real time kernel
+//  at the cost of one busy core during that window.
+//
+//  The wakeup error (actual time - deadline) of every period is recorded as trigger jitter.
+//  If a deadline is missed by more than a full period the missed ticks are skipped and counted
+//  as overruns, keeping the phase of the cadence.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cinttypes>
+
+#ifdef WIN32
+#include <thread>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include "HostClock.h"
+#include "LatencyHistogram.h"
+
+class PeriodicTimer
+{
+public:
+    PeriodicTimer(uint64_t periodNs, uint64_t spinNs = 0)
+        : m_periodNs(periodNs ? periodNs : 1), m_spinNs(spinNs), m_nextDeadlineNs(0), m_ticks(0), m_overruns(0)
+    {
+    }
+
+    static uint64_t PeriodFromRate(double rateHz)
+    {
+        return (rateHz > 0.0) ? (uint64_t)(1e9 / rateHz + 0.5) : 0;
+    }
+
+    // First deadline is one period after startNs (now if 0)
+    void Start(uint64_t startNs = 0)
+    {
+        m_nextDeadlineNs = (startNs ? startNs : HostNowNs()) + m_periodNs;
+        m_ticks = 0;
+        m_overruns = 0;
+        m_jitter.Reset();
+    }
+
+    // Blocks until the next deadline and returns it
+    uint64_t WaitNext()
+    {
+        uint64_t deadline = m_nextDeadlineNs;
+
+        if (deadline > m_spinNs)
+            SleepUntil(deadline - m_spinNs);
+        uint64_t now = HostNowNs();
+        while (now < deadline)
+            now = HostNowNs();
+
+        m_jitter.Record(now - deadline);
+        m_ticks++;
+
+        // Skip the ticks that are already over, without changing the phase
+        m_nextDeadlineNs = deadline + m_periodNs;
+        if (now >= m_nextDeadlineNs)
+        {
+            uint64_t missed = (now - m_nextDeadlineNs) / m_periodNs + 1;
+            m_overruns += missed;
+            m_nextDeadlineNs += missed * m_periodNs;
+        }
+        return deadline;
+    }
+
+    // Deadline the next WaitNext() returns
+    uint64_t GetNextDeadline() const { return m_nextDeadlineNs; }
+    uint64_t GetPeriod() const { return m_periodNs; }
+    uint64_t GetTicks() const { return m_ticks; }
+    uint64_t GetOverruns() const { return m_overruns; }
+    // Wakeup error per tick in ns
+    const LatencyHistogram &GetJitter() const { return m_jitter; }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "Timer period: %.3f us (%.3f Hz) Ticks: %" PRIu64 " Overruns: %" PRIu64 "\n",
+            m_periodNs / 1000.0, 1e9 / (double)m_periodNs, m_ticks, m_overruns);
+        m_jitter.Print(out, "Trigger jitter");
+    }
+
+private:
+    static void SleepUntil(uint64_t deadlineNs)
+    {
+#ifdef WIN32
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadlineNs))));
+#else
+        struct timespec ts;
+        ts.tv_sec = (time_t)(deadlineNs / 1000000000ull);
+        ts.tv_nsec = (long)(deadlineNs % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        {
+        }
+#endif
+    }
+
+    uint64_t m_periodNs;
+    uint64_t m_spinNs;
+    uint64_t m_nextDeadlineNs;
+    uint64_t m_ticks;
+    uint64_t m_overruns;
+    LatencyHistogram m_jitter;
+};
@@ -0,0 +1,129 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file PixelFormats.h
+//
+//  \brief
+//  Pixel formats handled by the helper classes, identified by their GenICam PFNC code.
+//
+//  Description: the camera reports its format as the string of the "PixelFormat" feature
+//  (GetFeatureEnum()). The helpers use the PFNC code of that format, which is also what other
+//  GenICam tools expect in files and shared memory.
+//
+//  Mono10p and Mono12p are packed LSB first without padding between pixels (4 pixels in 5 bytes,
+//  2 pixels in 3 bytes), see PackedPixels.h for the unpacking.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+enum FramePixelFormat : uint32_t
+{
+    FormatUnknown   = 0,
+    FormatMono8     = 0x01080001,
+    FormatMono16    = 0x01100007,
+    FormatMono10p   = 0x010A0046,
+    FormatMono12p   = 0x010C0047,
+    FormatBayerGR8  = 0x01080008,
+    FormatBayerRG8  = 0x01080009,
+    FormatBayerGB8  = 0x0108000A,
+    FormatBayerBG8  = 0x0108000B,
+    FormatRGB8      = 0x02180014,
+    FormatBGR8      = 0x02180015,
+};
+
+struct PixelFormatInfo
+{
+    FramePixelFormat format;
+    const char *name;           // Name of the "PixelFormat" enumeration entry
+    uint32_t bitsPerPixel;      // Bits on the wire, including packing
+    uint32_t channels;
+};
+
+inline const PixelFormatInfo *GetPixelFormatTable(int &count)
+{
+    static const PixelFormatInfo table[] =
+    {
+        { FormatMono8,      "Mono8",    8,  1 },
+        { FormatMono16,     "Mono16",   16, 1 },
+        { FormatMono10p,    "Mono10p",  10, 1 },
+        { FormatMono12p,    "Mono12p",  12, 1 },
+        { FormatBayerGR8,   "BayerGR8", 8,  1 },
+        { FormatBayerRG8,   "BayerRG8", 8,  1 },
+        { FormatBayerGB8,   "BayerGB8", 8,  1 },
+        { FormatBayerBG8,   "BayerBG8", 8,  1 },
+        { FormatRGB8,       "RGB8",     24, 3 },
+        { FormatBGR8,       "BGR8",     24, 3 },
+    };
+    count = (int)(sizeof(table) / sizeof(table[0]));
+    return table;
+}
+
+inline const PixelFormatInfo *FindPixelFormat(FramePixelFormat format)
+{
+    int count;
+    const PixelFormatInfo *table = GetPixelFormatTable(count);
+    for (int i = 0; i < count; i++)
+    {
+        if (table[i].format == format)
+            return &table[i];
+    }
+    return nullptr;
+}
+
+// Format from the string returned by GetFeatureEnum("PixelFormat", ...)
+inline FramePixelFormat ParsePixelFormat(const char *name)
+{
+    int count;
+    const PixelFormatInfo *table = GetPixelFormatTable(count);
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(table[i].name, name) == 0)
+            return table[i].format;
+    }
+    return FormatUnknown;
+}
+
+inline const char *PixelFormatName(FramePixelFormat format)
+{
+    const PixelFormatInfo *info = FindPixelFormat(format);
+    return info ? info->name : "Unknown";
+}
+
+// Bytes of one line of width pixels, rounded up to whole bytes
+inline uint64_t PixelFormatLineBytes(FramePixelFormat format, uint32_t width)
+{
+    const PixelFormatInfo *info = FindPixelFormat(format);
+    return info ? ((uint64_t)width * info->bitsPerPixel + 7) / 8 : 0;
+}
@@ -0,0 +1,341 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file PixelKernels.h
+//
+//  \brief
+//  Pixel processing kernels specialized on the pixel format at compile time, with one runtime
+//  dispatch per frame.
+//
+//  Description: the pixel format of a frame is only known at runtime. Checking it per pixel (or
+//  per line) costs branches in the innermost loop and keeps the compiler from vectorizing;
+//  writing one loop per format by hand multiplies the code. Here a kernel is a class with a
+//  member template
+//
+//      template <class Traits> void Run(const ImageView &view);
+//
+//  and DispatchPixelFormat() selects the PixelTraits of the frame once and calls Run() with
+//  them. Inside Run() everything about the format is a constant:
+//
+//      Traits::Sample      uint8_t or uint16_t, the type of an unpacked pixel
+//      Traits::Bits        significant bits of a pixel
+//      Traits::IsPacked    Mono10p/Mono12p, lines are unpacked by LineReader
+//      Traits::IsBayer     color filter array; Traits::Channel(x, y) gives 0 = R, 1 = G, 2 = B
+//
+//  LineReader<Traits> returns each line as an array of Samples: a pointer into the frame for the
+//  byte aligned formats, a per thread line buffer filled by the SIMD unpacking of PackedPixels.h
+//  for the packed ones (allocated once, not per frame).
+//
+//  FrameStatisticsKernel (minimum, maximum, mean per color channel) and ConvertTo8Kernel are the
+//  kernels used by the examples; new kernels follow the same pattern.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ImageView.h"
+#include "PackedPixels.h"
+#include "PixelFormats.h"
+
+// Bayer patterns as 2 bit channel codes of the pixels (0,0), (1,0), (0,1), (1,1)
+#define PF_BAYER_PATTERN(c00, c10, c01, c11) ((c00) | ((c10) << 2) | ((c01) << 4) | ((c11) << 6))
+
+template <FramePixelFormat F, class SampleType, int BitCount, bool Packed, int Pattern>
+struct PixelTraitsBase
+{
+    typedef SampleType Sample;
+    static const FramePixelFormat Format = F;
+    static const int Bits = BitCount;
+    static const bool IsPacked = Packed;
+    static const bool IsBayer = Pattern != 0;
+
+    // Color channel of pixel (x, y): 0 = R (or mono), 1 = G, 2 = B
+    static int Channel(uint32_t x, uint32_t y)
+    {
+        return (Pattern >> ((((y & 1) << 1) | (x & 1)) << 1)) & 3;
+    }
+
+    // Packed formats only: unpack a line to 16 bit samples
+    static void Unpack(const uint8_t *src, uint16_t *dst, size_t pixels)
+    {
+        if (F == FormatMono12p)
+            UnpackMono12p(src, dst, pixels);
+        else if (F == FormatMono10p)
+            UnpackMono10p(src, dst, pixels);
+    }
+
+    // Packed formats only: unpack a line to value >> shift, saturated to 8 bit
+    static void UnpackTo8(const uint8_t *src, uint8_t *dst, size_t pixels, int shift)
+    {
+        if (F == FormatMono12p)
+            UnpackMono12pTo8(src, dst, pixels, shift);
+        else if (F == FormatMono10p)
+            UnpackMono10pTo8(src, dst, pixels, shift);
+    }
+};
+
+template <FramePixelFormat F> struct PixelTraits;
+template <> struct PixelTraits<FormatMono8> : PixelTraitsBase<FormatMono8, uint8_t, 8, false, 0> {};
+template <> struct PixelTraits<FormatMono16> : PixelTraitsBase<FormatMono16, uint16_t, 16, false, 0> {};
+template <> struct PixelTraits<FormatMono10p> : PixelTraitsBase<FormatMono10p, uint16_t, 10, true, 0> {};
+template <> struct PixelTraits<FormatMono12p> : PixelTraitsBase<FormatMono12p, uint16_t, 12, true, 0> {};
+template <> struct PixelTraits<FormatBayerGR8> : PixelTraitsBase<FormatBayerGR8, uint8_t, 8, false, PF_BAYER_PATTERN(1, 0, 2, 1)> {};
+template <> struct PixelTraits<FormatBayerRG8> : PixelTraitsBase<FormatBayerRG8, uint8_t, 8, false, PF_BAYER_PATTERN(0, 1, 1, 2)> {};
+template <> struct PixelTraits<FormatBayerGB8> : PixelTraitsBase<FormatBayerGB8, uint8_t, 8, false, PF_BAYER_PATTERN(1, 2, 0, 1)> {};
+template <> struct PixelTraits<FormatBayerBG8> : PixelTraitsBase<FormatBayerBG8, uint8_t, 8, false, PF_BAYER_PATTERN(2, 1, 1, 0)> {};
+
+// Lines of a frame as arrays of Traits::Sample
+template <class Traits, bool Packed = Traits::IsPacked>
+class LineReader
+{
+public:
+    typedef typename Traits::Sample Sample;
+
+    explicit LineReader(const ImageView &view) : m_view(view) {}
+
+    const Sample *operator()(uint32_t y) const
+    {
+        return (const Sample *)m_view.Line(y);
+    }
+
+private:
+    ImageView m_view;
+};
+
+template <class Traits>
+class LineReader<Traits, true>
+{
+public:
+    typedef typename Traits::Sample Sample;
+
+    explicit LineReader(const ImageView &view) : m_view(view), m_line(LineBuffer())
+    {
+        if (m_line.size() < view.GetWidth())
+            m_line.resize(view.GetWidth());
+    }
+
+    // Valid until the next call
+    const Sample *operator()(uint32_t y) const
+    {
+        Traits::Unpack(m_view.Line(y), m_line.data(), m_view.GetWidth());
+        return m_line.data();
+    }
+
+private:
+    static std::vector<uint16_t> &LineBuffer()
+    {
+        static thread_local std::vector<uint16_t> line;
+        return line;
+    }
+
+    ImageView m_view;
+    std::vector<uint16_t> &m_line;
+};
+
+// Calls kernel.Run<PixelTraits<format of the view>>(view). Returns false for formats without traits.
+template <class Kernel>
+inline bool DispatchPixelFormat(const ImageView &view, Kernel &kernel)
+{
+    switch (view.GetFormat())
+    {
+    case FormatMono8:       kernel.template Run<PixelTraits<FormatMono8> >(view); return true;
+    case FormatMono16:      kernel.template Run<PixelTraits<FormatMono16> >(view); return true;
+    case FormatMono10p:     kernel.template Run<PixelTraits<FormatMono10p> >(view); return true;
+    case FormatMono12p:     kernel.template Run<PixelTraits<FormatMono12p> >(view); return true;
+    case FormatBayerGR8:    kernel.template Run<PixelTraits<FormatBayerGR8> >(view); return true;
+    case FormatBayerRG8:    kernel.template Run<PixelTraits<FormatBayerRG8> >(view); return true;
+    case FormatBayerGB8:    kernel.template Run<PixelTraits<FormatBayerGB8> >(view); return true;
+    case FormatBayerBG8:    kernel.template Run<PixelTraits<FormatBayerBG8> >(view); return true;
+    default:                return false;
+    }
+}
+
+// Minimum, maximum and mean per color channel (channel 0 only for mono formats)
+class FrameStatisticsKernel
+{
+public:
+    FrameStatisticsKernel() { Reset(); }
+
+    void Reset()
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            m_sum[channel] = 0;
+            m_count[channel] = 0;
+        }
+        m_minimum = 0xFFFF;
+        m_maximum = 0;
+        m_bits = 0;
+    }
+
+    template <class Traits>
+    void Run(const ImageView &view)
+    {
+        typedef typename Traits::Sample Sample;
+        LineReader<Traits> reader(view);
+        uint32_t width = view.GetWidth();
+        uint32_t minimum = 0xFFFF, maximum = 0;
+        Reset();
+        m_bits = Traits::Bits;
+
+        for (uint32_t y = 0; y < view.GetHeight(); y++)
+        {
+            const Sample *line = reader(y);
+            if (Traits::IsBayer)
+            {
+                // Even and odd columns have a fixed color per line
+                uint32_t sum[2] = { 0, 0 };
+                Sample lineMinimum = (Sample)~0, lineMaximum = 0;
+                uint32_t x = 0;
+                for (; x + 1 < width; x += 2)
+                {
+                    sum[0] += line[x];
+                    sum[1] += line[x + 1];
+                    Sample low = line[x] < line[x + 1] ? line[x] : line[x + 1];
+                    Sample high = line[x] < line[x + 1] ? line[x + 1] : line[x];
+                    lineMinimum = low < lineMinimum ? low : lineMinimum;
+                    lineMaximum = high > lineMaximum ? high : lineMaximum;
+                }
+                minimum = lineMinimum < minimum ? lineMinimum : minimum;
+                maximum = lineMaximum > maximum ? lineMaximum : maximum;
+                m_sum[Traits::Channel(0, y)] += sum[0];
+                m_count[Traits::Channel(0, y)] += x / 2;
+                m_sum[Traits::Channel(1, y)] += sum[1];
+                m_count[Traits::Channel(1, y)] += x / 2;
+                if (x < width)
+                {
+                    m_sum[Traits::Channel(x, y)] += line[x];
+                    m_count[Traits::Channel(x, y)]++;
+                    minimum = line[x] < minimum ? line[x] : minimum;
+                    maximum = line[x] > maximum ? line[x] : maximum;
+                }
+            }
+            else
+            {
+                uint32_t sum;
+                Sample lineMinimum, lineMaximum;
+                LineStatistics(line, width, sum, lineMinimum, lineMaximum);
+                minimum = lineMinimum < minimum ? lineMinimum : minimum;
+                maximum = lineMaximum > maximum ? lineMaximum : maximum;
+                m_sum[0] += sum;
+                m_count[0] += width;
+            }
+        }
+        m_minimum = minimum;
+        m_maximum = maximum;
+    }
+
+    uint32_t GetMinimum() const { return m_minimum; }
+    uint32_t GetMaximum() const { return m_maximum; }
+    int GetBits() const { return m_bits; }
+
+    double GetMean(int channel = 0) const
+    {
+        return m_count[channel] ? (double)m_sum[channel] / (double)m_count[channel] : 0.0;
+    }
+
+private:
+    // Per line in the sample type and 32 bit, so the compiler vectorizes the loop
+    // (sums exact for lines up to 65537 pixels)
+    template <class Sample>
+    static void LineStatistics(const Sample *line, uint32_t width, uint32_t &sum, Sample &minimum, Sample &maximum)
+    {
+        uint32_t lineSum = 0;
+        Sample lineMinimum = (Sample)~0, lineMaximum = 0;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            lineSum += line[x];
+            lineMinimum = line[x] < lineMinimum ? line[x] : lineMinimum;
+            lineMaximum = line[x] > lineMaximum ? line[x] : lineMaximum;
+        }
+        sum = lineSum;
+        minimum = lineMinimum;
+        maximum = lineMaximum;
+    }
+
+    uint64_t m_sum[3];
+    uint64_t m_count[3];
+    uint32_t m_minimum;
+    uint32_t m_maximum;
+    int m_bits;
+};
+
+// Converts to an 8 bit view of the same size, keeping the 8 bits below the shift
+// (default: the 8 most significant bits of the format). Packed lines are unpacked straight to
+// 8 bit by the SIMD kernels of PackedPixels.h, without the 16 bit line in between.
+class ConvertTo8Kernel
+{
+public:
+    explicit ConvertTo8Kernel(const ImageView &destination, int shift = -1)
+        : m_destination(destination), m_shift(shift)
+    {
+    }
+
+    template <class Traits>
+    void Run(const ImageView &view)
+    {
+        typedef typename Traits::Sample Sample;
+        const int shift = m_shift >= 0 ? m_shift : Traits::Bits - 8;
+        uint32_t width = view.GetWidth() < m_destination.GetWidth() ? view.GetWidth() : m_destination.GetWidth();
+        uint32_t height = view.GetHeight() < m_destination.GetHeight() ? view.GetHeight() : m_destination.GetHeight();
+
+        if (Traits::IsPacked)
+        {
+            for (uint32_t y = 0; y < height; y++)
+                Traits::UnpackTo8(view.Line(y), m_destination.Line(y), width, shift);
+            return;
+        }
+        LineReader<Traits> reader(view);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const Sample *line = reader(y);
+            uint8_t *dst = m_destination.Line(y);
+            if (sizeof(Sample) == 1 && shift == 0)
+            {
+                memcpy(dst, line, width);
+                continue;
+            }
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t value = (uint32_t)line[x] >> shift;
+                dst[x] = (uint8_t)(value > 255 ? 255 : value);
+            }
+        }
+    }
+
+private:
+    ImageView m_destination;
+    int m_shift;
+};
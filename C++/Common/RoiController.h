@@ -0,0 +1,445 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file RoiController.h
+//
+//  \brief
+//  Moves and resizes the sensor window (Width, Height, OffsetX, OffsetY) around a tracked target
+//  while grabbing, so a small target is read out at several times the full frame rate.
+//
+//  Description: the frame rate of a CMOS camera grows roughly with 1 / Height (and the link
+//  throughput with 1 / (Width * Height)). The controller keeps the ROI as small as the target
+//  allows and follows it:
+//
+//  1. ROI sizes are quantized to size classes (sensor size / 1, 2, 4, 8 for width and height
+//     independently, aligned to the increments of the camera). Only a few payload sizes ever occur.
+//  2. Hysteresis: the ROI moves when the target leaves the middle half of the free space around
+//     it. Per axis it grows as soon as the target does not fit and shrinks only after the target
+//     fits a smaller class for ShrinkFrames frames, also when the other axis grows at the same
+//     time. It goes back to full frame after LostFrames frames without target. This keeps the
+//     number of reconfigurations low.
+//  3. Moving with the same size only writes OffsetX/OffsetY, which most cameras accept while
+//     grabbing. A size change (or an offset the camera refuses while grabbing) stops the stream,
+//     writes the features in an order that is valid at every step and starts the stream again.
+//
+//  The controller does not know the SDK: SetFeature, GetFeature, StopStream and StartStream are
+//  callbacks. Frames already in flight after a change still have the old geometry, so the
+//  application passes the geometry of every frame to RecordFrame() and maps the target to sensor
+//  coordinates with it. No new decision is taken until a frame of the new ROI arrived (at most
+//  SettleFrames frames). If a write fails halfway, the ROI the camera has is read back.
+//
+//  PrintReport() shows the frame rate reached with every ROI size against the full frame rate and
+//  the time the reconfigurations cost.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "HostClock.h"
+#include "LatencyHistogram.h"
+
+struct RoiRect
+{
+    uint32_t offsetX;
+    uint32_t offsetY;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Sensor size and increments, from the feature parameters of Width, Height, OffsetX and OffsetY
+struct RoiLimits
+{
+    uint32_t sensorWidth;
+    uint32_t sensorHeight;
+    uint32_t minWidth;
+    uint32_t minHeight;
+    uint32_t widthInc;
+    uint32_t heightInc;
+    uint32_t offsetXInc;
+    uint32_t offsetYInc;
+};
+
+class RoiController
+{
+public:
+    static const int SizeClasses = 4;
+    static const int ShrinkFrames = 30;
+    static const int LostFrames = 10;
+    static const int SettleFrames = 16;
+
+    typedef std::function<bool(const char *feature, int64_t value)> SetFeatureFunction;
+    typedef std::function<bool(const char *feature, int64_t &value)> GetFeatureFunction;
+    typedef std::function<bool()> StreamFunction;
+
+    // margin: free space kept on each side of the target, relative to the target size
+    RoiController(const RoiLimits &limits, double margin = 0.5, uint32_t minMarginPixels = 16)
+        : m_limits(limits), m_margin(margin), m_minMargin(minMarginPixels), m_widthClass(0), m_heightClass(0),
+          m_lostCount(0), m_settleFrames(0), m_lastFrameNs(0), m_lastClass(-1), m_reconfigurations(0),
+          m_offsetOnly(0), m_stats(SizeClasses * SizeClasses)
+    {
+        m_shrinkCount[0] = 0;
+        m_shrinkCount[1] = 0;
+        if (m_limits.widthInc == 0) m_limits.widthInc = 1;
+        if (m_limits.heightInc == 0) m_limits.heightInc = 1;
+        if (m_limits.offsetXInc == 0) m_limits.offsetXInc = 1;
+        if (m_limits.offsetYInc == 0) m_limits.offsetYInc = 1;
+        m_roi.offsetX = 0;
+        m_roi.offsetY = 0;
+        m_roi.width = m_limits.sensorWidth;
+        m_roi.height = m_limits.sensorHeight;
+    }
+
+    void SetCallbacks(SetFeatureFunction setFeature, GetFeatureFunction getFeature, StreamFunction stopStream,
+        StreamFunction startStream)
+    {
+        m_setFeature = setFeature;
+        m_getFeature = getFeature;
+        m_stopStream = stopStream;
+        m_startStream = startStream;
+    }
+
+    // ROI written to the camera; frames in flight may still have the previous one
+    const RoiRect &GetRoi() const { return m_roi; }
+
+    // Writes the full frame ROI, before grabbing
+    bool Reset()
+    {
+        RoiRect full = { 0, 0, m_limits.sensorWidth, m_limits.sensorHeight };
+        m_widthClass = 0;
+        m_heightClass = 0;
+        m_shrinkCount[0] = 0;
+        m_shrinkCount[1] = 0;
+        m_lostCount = 0;
+        m_settleFrames = 0;
+        m_roi = full;
+        // Offsets first, whatever ROI the camera had before
+        bool ok = m_setFeature && m_setFeature("OffsetX", 0) && m_setFeature("OffsetY", 0) &&
+            m_setFeature("Width", full.width) && m_setFeature("Height", full.height);
+        if (!ok)
+            ReadBack();
+        return ok;
+    }
+
+    // Target bounding box in sensor coordinates. Returns true if the ROI was changed.
+    bool Track(double centerX, double centerY, double targetWidth, double targetHeight)
+    {
+        m_lostCount = 0;
+        // The target was found in a frame of the previous ROI, it has moved on since
+        if (m_settleFrames > 0)
+            return false;
+
+        // Per axis: grow immediately, shrink only when the smaller class fits for a while
+        int widthClass = Hysteresis(FitClass(targetWidth, true), m_widthClass, m_shrinkCount[0]);
+        int heightClass = Hysteresis(FitClass(targetHeight, false), m_heightClass, m_shrinkCount[1]);
+        if (widthClass == m_widthClass && heightClass == m_heightClass)
+        {
+            // Same size: move only when the target leaves the middle half of the free space
+            double slackX = ((double)m_roi.width - targetWidth) / 4.0;
+            double slackY = ((double)m_roi.height - targetHeight) / 4.0;
+            double dx = centerX - (m_roi.offsetX + m_roi.width / 2.0);
+            double dy = centerY - (m_roi.offsetY + m_roi.height / 2.0);
+            if (dx < slackX && -dx < slackX && dy < slackY && -dy < slackY)
+                return false;
+        }
+
+        RoiRect roi;
+        roi.width = ClassWidth(widthClass);
+        roi.height = ClassHeight(heightClass);
+        roi.offsetX = CenterOffset(centerX, roi.width, m_limits.sensorWidth, m_limits.offsetXInc);
+        roi.offsetY = CenterOffset(centerY, roi.height, m_limits.sensorHeight, m_limits.offsetYInc);
+        if (SameRoi(roi, m_roi))
+            return false;
+        return Apply(roi, widthClass, heightClass);
+    }
+
+    // No target in this frame. Returns true if the ROI went back to full frame.
+    bool Lost()
+    {
+        if (m_widthClass == 0 && m_heightClass == 0)
+            return false;
+        if (m_settleFrames > 0 || ++m_lostCount < LostFrames)
+            return false;
+        m_lostCount = 0;
+        RoiRect full = { 0, 0, m_limits.sensorWidth, m_limits.sensorHeight };
+        return Apply(full, 0, 0);
+    }
+
+    // Call for every grabbed frame, with the host time it arrived and its geometry
+    void RecordFrame(uint64_t hostNs, const RoiRect &frame)
+    {
+        if (m_settleFrames > 0)
+            m_settleFrames = SameRoi(frame, m_roi) ? 0 : m_settleFrames - 1;
+        // Intervals between two frames of the same size class
+        int sizeClass = ClassIndex(frame);
+        if (m_lastFrameNs != 0 && sizeClass >= 0 && sizeClass == m_lastClass)
+        {
+            ClassStats &stats = m_stats[sizeClass];
+            stats.frames++;
+            stats.ns += hostNs - m_lastFrameNs;
+        }
+        m_lastFrameNs = hostNs;
+        m_lastClass = sizeClass;
+    }
+
+    // Frame rate measured with the current ROI size, 0 before the second frame
+    double GetFps() const
+    {
+        return Fps(m_stats[m_widthClass * SizeClasses + m_heightClass]);
+    }
+
+    void PrintReport(FILE *out) const
+    {
+        double fullFps = Fps(m_stats[0]);
+        fprintf(out, "ROI size       frames      fps    gain\n");
+        for (int w = 0; w < SizeClasses; w++)
+        {
+            for (int h = 0; h < SizeClasses; h++)
+            {
+                const ClassStats &stats = m_stats[w * SizeClasses + h];
+                if (stats.frames == 0)
+                    continue;
+                char size[32];
+                snprintf(size, sizeof(size), "%ux%u", ClassWidth(w), ClassHeight(h));
+                if (fullFps > 0.0)
+                    fprintf(out, "%-12s %8llu %8.1f %6.2fx\n", size, (unsigned long long)stats.frames, Fps(stats), Fps(stats) / fullFps);
+                else
+                    fprintf(out, "%-12s %8llu %8.1f     n/a\n", size, (unsigned long long)stats.frames, Fps(stats));
+            }
+        }
+        fprintf(out, "Reconfigurations: %llu (%llu offset only)", (unsigned long long)m_reconfigurations, (unsigned long long)m_offsetOnly);
+        if (m_reconfigureTime.GetCount() > 0)
+        {
+            fprintf(out, ", mean %.2f ms, max %.2f ms", m_reconfigureTime.GetMean() / 1e6, m_reconfigureTime.GetMax() / 1e6);
+        }
+        fprintf(out, "\n");
+    }
+
+private:
+    struct ClassStats
+    {
+        ClassStats() : frames(0), ns(0) {}
+        uint64_t frames;
+        uint64_t ns;
+    };
+
+    static double Fps(const ClassStats &stats)
+    {
+        return stats.ns > 0 ? stats.frames * 1e9 / (double)stats.ns : 0.0;
+    }
+
+    uint32_t ClassWidth(int sizeClass) const
+    {
+        return ClassSize(m_limits.sensorWidth, m_limits.minWidth, m_limits.widthInc, sizeClass);
+    }
+
+    uint32_t ClassHeight(int sizeClass) const
+    {
+        return ClassSize(m_limits.sensorHeight, m_limits.minHeight, m_limits.heightInc, sizeClass);
+    }
+
+    static uint32_t ClassSize(uint32_t sensor, uint32_t minimum, uint32_t increment, int sizeClass)
+    {
+        uint32_t size = sensor >> sizeClass;
+        size = (size + increment - 1) / increment * increment;
+        if (size < minimum)
+            size = (minimum + increment - 1) / increment * increment;
+        return size > sensor ? sensor : size;
+    }
+
+    static bool SameRoi(const RoiRect &a, const RoiRect &b)
+    {
+        return a.offsetX == b.offsetX && a.offsetY == b.offsetY && a.width == b.width && a.height == b.height;
+    }
+
+    // Index into m_stats of a frame size, -1 for a size that is no class
+    int ClassIndex(const RoiRect &frame) const
+    {
+        int widthClass = -1, heightClass = -1;
+        for (int sizeClass = SizeClasses - 1; sizeClass >= 0; sizeClass--)
+        {
+            if (ClassWidth(sizeClass) == frame.width)
+                widthClass = sizeClass;
+            if (ClassHeight(sizeClass) == frame.height)
+                heightClass = sizeClass;
+        }
+        return (widthClass < 0 || heightClass < 0) ? -1 : widthClass * SizeClasses + heightClass;
+    }
+
+    // Class of one axis after the hysteresis: a larger size at once, a smaller one after ShrinkFrames
+    static int Hysteresis(int fitClass, int currentClass, int &shrinkCount)
+    {
+        if (fitClass <= currentClass)
+        {
+            shrinkCount = 0;
+            return fitClass;
+        }
+        if (++shrinkCount < ShrinkFrames)
+            return currentClass;
+        shrinkCount = 0;
+        return fitClass;
+    }
+
+    // Smallest class holding the target and its margin
+    int FitClass(double targetSize, bool horizontal) const
+    {
+        double margin = targetSize * m_margin;
+        if (margin < m_minMargin)
+            margin = m_minMargin;
+        double needed = targetSize + 2.0 * margin;
+        for (int sizeClass = SizeClasses - 1; sizeClass > 0; sizeClass--)
+        {
+            if ((horizontal ? ClassWidth(sizeClass) : ClassHeight(sizeClass)) >= needed)
+                return sizeClass;
+        }
+        return 0;
+    }
+
+    // Smallest class holding a size
+    int ContainingClass(uint32_t size, bool horizontal) const
+    {
+        for (int sizeClass = SizeClasses - 1; sizeClass > 0; sizeClass--)
+        {
+            if ((horizontal ? ClassWidth(sizeClass) : ClassHeight(sizeClass)) >= size)
+                return sizeClass;
+        }
+        return 0;
+    }
+
+    static uint32_t CenterOffset(double center, uint32_t size, uint32_t sensor, uint32_t increment)
+    {
+        double offset = center - size / 2.0;
+        double maximum = (double)(sensor - size);
+        if (offset < 0.0)
+            offset = 0.0;
+        if (offset > maximum)
+            offset = maximum;
+        return (uint32_t)(offset + 0.5) / increment * increment;
+    }
+
+    bool Apply(const RoiRect &roi, int widthClass, int heightClass)
+    {
+        uint64_t start = HostNowNs();
+        bool sizeChanged = roi.width != m_roi.width || roi.height != m_roi.height;
+        bool ok = false;
+        if (!sizeChanged)
+        {
+            // Offsets can usually be written while grabbing
+            ok = m_setFeature && m_setFeature("OffsetX", roi.offsetX) && m_setFeature("OffsetY", roi.offsetY);
+            if (ok)
+                m_offsetOnly++;
+        }
+        if (!ok)
+        {
+            if (m_stopStream)
+                m_stopStream();
+            ok = WriteRoi(roi, m_roi);
+            if (m_startStream && !m_startStream())
+                ok = false;
+        }
+        m_reconfigureTime.Record(HostNowNs() - start);
+        m_reconfigurations++;
+        // The gap around the reconfiguration does not count for any ROI size
+        m_lastFrameNs = 0;
+        m_settleFrames = SettleFrames;
+        if (!ok)
+        {
+            // Some of the features may be written: continue from what the camera has
+            RoiRect previous = m_roi;
+            ReadBack();
+            return !SameRoi(previous, m_roi);
+        }
+        m_roi = roi;
+        m_widthClass = widthClass;
+        m_heightClass = heightClass;
+        return true;
+    }
+
+    // Takes the ROI of the camera after a failed write. Without a GetFeature callback the
+    // previous ROI is kept and the next Track() writes it again.
+    void ReadBack()
+    {
+        int64_t offsetX, offsetY, width, height;
+        if (!m_getFeature || !m_getFeature("OffsetX", offsetX) || !m_getFeature("OffsetY", offsetY) ||
+            !m_getFeature("Width", width) || !m_getFeature("Height", height))
+            return;
+        m_roi.offsetX = (uint32_t)offsetX;
+        m_roi.offsetY = (uint32_t)offsetY;
+        m_roi.width = (uint32_t)width;
+        m_roi.height = (uint32_t)height;
+        m_widthClass = ContainingClass(m_roi.width, true);
+        m_heightClass = ContainingClass(m_roi.height, false);
+    }
+
+    // Every intermediate state must be valid: OffsetX + Width <= sensor width at each step,
+    // so a smaller size is written before its offset and a larger size after it
+    bool WriteRoi(const RoiRect &roi, const RoiRect &current)
+    {
+        if (!m_setFeature)
+            return false;
+        bool ok = true;
+        if (roi.width <= current.width)
+            ok = m_setFeature("Width", roi.width) && m_setFeature("OffsetX", roi.offsetX);
+        else
+            ok = m_setFeature("OffsetX", roi.offsetX) && m_setFeature("Width", roi.width);
+        if (!ok)
+            return false;
+        if (roi.height <= current.height)
+            ok = m_setFeature("Height", roi.height) && m_setFeature("OffsetY", roi.offsetY);
+        else
+            ok = m_setFeature("OffsetY", roi.offsetY) && m_setFeature("Height", roi.height);
+        return ok;
+    }
+
+    RoiLimits m_limits;
+    double m_margin;
+    uint32_t m_minMargin;
+    RoiRect m_roi;
+    int m_widthClass;
+    int m_heightClass;
+    int m_shrinkCount[2];
+    int m_lostCount;
+    int m_settleFrames;
+    uint64_t m_lastFrameNs;
+    int m_lastClass;
+    uint64_t m_reconfigurations;
+    uint64_t m_offsetOnly;
+    std::vector<ClassStats> m_stats;
+    LatencyHistogram m_reconfigureTime;
+    SetFeatureFunction m_setFeature;
+    GetFeatureFunction m_getFeature;
+    StreamFunction m_stopStream;
+    StreamFunction m_startStream;
+};
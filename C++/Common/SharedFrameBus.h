@@ -0,0 +1,361 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file SharedFrameBus.h
+//
+//  \brief
+//  Publishes frames into a POSIX shared memory ring, so any number of local processes can read
+//  them while a single process owns the camera.
+//
+//  Description: the publisher creates /dev/shm/<name> with a header page followed by slotCount
+//  slots. Each slot has a 64 byte header and the pixel data, starting on a 64 byte boundary.
+//  The layout is fixed (little endian, see the structures below) so readers in other languages
+//  can map it; V2/SharedFrameBus.py does so for NumPy without copying.
+//
+//  Every slot is protected by a sequence lock. The publisher makes the sequence odd, writes the
+//  slot and makes it even again. A reader takes the sequence before using the data and checks it
+//  afterwards; if it changed, the slot was overwritten while it was being read and the frame must
+//  be dropped. Readers never write to the mapping, so a slow reader cannot stall the publisher;
+//  it only loses frames, which it can see from the frame numbers.
+//
+//  Only available on Linux (shm_open). Link with -lrt on older glibc.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <string>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "PixelFormats.h"
+
+static const char SharedFrameBusMagic[8] = { 'P', 'F', 'F', 'R', 'B', 'U', 'S', 0 };
+static const uint32_t SharedFrameBusVersion = 1;
+
+// First page of the mapping
+struct SharedFrameBusHeader
+{
+    char magic[8];                      // "PFFRBUS\0"
+    uint32_t version;
+    uint32_t headerBytes;               // Offset of the first slot
+    uint32_t slotCount;
+    uint32_t slotHeaderBytes;           // Offset of the pixel data inside a slot
+    uint64_t slotBytes;                 // Distance between two slots
+    uint64_t dataBytes;                 // Maximum frame size
+    std::atomic<uint64_t> published;    // Number of frames published so far
+    uint32_t publisherPid;
+    uint32_t reserved;
+};
+
+// Header of every slot
+struct SharedFrameSlot
+{
+    std::atomic<uint64_t> sequence;     // Odd while the publisher writes the slot
+    uint64_t frameNumber;               // Publish count, 0 for the first frame
+    int64_t frameCounter;               // Camera frame counter (block ID)
+    uint64_t timestamp;                 // Camera timestamp
+    uint64_t hostNs;                    // Host monotonic arrival time
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;                    // Bytes per line
+    uint32_t pixelFormat;               // PFNC code, see PixelFormats.h
+    uint32_t dataSize;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8, "lock free 64 bit atomics required");
+static_assert(sizeof(SharedFrameSlot) <= 64, "slot header must fit in one cache line");
+
+// Description of a frame to publish
+struct SharedFrameInfo
+{
+    int64_t frameCounter;
+    uint64_t timestamp;
+    uint64_t hostNs;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    FramePixelFormat pixelFormat;
+};
+
+class SharedFrameBusPublisher
+{
+public:
+    static const uint32_t HeaderBytes = 4096;
+    static const uint32_t SlotHeaderBytes = 64;
+
+    SharedFrameBusPublisher()
+        : m_fd(-1), m_mapping(nullptr), m_mappedBytes(0), m_header(nullptr), m_writing(nullptr)
+    {
+    }
+
+    ~SharedFrameBusPublisher()
+    {
+        Close();
+    }
+
+    // Creates (or replaces) the bus /dev/shm/<name>, e.g. "pf_camera0"
+    bool Create(const char *name, uint32_t slotCount, uint64_t maxFrameBytes)
+    {
+#ifdef WIN32
+        (void)name; (void)slotCount; (void)maxFrameBytes;
+        return false;
+#else
+        Close();
+        if (slotCount < 2 || maxFrameBytes == 0)
+            return false;
+
+        m_name = (name[0] == '/') ? name : std::string("/") + name;
+        uint64_t slotBytes = SlotHeaderBytes + ((maxFrameBytes + 63) & ~63ull);
+        m_mappedBytes = HeaderBytes + slotBytes * slotCount;
+
+        shm_unlink(m_name.c_str());
+        m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (m_fd < 0)
+            return false;
+        if (ftruncate(m_fd, (off_t)m_mappedBytes) != 0)
+        {
+            Close();
+            return false;
+        }
+        void *mapping = mmap(NULL, m_mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            Close();
+            return false;
+        }
+        m_mapping = (uint8_t *)mapping;
+        // Fault in the whole ring now rather than while publishing
+        memset(m_mapping, 0, m_mappedBytes);
+
+        m_header = new (m_mapping) SharedFrameBusHeader;
+        m_header->version = SharedFrameBusVersion;
+        m_header->headerBytes = HeaderBytes;
+        m_header->slotCount = slotCount;
+        m_header->slotHeaderBytes = SlotHeaderBytes;
+        m_header->slotBytes = slotBytes;
+        m_header->dataBytes = slotBytes - SlotHeaderBytes;
+        m_header->published.store(0);
+        m_header->publisherPid = (uint32_t)getpid();
+        for (uint32_t i = 0; i < slotCount; i++)
+            new (m_mapping + HeaderBytes + slotBytes * i) SharedFrameSlot;
+        // Readers check the magic last, it marks the header as complete
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(m_header->magic, SharedFrameBusMagic, sizeof(SharedFrameBusMagic));
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+#ifndef WIN32
+        if (m_mapping)
+            munmap(m_mapping, m_mappedBytes);
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            shm_unlink(m_name.c_str());
+        }
+#endif
+        m_fd = -1;
+        m_mapping = nullptr;
+        m_header = nullptr;
+        m_writing = nullptr;
+    }
+
+    bool IsOpen() const { return m_header != nullptr; }
+    uint64_t GetMaxFrameBytes() const { return m_header ? m_header->dataBytes : 0; }
+    uint64_t GetPublished() const { return m_header ? m_header->published.load(std::memory_order_relaxed) : 0; }
+
+    // Starts writing the next slot and returns its data area, so a producer can write (e.g.
+    // demodulate) straight into shared memory. Must be followed by CommitWrite().
+    uint8_t *BeginWrite()
+    {
+        if (!m_header || m_writing)
+            return nullptr;
+        uint64_t number = m_header->published.load(std::memory_order_relaxed);
+        m_writing = Slot(number % m_header->slotCount);
+        uint64_t sequence = m_writing->sequence.load(std::memory_order_relaxed);
+        m_writing->sequence.store(sequence + 1, std::memory_order_relaxed);
+        // Data writes must not become visible before the odd sequence
+        std::atomic_thread_fence(std::memory_order_release);
+        return (uint8_t *)m_writing + SlotHeaderBytes;
+    }
+
+    void CommitWrite(const SharedFrameInfo &info, uint32_t dataSize)
+    {
+        if (!m_writing)
+            return;
+        uint64_t number = m_header->published.load(std::memory_order_relaxed);
+        m_writing->frameNumber = number;
+        m_writing->frameCounter = info.frameCounter;
+        m_writing->timestamp = info.timestamp;
+        m_writing->hostNs = info.hostNs;
+        m_writing->width = info.width;
+        m_writing->height = info.height;
+        m_writing->stride = info.stride;
+        m_writing->pixelFormat = (uint32_t)info.pixelFormat;
+        m_writing->dataSize = dataSize;
+        uint64_t sequence = m_writing->sequence.load(std::memory_order_relaxed);
+        m_writing->sequence.store(sequence + 1, std::memory_order_release);
+        m_header->published.store(number + 1, std::memory_order_release);
+        m_writing = nullptr;
+    }
+
+    // Copies one frame into the next slot
+    bool Publish(const SharedFrameInfo &info, const uint8_t *data, uint64_t dataSize)
+    {
+        if (!m_header || dataSize > m_header->dataBytes)
+            return false;
+        uint8_t *target = BeginWrite();
+        if (!target)
+            return false;
+        memcpy(target, data, (size_t)dataSize);
+        CommitWrite(info, (uint32_t)dataSize);
+        return true;
+    }
+
+private:
+    SharedFrameSlot *Slot(uint64_t index) const
+    {
+        return (SharedFrameSlot *)(m_mapping + m_header->headerBytes + m_header->slotBytes * index);
+    }
+
+    std::string m_name;
+    int m_fd;
+    uint8_t *m_mapping;
+    uint64_t m_mappedBytes;
+    SharedFrameBusHeader *m_header;
+    SharedFrameSlot *m_writing;
+};
+
+// Read only access for C++ consumers
+class SharedFrameBusReader
+{
+public:
+    SharedFrameBusReader()
+        : m_mapping(nullptr), m_mappedBytes(0), m_header(nullptr)
+    {
+    }
+
+    ~SharedFrameBusReader()
+    {
+        Close();
+    }
+
+    bool Open(const char *name)
+    {
+#ifdef WIN32
+        (void)name;
+        return false;
+#else
+        Close();
+        std::string path = (name[0] == '/') ? name : std::string("/") + name;
+        int fd = shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedFrameBusHeader))
+        {
+            close(fd);
+            return false;
+        }
+        void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+        m_mapping = (const uint8_t *)mapping;
+        m_mappedBytes = (size_t)info.st_size;
+        m_header = (const SharedFrameBusHeader *)m_mapping;
+        if (memcmp(m_header->magic, SharedFrameBusMagic, sizeof(SharedFrameBusMagic)) != 0 ||
+            m_header->version != SharedFrameBusVersion)
+        {
+            Close();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+#ifndef WIN32
+        if (m_mapping)
+            munmap((void *)m_mapping, m_mappedBytes);
+#endif
+        m_mapping = nullptr;
+        m_header = nullptr;
+    }
+
+    uint64_t GetPublished() const
+    {
+        return m_header ? m_header->published.load(std::memory_order_acquire) : 0;
+    }
+
+    // Maps frame number 'frameNumber' without copying. Returns the sequence to pass to
+    // IsStillValid() once the data has been used, or 0 if the frame is not available (not
+    // published yet, already overwritten or being written).
+    uint64_t Peek(uint64_t frameNumber, const SharedFrameSlot *&slot, const uint8_t *&data) const
+    {
+        if (!m_header || frameNumber >= GetPublished())
+            return 0;
+        slot = (const SharedFrameSlot *)(m_mapping + m_header->headerBytes +
+            m_header->slotBytes * (frameNumber % m_header->slotCount));
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) || slot->frameNumber != frameNumber)
+            return 0;
+        data = (const uint8_t *)slot + m_header->slotHeaderBytes;
+        return sequence;
+    }
+
+    // True if the slot was not overwritten since Peek()
+    bool IsStillValid(const SharedFrameSlot *slot, uint64_t sequence) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+private:
+    const uint8_t *m_mapping;
+    size_t m_mappedBytes;
+    const SharedFrameBusHeader *m_header;
+};
@@ -0,0 +1,259 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file SimulatedStream.h
+//
+//  \brief
+//  Stand-in for PFStream that produces frames at a fixed rate, to run a grab loop without a
+//  camera.
+//
+//  Description: a camera stream fills the free buffers of its ring at the frame rate and hands
+//  them to the application in order; a frame that arrives while every buffer is held by the
+//  application is lost. SimulatedStream does the same with a producer thread:
+//
+//  - Open() allocates bufferCount frames in a FrameBufferPool
+//  - Start() produces frames with a PeriodicTimer at the given rate. Every frame gets the next
+//    frame counter (GigE Vision style, 1 to 65535) and the host time as timestamp. Its data is
+//    written like a DMA transfer would: the pattern is copied into the buffer, so the producer
+//    costs memory bandwidth as a real stream does.
+//  - no free buffer: the frame is dropped, its counter is skipped, the consumer sees the gap
+//  - GetNextBuffer() and ReleaseBuffer() work like the PFStream methods
+//
+//  SimulatedBuffer has the PFBuffer getters the grab loops use (GetRawData(), GetFrameCounter(),
+//  GetTimestamp()), so their loop bodies carry over unchanged.
+//
+//  Producer ticks the host can not keep up with are skipped by the timer and reported by
+//  GetOverruns(); they are not frames of the stream and not counted as lost.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameBufferPool.h"
+#include "HostClock.h"
+#include "PeriodicTimer.h"
+
+class SimulatedBuffer
+{
+public:
+    SimulatedBuffer()
+        : m_data(nullptr), m_frameCounter(0), m_timestamp(0)
+    {
+    }
+
+    uint8_t *GetRawData() const
+    {
+        return m_data;
+    }
+
+    int64_t GetFrameCounter() const
+    {
+        return m_frameCounter;
+    }
+
+    // Host time of the production in nanoseconds
+    uint64_t GetTimestamp() const
+    {
+        return m_timestamp;
+    }
+
+private:
+    friend class SimulatedStream;
+
+    uint8_t *m_data;
+    int64_t m_frameCounter;
+    uint64_t m_timestamp;
+};
+
+class SimulatedStream
+{
+public:
+    SimulatedStream()
+        : m_frameBytes(0), m_running(false), m_counter(0), m_produced(0), m_dropped(0), m_overruns(0)
+    {
+    }
+
+    ~SimulatedStream()
+    {
+        Stop();
+    }
+
+    // Allocates the ring; pattern (frameBytes) is the content of every frame, random if null
+    bool Open(size_t frameBytes, int bufferCount, const uint8_t *pattern = nullptr)
+    {
+        Stop();
+        if (!m_pool.Allocate(frameBytes, bufferCount, true, false))
+            return false;
+        m_frameBytes = frameBytes;
+        m_pattern.resize(frameBytes);
+        if (pattern != nullptr)
+            memcpy(m_pattern.data(), pattern, frameBytes);
+        else
+        {
+            uint32_t state = 2463534242u;
+            for (size_t i = 0; i < frameBytes; i++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                m_pattern[i] = (uint8_t)state;
+            }
+        }
+        m_buffers.assign(bufferCount, SimulatedBuffer());
+        m_free.clear();
+        m_ready.clear();
+        for (int i = 0; i < bufferCount; i++)
+        {
+            m_buffers[i].m_data = m_pool.GetFrame(i);
+            m_free.push_back(&m_buffers[i]);
+        }
+        return true;
+    }
+
+    void Start(double frameRate)
+    {
+        Stop();
+        m_produced = 0;
+        m_dropped = 0;
+        m_overruns = 0;
+        m_running = true;
+        m_producer = std::thread(&SimulatedStream::Produce, this, PeriodicTimer::PeriodFromRate(frameRate));
+    }
+
+    // Stops producing; buffers already delivered stay valid until released
+    void Stop()
+    {
+        if (!m_producer.joinable())
+            return;
+        m_running = false;
+        m_producer.join();
+        m_readySignal.notify_all();
+    }
+
+    // Next produced frame in order, false if none arrives within timeoutMs
+    bool GetNextBuffer(SimulatedBuffer *&buffer, uint32_t timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_readySignal.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return !m_ready.empty(); }))
+        {
+            buffer = nullptr;
+            return false;
+        }
+        buffer = m_ready.front();
+        m_ready.pop_front();
+        return true;
+    }
+
+    void ReleaseBuffer(SimulatedBuffer *buffer)
+    {
+        if (buffer == nullptr)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(buffer);
+    }
+
+    // Frames waiting for GetNextBuffer()
+    size_t GetQueued()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ready.size();
+    }
+
+    // Frames of the stream: delivered or dropped for lack of a free buffer
+    uint64_t GetProduced() const { return m_produced.load(); }
+    uint64_t GetDropped() const { return m_dropped.load(); }
+    uint64_t GetOverruns() const { return m_overruns.load(); }
+    size_t GetFrameBytes() const { return m_frameBytes; }
+
+private:
+    void Produce(uint64_t periodNs)
+    {
+        PeriodicTimer timer(periodNs);
+        timer.Start();
+        while (m_running)
+        {
+            timer.WaitNext();
+            m_overruns = timer.GetOverruns();
+            // Block IDs 1 to 65535, as GigE Vision
+            m_counter = (m_counter % 65535) + 1;
+            m_produced++;
+
+            SimulatedBuffer *buffer = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // Oldest released buffer first, as the ring of the driver
+                if (!m_free.empty())
+                {
+                    buffer = m_free.front();
+                    m_free.pop_front();
+                }
+            }
+            if (buffer == nullptr)
+            {
+                m_dropped++;
+                continue;
+            }
+            memcpy(buffer->m_data, m_pattern.data(), m_frameBytes);
+            buffer->m_frameCounter = (int64_t)m_counter;
+            buffer->m_timestamp = HostNowNs();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ready.push_back(buffer);
+            }
+            m_readySignal.notify_one();
+        }
+    }
+
+    FrameBufferPool m_pool;
+    size_t m_frameBytes;
+    std::vector<uint8_t> m_pattern;
+    std::vector<SimulatedBuffer> m_buffers;
+    std::deque<SimulatedBuffer*> m_free;
+    std::deque<SimulatedBuffer*> m_ready;
+    std::mutex m_mutex;
+    std::condition_variable m_readySignal;
+    std::thread m_producer;
+    std::atomic<bool> m_running;
+    uint64_t m_counter;
+    std::atomic<uint64_t> m_produced;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_overruns;
+};
@@ -0,0 +1,374 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file Telemetry.h
+//
+//  \brief
+//  Rate limited acquisition telemetry: the grab loop only bumps atomic counters, a low priority
+//  thread samples and reports them a few times per second.
+//
+//  Description: printing a status line and calling GetStreamStatistics() for every frame costs a
+//  formatted write to the terminal per frame, which at high frame rates is more than the grab
+//  itself. Here the grab loop calls RecordFrame()/RecordError()/RecordTimeout()/RecordLost(),
+//  which are relaxed atomic stores with no locking, formatting or I/O. The telemetry thread wakes
+//  up at a fixed rate (5 Hz by default), calls the optional sampler once (for a PFStream set with
+//  AddStreamStatisticsSampler()), computes the frame rate from the counter deltas and passes the
+//  sample to every sink:
+//
+//      console         Status line on stdout, overwritten in place
+//      csv:<file>      One row per sample
+//      jsonl:<file>    One JSON object per line
+//
+//  Sinks are given as a comma separated list, e.g. "console,jsonl:telemetry.jsonl".
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cinttypes>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "HostClock.h"
+
+struct TelemetrySample
+{
+    uint64_t hostNs;            // Host time of the sample
+    double elapsedS;            // Seconds since Start()
+    uint64_t frames;            // Frames received
+    uint64_t errors;            // Incomplete or corrupted frames
+    uint64_t timeouts;          // GetNextBuffer() timeouts
+    uint64_t lost;              // Frames lost, as counted by the application
+    int64_t frameCounter;       // Last frame counter
+    uint64_t timestamp;         // Last camera timestamp
+    double fps;                 // From the frame count delta since the previous sample
+    // Filled in by the sampler, if set
+    double streamFps;
+    double networkMbps;
+    uint64_t streamLost;
+};
+
+class TelemetrySink
+{
+public:
+    virtual ~TelemetrySink() {}
+    virtual void Write(const TelemetrySample &sample) = 0;
+    // Called once after the last sample
+    virtual void Finish() {}
+};
+
+class ConsoleTelemetrySink : public TelemetrySink
+{
+public:
+    ConsoleTelemetrySink(FILE *out = stdout)
+        : m_out(out)
+    {
+    }
+
+    void Write(const TelemetrySample &sample) override
+    {
+        fprintf(m_out, "FrameCounter: %" PRId64 " TimeStamp: %" PRIu64 " FPS: %05.3f %05.3f Mbps Lost: %" PRIu64 " Errors: %" PRIu64 " \r",
+            sample.frameCounter, sample.timestamp, sample.streamFps > 0.0 ? sample.streamFps : sample.fps,
+            sample.networkMbps, sample.lost, sample.errors);
+        fflush(m_out);
+    }
+
+    void Finish() override
+    {
+        fprintf(m_out, "\n");
+    }
+
+private:
+    FILE *m_out;
+};
+
+class CsvTelemetrySink : public TelemetrySink
+{
+public:
+    CsvTelemetrySink(const char *path)
+    {
+        m_file = fopen(path, "w");
+        if (m_file)
+            fprintf(m_file, "host_ns,elapsed_s,frames,errors,timeouts,lost,frame_counter,timestamp,fps,stream_fps,network_mbps,stream_lost\n");
+    }
+
+    ~CsvTelemetrySink()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool IsOpen() const { return m_file != nullptr; }
+
+    void Write(const TelemetrySample &sample) override
+    {
+        if (!m_file)
+            return;
+        fprintf(m_file, "%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%" PRIu64 ",%.3f,%.3f,%.3f,%" PRIu64 "\n",
+            sample.hostNs, sample.elapsedS, sample.frames, sample.errors, sample.timeouts, sample.lost,
+            sample.frameCounter, sample.timestamp, sample.fps, sample.streamFps, sample.networkMbps, sample.streamLost);
+        fflush(m_file);
+    }
+
+private:
+    FILE *m_file;
+};
+
+class JsonLinesTelemetrySink : public TelemetrySink
+{
+public:
+    JsonLinesTelemetrySink(const char *path)
+    {
+        m_file = fopen(path, "w");
+    }
+
+    ~JsonLinesTelemetrySink()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool IsOpen() const { return m_file != nullptr; }
+
+    void Write(const TelemetrySample &sample) override
+    {
+        if (!m_file)
+            return;
+        fprintf(m_file, "{\"host_ns\":%" PRIu64 ",\"elapsed_s\":%.3f,\"frames\":%" PRIu64 ",\"errors\":%" PRIu64
+            ",\"timeouts\":%" PRIu64 ",\"lost\":%" PRIu64 ",\"frame_counter\":%" PRId64 ",\"timestamp\":%" PRIu64
+            ",\"fps\":%.3f,\"stream_fps\":%.3f,\"network_mbps\":%.3f,\"stream_lost\":%" PRIu64 "}\n",
+            sample.hostNs, sample.elapsedS, sample.frames, sample.errors, sample.timeouts, sample.lost,
+            sample.frameCounter, sample.timestamp, sample.fps, sample.streamFps, sample.networkMbps, sample.streamLost);
+        fflush(m_file);
+    }
+
+private:
+    FILE *m_file;
+};
+
+class Telemetry
+{
+public:
+    typedef std::function<void(TelemetrySample &sample)> Sampler;
+
+    Telemetry(double rateHz = 5.0)
+        : m_periodNs(rateHz > 0.0 ? (uint64_t)(1e9 / rateHz) : 200000000ULL), m_running(false),
+          m_frames(0), m_errors(0), m_timeouts(0), m_lost(0), m_frameCounter(0), m_timestamp(0)
+    {
+    }
+
+    ~Telemetry()
+    {
+        Stop();
+    }
+
+    // Called from the telemetry thread at every sample, e.g. to read the stream statistics
+    void SetSampler(const Sampler &sampler) { m_sampler = sampler; }
+
+    void AddSink(std::unique_ptr<TelemetrySink> sink) { m_sinks.push_back(std::move(sink)); }
+
+    // Comma separated list of console, csv:<file> and jsonl:<file>. Returns false on an unknown
+    // sink or a file that cannot be created.
+    bool AddSinks(const char *spec)
+    {
+        bool ok = true;
+        std::string list = spec ? spec : "console";
+        size_t begin = 0;
+        while (begin <= list.size())
+        {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string item = list.substr(begin, end - begin);
+            begin = end + 1;
+
+            if (item.empty())
+                continue;
+            if (item == "console")
+            {
+                AddSink(std::unique_ptr<TelemetrySink>(new ConsoleTelemetrySink()));
+            }
+            else if (item.compare(0, 4, "csv:") == 0)
+            {
+                CsvTelemetrySink *sink = new CsvTelemetrySink(item.c_str() + 4);
+                ok = ok && sink->IsOpen();
+                AddSink(std::unique_ptr<TelemetrySink>(sink));
+            }
+            else if (item.compare(0, 6, "jsonl:") == 0)
+            {
+                JsonLinesTelemetrySink *sink = new JsonLinesTelemetrySink(item.c_str() + 6);
+                ok = ok && sink->IsOpen();
+                AddSink(std::unique_ptr<TelemetrySink>(sink));
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    void Start()
+    {
+        if (m_running)
+            return;
+        m_running = true;
+        m_startNs = HostNowNs();
+        m_thread = std::thread(&Telemetry::Run, this);
+    }
+
+    // Writes a last sample and finishes the sinks
+    void Stop()
+    {
+        if (!m_running)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_wakeup.notify_one();
+        m_thread.join();
+    }
+
+    // Hot path: one relaxed atomic operation each, callable from the grab thread
+    void RecordFrame(int64_t frameCounter, uint64_t timestamp)
+    {
+        m_frameCounter.store(frameCounter, std::memory_order_relaxed);
+        m_timestamp.store(timestamp, std::memory_order_relaxed);
+        m_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void RecordError() { m_errors.fetch_add(1, std::memory_order_relaxed); }
+    void RecordTimeout() { m_timeouts.fetch_add(1, std::memory_order_relaxed); }
+    void RecordLost(uint64_t count) { if (count) m_lost.fetch_add(count, std::memory_order_relaxed); }
+
+    uint64_t GetFrames() const { return m_frames.load(std::memory_order_relaxed); }
+    uint64_t GetErrors() const { return m_errors.load(std::memory_order_relaxed); }
+    uint64_t GetLost() const { return m_lost.load(std::memory_order_relaxed); }
+
+private:
+    void Run()
+    {
+        LowerThreadPriority();
+
+        TelemetrySample previous = {};
+        previous.hostNs = m_startNs;
+        bool running = true;
+        while (running)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeup.wait_for(lock, std::chrono::nanoseconds(m_periodNs), [this]() { return !m_running; });
+                running = m_running;
+            }
+
+            TelemetrySample sample = {};
+            sample.hostNs = HostNowNs();
+            sample.elapsedS = (sample.hostNs - m_startNs) * 1e-9;
+            sample.frames = m_frames.load(std::memory_order_relaxed);
+            sample.errors = m_errors.load(std::memory_order_relaxed);
+            sample.timeouts = m_timeouts.load(std::memory_order_relaxed);
+            sample.lost = m_lost.load(std::memory_order_relaxed);
+            sample.frameCounter = m_frameCounter.load(std::memory_order_relaxed);
+            sample.timestamp = m_timestamp.load(std::memory_order_relaxed);
+            if (sample.hostNs > previous.hostNs)
+                sample.fps = (sample.frames - previous.frames) * 1e9 / (sample.hostNs - previous.hostNs);
+            if (m_sampler)
+                m_sampler(sample);
+
+            for (size_t i = 0; i < m_sinks.size(); i++)
+                m_sinks[i]->Write(sample);
+            previous = sample;
+        }
+
+        for (size_t i = 0; i < m_sinks.size(); i++)
+            m_sinks[i]->Finish();
+    }
+
+    // Reporting must never compete with the grab thread for a core
+    static void LowerThreadPriority()
+    {
+#ifdef WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+        // On Linux the nice value is per thread
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+    }
+
+    uint64_t m_periodNs;
+    uint64_t m_startNs;
+    bool m_running;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    Sampler m_sampler;
+    std::vector<std::unique_ptr<TelemetrySink>> m_sinks;
+
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_errors;
+    std::atomic<uint64_t> m_timeouts;
+    std::atomic<uint64_t> m_lost;
+    std::atomic<int64_t> m_frameCounter;
+    std::atomic<uint64_t> m_timestamp;
+};
+
+// Status line and stream statistics for a grab loop that only counts: GetStreamStatistics() of
+// the stream is read from the telemetry thread. A template so that this header does not need the SDK.
+template <class Stream>
+void AddStreamStatisticsSampler(Telemetry &telemetry, Stream *stream)
+{
+    telemetry.SetSampler([stream](TelemetrySample &sample)
+    {
+        auto statistics = stream->GetStreamStatistics();
+        sample.streamFps = statistics.m_fpsGrab;
+        sample.networkMbps = statistics.m_networkRate;
+        sample.streamLost = statistics.m_lostFrames;
+    });
+}
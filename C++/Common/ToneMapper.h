@@ -0,0 +1,266 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ToneMapper.h
+//
+//  \brief
+//  Live 16 bit to 8 bit preview conversion with a window/level that follows the image content.
+//
+//  Description: a 10, 12 or 16 bit frame shown as is is either almost black (values far below
+//  65535) or clipped (top bits only). The tone mapper maps the window [low, high] linearly to
+//  0..255 and clips outside of it. The window comes from a histogram of a sparse sample of the
+//  frame (every sampleStep-th pixel of every sampleStep-th line): low and high are the given
+//  percentiles, smoothed over the frames with an exponential moving average so the preview does
+//  not flicker.
+//
+//  The mapping is the arithmetic form of a windowed LUT: out = min((v -sat low) * scale >> 16, 255)
+//  with scale = 255 * 65536 / (high - low). That is 16, 32 or 64 pixels per saturating subtract,
+//  multiply-high and pack (SSE4.2, AVX2, AVX-512BW, selected for the CPU by CpuDispatch.h), which
+//  runs at memory speed; a 64K entry table would need a gather per pixel. The window is at least
+//  256 values wide so scale fits in 16 bit.
+//
+//  Only the preview is converted, the grabbed frame is read and never modified.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+
+#include "CpuDispatch.h"
+
+// One line with the window [low, low + 255 * 65536 / scale], see ToneMapper
+inline void ToneMapLineScalar(const uint16_t *src, uint8_t *dst, size_t pixels, uint32_t low, uint32_t scale)
+{
+    for (size_t i = 0; i < pixels; i++)
+    {
+        uint32_t value = src[i] > low ? ((src[i] - low) * scale) >> 16 : 0;
+        dst[i] = (uint8_t)(value > 255 ? 255 : value);
+    }
+}
+
+#if PF_SIMD_X86
+PF_TARGET_SSE42 inline void ToneMapLineSse42(const uint16_t *src, uint8_t *dst, size_t pixels, uint32_t low, uint32_t scale)
+{
+    const __m128i lowVector = _mm_set1_epi16((short)low);
+    const __m128i scaleVector = _mm_set1_epi16((short)scale);
+    const __m128i maxVector = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        a = _mm_min_epu16(_mm_mulhi_epu16(_mm_subs_epu16(a, lowVector), scaleVector), maxVector);
+        b = _mm_min_epu16(_mm_mulhi_epu16(_mm_subs_epu16(b, lowVector), scaleVector), maxVector);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+    }
+    ToneMapLineScalar(src + i, dst + i, pixels - i, low, scale);
+}
+
+PF_TARGET_AVX2 inline void ToneMapLineAvx2(const uint16_t *src, uint8_t *dst, size_t pixels, uint32_t low, uint32_t scale)
+{
+    const __m256i lowVector = _mm256_set1_epi16((short)low);
+    const __m256i scaleVector = _mm256_set1_epi16((short)scale);
+    const __m256i maxVector = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+        a = _mm256_min_epu16(_mm256_mulhi_epu16(_mm256_subs_epu16(a, lowVector), scaleVector), maxVector);
+        b = _mm256_min_epu16(_mm256_mulhi_epu16(_mm256_subs_epu16(b, lowVector), scaleVector), maxVector);
+        // packus works per 128 bit lane, the permute restores the pixel order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+    ToneMapLineScalar(src + i, dst + i, pixels - i, low, scale);
+}
+
+PF_TARGET_AVX512 inline void ToneMapLineAvx512(const uint16_t *src, uint8_t *dst, size_t pixels, uint32_t low, uint32_t scale)
+{
+    const __m512i lowVector = _mm512_set1_epi16((short)low);
+    const __m512i scaleVector = _mm512_set1_epi16((short)scale);
+    const __m512i maxVector = _mm512_set1_epi16(255);
+    size_t i = 0;
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (; i + 64 <= pixels; i += 64)
+    {
+        __m512i a = _mm512_loadu_si512((const void *)(src + i));
+        __m512i b = _mm512_loadu_si512((const void *)(src + i + 32));
+        a = _mm512_min_epu16(_mm512_mulhi_epu16(_mm512_subs_epu16(a, lowVector), scaleVector), maxVector);
+        b = _mm512_min_epu16(_mm512_mulhi_epu16(_mm512_subs_epu16(b, lowVector), scaleVector), maxVector);
+        // packus works per 128 bit lane, the permute restores the pixel order (the masked form
+        // avoids an undefined source operand, which GCC 12 warns about)
+        __m512i packed = _mm512_packus_epi16(a, b);
+        packed = _mm512_mask_permutexvar_epi64(packed, 0xFF, order, packed);
+        _mm512_storeu_si512((void *)(dst + i), packed);
+    }
+    ToneMapLineScalar(src + i, dst + i, pixels - i, low, scale);
+}
+#endif
+
+class ToneMapper
+{
+public:
+    static const int HistogramShift = 4;                        // 4096 bins of 16 values
+    static const int HistogramBins = 65536 >> HistogramShift;
+    static const uint32_t MinimumWindow = 256;
+
+    ToneMapper(double lowPercentile = 0.5, double highPercentile = 99.5, double smoothing = 0.2, int sampleStep = 8)
+        : m_lowPercentile(lowPercentile), m_highPercentile(highPercentile), m_smoothing(smoothing),
+          m_sampleStep(sampleStep > 0 ? sampleStep : 1), m_auto(true), m_initialized(false),
+          m_low(0.0), m_high(65535.0), m_histogram(HistogramBins)
+    {
+    }
+
+    // Fixed window, disables the automatic window
+    void SetWindow(uint16_t low, uint16_t high)
+    {
+        m_auto = false;
+        m_low = low;
+        m_high = high;
+    }
+
+    void SetAuto(bool enable)
+    {
+        m_auto = enable;
+        m_initialized = false;
+    }
+
+    uint16_t GetLow() const { return (uint16_t)(m_low + 0.5); }
+    uint16_t GetHigh() const { return (uint16_t)(m_high + 0.5); }
+
+    // Moves the window towards the percentiles of the sampled frame
+    void Update(const uint16_t *src, size_t srcStride, uint32_t width, uint32_t height)
+    {
+        if (!m_auto || width == 0 || height == 0)
+            return;
+
+        std::fill(m_histogram.begin(), m_histogram.end(), 0u);
+        uint64_t samples = 0;
+        for (uint32_t y = m_sampleStep / 2; y < height; y += m_sampleStep)
+        {
+            const uint16_t *line = (const uint16_t *)((const uint8_t *)src + y * srcStride);
+            for (uint32_t x = m_sampleStep / 2; x < width; x += m_sampleStep)
+            {
+                m_histogram[line[x] >> HistogramShift]++;
+                samples++;
+            }
+        }
+        if (samples == 0)
+            return;
+
+        double low = Percentile(samples, m_lowPercentile, false);
+        double high = Percentile(samples, m_highPercentile, true);
+        if (!m_initialized)
+        {
+            m_low = low;
+            m_high = high;
+            m_initialized = true;
+        }
+        else
+        {
+            m_low += m_smoothing * (low - m_low);
+            m_high += m_smoothing * (high - m_high);
+        }
+    }
+
+    // Converts with the current window. Strides in bytes.
+    void Map(const uint16_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, uint32_t width, uint32_t height) const
+    {
+        uint32_t low, scale;
+        GetMapping(low, scale);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            MapLine((const uint16_t *)((const uint8_t *)src + y * srcStride), dst + y * dstStride, width, low, scale);
+        }
+    }
+
+    void Process(const uint16_t *src, size_t srcStride, uint8_t *dst, size_t dstStride, uint32_t width, uint32_t height)
+    {
+        Update(src, srcStride, width, height);
+        Map(src, srcStride, dst, dstStride, width, height);
+    }
+
+    static void MapLine(const uint16_t *src, uint8_t *dst, size_t pixels, uint32_t low, uint32_t scale)
+    {
+        typedef void (*MapFunction)(const uint16_t *, uint8_t *, size_t, uint32_t, uint32_t);
+#if PF_SIMD_X86
+        static const MapFunction function = SelectKernel<MapFunction>(ToneMapLineScalar, ToneMapLineSse42,
+            ToneMapLineAvx2, ToneMapLineAvx512, nullptr);
+#else
+        static const MapFunction function = ToneMapLineScalar;
+#endif
+        function(src, dst, pixels, low, scale);
+    }
+
+private:
+    void GetMapping(uint32_t &low, uint32_t &scale) const
+    {
+        low = (uint32_t)(m_low + 0.5);
+        uint32_t high = (uint32_t)(m_high + 0.5);
+        if (high < low + MinimumWindow)
+            high = low + MinimumWindow;
+        if (high > 65535)
+        {
+            high = 65535;
+            low = high - MinimumWindow;
+        }
+        scale = (255u * 65536u) / (high - low);
+    }
+
+    // Lower edge (or upper edge for the high end) of the bin containing the percentile
+    double Percentile(uint64_t samples, double percentile, bool upperEdge) const
+    {
+        uint64_t target = (uint64_t)(samples * percentile / 100.0);
+        uint64_t cumulative = 0;
+        for (int bin = 0; bin < HistogramBins; bin++)
+        {
+            cumulative += m_histogram[bin];
+            if (cumulative > target)
+                return (double)((bin + (upperEdge ? 1 : 0)) << HistogramShift) - (upperEdge ? 1.0 : 0.0);
+        }
+        return 65535.0;
+    }
+
+    double m_lowPercentile;
+    double m_highPercentile;
+    double m_smoothing;
+    uint32_t m_sampleStep;
+    bool m_auto;
+    bool m_initialized;
+    double m_low;
+    double m_high;
+    std::vector<uint32_t> m_histogram;
+};
@@ -0,0 +1,263 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file TraceSpans.h
+//
+//  \brief
+//  Per frame trace spans in thread local ring buffers, exported as Chrome trace_event JSON.
+//
+//  Description: a span measures one stage of the processing of a frame (GetNextBuffer,
+//  DemodulateDR, SaveToFile, display, ...). It takes two HostNowNs() reads and one store into a
+//  ring buffer owned by the calling thread, no lock and no allocation. Each thread keeps the last
+//  TraceRing::Capacity spans, so after a frame drop the timeline leading to it is still there.
+//
+//  DumpChromeTrace() writes all rings as {"traceEvents":[...]} with one complete ("ph":"X")
+//  event per span and the frame counter in "args". Open the file in chrome://tracing or
+//  https://ui.perfetto.dev to see, frame by frame, which stage on which thread took the time.
+//  Dump when the traced threads are idle (e.g. after the grab), spans recorded during the dump
+//  may be torn.
+//
+//  Tracing is compiled in only with PF_ENABLE_TRACING defined (CMake option PF_ENABLE_TRACING),
+//  otherwise the macros expand to nothing:
+//
+//      PF_TRACE_SPAN(span, "DemodulateDR");        // Measures until the end of the scope
+//      PF_TRACE_FRAME(span, frameCounter);         // Attaches the frame counter
+//      PF_TRACE_END(span);                         // Ends the span before the end of the scope
+//      PF_TRACE_THREAD_NAME("Grab");
+//      PF_TRACE_DUMP("trace.json");
+//
+//  Span names must be string literals, only the pointer is stored.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cinttypes>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HostClock.h"
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t startNs;
+    uint64_t durationNs;
+    int64_t frame;          // -1 if not set
+};
+
+// Spans of one thread, written only by that thread
+class TraceRing
+{
+public:
+    static const size_t Capacity = 1 << 16;
+
+    TraceRing(uint32_t threadId)
+        : m_events(Capacity), m_written(0), m_threadId(threadId)
+    {
+    }
+
+    void Add(const char *name, uint64_t startNs, uint64_t endNs, int64_t frame)
+    {
+        uint64_t index = m_written.load(std::memory_order_relaxed);
+        TraceEvent &event = m_events[index & (Capacity - 1)];
+        event.name = name;
+        event.startNs = startNs;
+        event.durationNs = endNs - startNs;
+        event.frame = frame;
+        m_written.store(index + 1, std::memory_order_release);
+    }
+
+    uint64_t GetWritten() const { return m_written.load(std::memory_order_acquire); }
+    const TraceEvent &GetEvent(uint64_t index) const { return m_events[index & (Capacity - 1)]; }
+    uint32_t GetThreadId() const { return m_threadId; }
+
+    void SetName(const std::string &name) { m_name = name; }
+    const std::string &GetName() const { return m_name; }
+
+    void Clear() { m_written.store(0, std::memory_order_release); }
+
+private:
+    std::vector<TraceEvent> m_events;
+    std::atomic<uint64_t> m_written;
+    uint32_t m_threadId;
+    std::string m_name;
+};
+
+class TraceRecorder
+{
+public:
+    static TraceRecorder &Instance()
+    {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    // Ring of the calling thread, created on its first span. Rings outlive their threads so the
+    // spans of finished threads are still dumped.
+    TraceRing &ThreadRing()
+    {
+        static thread_local TraceRing *ring = nullptr;
+        if (!ring)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rings.push_back(std::unique_ptr<TraceRing>(new TraceRing((uint32_t)m_rings.size() + 1)));
+            ring = m_rings.back().get();
+        }
+        return *ring;
+    }
+
+    void SetThreadName(const char *name)
+    {
+        ThreadRing().SetName(name);
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_rings.size(); i++)
+            m_rings[i]->Clear();
+    }
+
+    // Chrome trace_event format, timestamps in microseconds relative to the oldest span
+    bool DumpChromeTrace(const char *path)
+    {
+        FILE *file = fopen(path, "w");
+        if (!file)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Spans are recorded when they end: an enclosing span follows its inner spans in the ring
+        // but started before them, so the oldest start can be anywhere in the ring
+        uint64_t originNs = UINT64_MAX;
+        for (size_t i = 0; i < m_rings.size(); i++)
+        {
+            uint64_t written = m_rings[i]->GetWritten();
+            uint64_t first = (written > TraceRing::Capacity) ? written - TraceRing::Capacity : 0;
+            for (uint64_t index = first; index < written; index++)
+            {
+                if (m_rings[i]->GetEvent(index).startNs < originNs)
+                    originNs = m_rings[i]->GetEvent(index).startNs;
+            }
+        }
+        if (originNs == UINT64_MAX)
+            originNs = 0;
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool firstEvent = true;
+        for (size_t i = 0; i < m_rings.size(); i++)
+        {
+            const TraceRing &ring = *m_rings[i];
+            if (!ring.GetName().empty())
+            {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    firstEvent ? "" : ",\n", ring.GetThreadId(), ring.GetName().c_str());
+                firstEvent = false;
+            }
+
+            uint64_t written = ring.GetWritten();
+            uint64_t first = (written > TraceRing::Capacity) ? written - TraceRing::Capacity : 0;
+            for (uint64_t index = first; index < written; index++)
+            {
+                const TraceEvent &event = ring.GetEvent(index);
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                    firstEvent ? "" : ",\n", event.name, ring.GetThreadId(),
+                    (event.startNs - originNs) * 1e-3, event.durationNs * 1e-3);
+                if (event.frame >= 0)
+                    fprintf(file, ",\"args\":{\"frame\":%" PRId64 "}", event.frame);
+                fprintf(file, "}");
+                firstEvent = false;
+            }
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        return true;
+    }
+
+private:
+    TraceRecorder() {}
+
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<TraceRing>> m_rings;
+};
+
+// Records [construction, End() or destruction] into the ring of the calling thread
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, int64_t frame = -1)
+        : m_name(name), m_startNs(HostNowNs()), m_frame(frame), m_ended(false)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        End();
+    }
+
+    void SetFrame(int64_t frame) { m_frame = frame; }
+
+    void End()
+    {
+        if (m_ended)
+            return;
+        m_ended = true;
+        TraceRecorder::Instance().ThreadRing().Add(m_name, m_startNs, HostNowNs(), m_frame);
+    }
+
+private:
+    TraceSpan(const TraceSpan &);
+    TraceSpan &operator=(const TraceSpan &);
+
+    const char *m_name;
+    uint64_t m_startNs;
+    int64_t m_frame;
+    bool m_ended;
+};
+
+#ifdef PF_ENABLE_TRACING
+#define PF_TRACE_SPAN(span, name)       TraceSpan span(name)
+#define PF_TRACE_FRAME(span, frame)     span.SetFrame((int64_t)(frame))
+#define PF_TRACE_END(span)              span.End()
+#define PF_TRACE_THREAD_NAME(name)      TraceRecorder::Instance().SetThreadName(name)
+#define PF_TRACE_DUMP(path)             TraceRecorder::Instance().DumpChromeTrace(path)
+#else
+#define PF_TRACE_SPAN(span, name)       ((void)0)
+#define PF_TRACE_FRAME(span, frame)     ((void)0)
+#define PF_TRACE_END(span)              ((void)0)
+#define PF_TRACE_THREAD_NAME(name)      ((void)0)
+#define PF_TRACE_DUMP(path)             ((void)0)
+#endif
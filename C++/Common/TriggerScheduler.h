@@ -0,0 +1,416 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file TriggerScheduler.h
+//
+//  \brief
+//  Keeps several software triggers in flight so triggered acquisition is not limited by one
+//  control round trip plus one full readout per frame.
+//
+//  Description: a dedicated thread issues triggers through the supplied function (normally
+//  PFCamera::SetFeatureCommand("TriggerSoftware", 1)) as long as less than maxInFlight frames are
+//  outstanding. Every trigger gets a sequence number, its host time and the frame counter its frame
+//  is expected to carry. The grab loop reports each received buffer with Complete(), which matches
+//  it to the trigger expecting its frame counter:
+//
+//  1. The camera frame counter advances once per accepted trigger. The first frame anchors the
+//     expected counters: it belongs to the oldest trigger, the following triggers expect the
+//     following counters. The anchor is set again after a restart of the camera counter.
+//  2. Triggers expecting a counter older than the received one were accepted, but their frames
+//     were lost on the way. They are retired as lost.
+//  3. A trigger that gets no frame within the timeout (e.g. the camera was still exposing and
+//     ignored it) is retired as missed, so the window never stalls. The camera did not count it,
+//     so the triggers after it expect one counter less from then on.
+//  4. Resent buffers (same counter again) do not complete a trigger.
+//
+//  SetMinInterval() limits the trigger rate to what the sensor can accept: exposure plus readout
+//  time. A trigger sent while the sensor is still busy is ignored by the camera.
+//
+//  SetRate() switches to a fixed cadence: triggers are sent on the absolute deadlines of a
+//  PeriodicTimer instead of as fast as the window allows. The period is not shorter than the
+//  minimum interval. A deadline at which the window is full is skipped (counted, not delayed), so
+//  the cadence of the remaining frames stays deterministic. Up to shortly before each deadline the
+//  thread waits on the condition variable, so Stop() does not wait for a long period to end; only
+//  the last PreciseWaitNs (plus the spin) are left to the PeriodicTimer.
+//
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cinttypes>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "FrameSequenceTracker.h"
+#include "HostClock.h"
+#include "LatencyHistogram.h"
+#include "PeriodicTimer.h"
+
+struct TriggerRecord
+{
+    uint64_t sequence;      // Trigger sequence number, starting at 0
+    uint64_t triggerNs;     // Host time right before the trigger command was sent
+    uint64_t sentNs;        // Host time when the trigger command returned
+    int64_t expectedCounter; // Frame counter of its frame, -1 until the first frame anchored them
+};
+
+class TriggerScheduler
+{
+public:
+    typedef std::function<bool()> TriggerFunction;
+
+    // Fixed rate: the part before a deadline slept by PeriodicTimer, which wakes up more precisely
+    // than a condition variable but can not be interrupted by Stop()
+    static const uint64_t PreciseWaitNs = 2000000;
+
+    TriggerScheduler(TriggerFunction trigger, int maxInFlight, uint64_t frameTimeoutNs = 1000000000ull)
+        : m_trigger(trigger), m_maxInFlight(maxInFlight < 1 ? 1 : maxInFlight), m_frameTimeoutNs(frameTimeoutNs),
+          m_minIntervalNs(0), m_rateHz(0.0), m_spinNs(0), m_rateClamped(false), m_running(false), m_nextSequence(0),
+          m_anchored(false), m_nextExpected(0), m_issued(0), m_completed(0), m_lost(0), m_missed(0),
+          m_triggerErrors(0), m_skipped(0), m_unmatched(0)
+    {
+    }
+
+    ~TriggerScheduler()
+    {
+        Stop();
+    }
+
+    // Minimum time between two triggers (exposure plus readout), also for SetRate().
+    // Must be set before Start().
+    void SetMinInterval(uint64_t intervalNs)
+    {
+        m_minIntervalNs = intervalNs;
+    }
+
+    // Trigger at a fixed rate. spinNs is the busy wait before each deadline, see PeriodicTimer.
+    // Must be set before Start().
+    void SetRate(double rateHz, uint64_t spinNs = 0)
+    {
+        m_rateHz = rateHz;
+        m_spinNs = spinNs;
+    }
+
+    void Start()
+    {
+        if (m_running.exchange(true))
+            return;
+        m_timer.reset();
+        m_rateClamped = false;
+        if (m_rateHz > 0.0)
+        {
+            // A faster cadence would only produce triggers the camera ignores
+            uint64_t periodNs = PeriodicTimer::PeriodFromRate(m_rateHz);
+            if (periodNs < m_minIntervalNs)
+            {
+                periodNs = m_minIntervalNs;
+                m_rateClamped = true;
+            }
+            m_timer.reset(new PeriodicTimer(periodNs, m_spinNs));
+            m_timer->Start();
+        }
+        m_thread = std::thread(&TriggerScheduler::Run, this);
+    }
+
+    void Stop()
+    {
+        if (!m_running.exchange(false))
+            return;
+        {
+            // The thread is either waiting or has not checked m_running yet
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_condition.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Called by the grab loop for every buffer received (also corrupt ones).
+    // Returns true and fills record if the buffer could be matched to a trigger.
+    bool Complete(int64_t frameCounter, uint64_t arrivalNs, TriggerRecord *record = nullptr)
+    {
+        bool matched = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t duplicates = m_frames.GetDuplicates();
+            uint64_t restarts = m_frames.GetRestarts();
+            m_frames.Update(frameCounter, arrivalNs);
+            // A resent buffer: its trigger was completed by the first copy
+            if (m_frames.GetDuplicates() != duplicates)
+                return false;
+
+            uint64_t counter = (uint64_t)frameCounter;
+            if (!m_anchored || m_frames.GetRestarts() != restarts)
+                Anchor(counter);
+
+            // Triggers before the one expecting this counter were accepted, their frames were lost
+            std::deque<TriggerRecord>::iterator it = m_outstanding.begin();
+            while (it != m_outstanding.end() && (uint64_t)it->expectedCounter != counter)
+                ++it;
+            if (it == m_outstanding.end())
+            {
+                // No trigger expects it: a frame of a retired trigger, or one the window does not know.
+                // Counters ahead of every outstanding trigger mean they all lost their frames.
+                if (!m_outstanding.empty() && m_frames.IsAhead((uint64_t)m_outstanding.back().expectedCounter, counter))
+                {
+                    m_lost += m_outstanding.size();
+                    m_outstanding.clear();
+                    m_nextExpected = m_frames.Next(counter);
+                }
+                m_unmatched++;
+            }
+            else
+            {
+                TriggerRecord trigger = *it;
+                m_lost += (uint64_t)(it - m_outstanding.begin());
+                m_outstanding.erase(m_outstanding.begin(), it + 1);
+                m_completed++;
+                m_latency.Record(arrivalNs - trigger.triggerNs);
+                if (record)
+                    *record = trigger;
+                matched = true;
+            }
+        }
+        m_condition.notify_one();
+        return matched;
+    }
+
+    int GetInFlight()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (int)m_outstanding.size();
+    }
+
+    uint64_t GetIssued() const { return m_issued.load(); }
+    uint64_t GetCompleted() const { return m_completed.load(); }
+    uint64_t GetLost() const { return m_lost.load(); }
+    uint64_t GetMissed() const { return m_missed.load(); }
+    uint64_t GetTriggerErrors() const { return m_triggerErrors.load(); }
+    // Fixed rate deadlines skipped because the window was full
+    uint64_t GetSkipped() const { return m_skipped.load(); }
+    // Buffers no outstanding trigger expected
+    uint64_t GetUnmatched() const { return m_unmatched.load(); }
+    // True if SetRate() asked for a shorter period than the minimum interval
+    bool IsRateClamped() const { return m_rateClamped; }
+    // Trigger to buffer arrival latency in ns; recorded by the thread calling Complete()
+    const LatencyHistogram &GetLatency() const { return m_latency; }
+
+    void PrintReport(FILE *out) const
+    {
+        fprintf(out, "Triggers issued: %" PRIu64 " Completed: %" PRIu64 " Lost: %" PRIu64 " Missed: %" PRIu64
+            " Errors: %" PRIu64 " Unmatched buffers: %" PRIu64 " (max in flight: %d)\n",
+            GetIssued(), GetCompleted(), GetLost(), GetMissed(), GetTriggerErrors(), GetUnmatched(), m_maxInFlight);
+        m_latency.Print(out, "Trigger to buffer latency");
+        if (m_timer)
+        {
+            if (m_rateClamped)
+                fprintf(out, "Trigger rate limited to %.1f Hz by the minimum interval\n", 1e9 / (double)m_timer->GetPeriod());
+            fprintf(out, "Deadlines skipped (window full): %" PRIu64 "\n", GetSkipped());
+            m_timer->PrintReport(out);
+        }
+    }
+
+private:
+    void Run()
+    {
+        uint64_t lastTriggerNs = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running.load())
+        {
+            RetireTimedOut(HostNowNs());
+
+            if (m_timer)
+            {
+                // Fixed rate: wait for the deadline, interruptible by Stop() until shortly before it
+                uint64_t deadline = m_timer->GetNextDeadline();
+                uint64_t precise = PreciseWaitNs + m_spinNs;
+                uint64_t wakeNs = (deadline > precise) ? deadline - precise : 0;
+                if (wakeNs > HostNowNs())
+                {
+                    std::chrono::steady_clock::time_point wake(
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(wakeNs)));
+                    m_condition.wait_until(lock, wake, [this]() { return !m_running.load(); });
+                    if (!m_running.load())
+                        break;
+                }
+                lock.unlock();
+                m_timer->WaitNext();
+                lock.lock();
+                if (!m_running.load())
+                    break;
+                RetireTimedOut(HostNowNs());
+                if ((int)m_outstanding.size() >= m_maxInFlight)
+                {
+                    m_skipped++;
+                    continue;
+                }
+            }
+            else if ((int)m_outstanding.size() >= m_maxInFlight)
+            {
+                // Woken up by Complete(); the timeout keeps retiring triggers without frames
+                m_condition.wait_for(lock, std::chrono::milliseconds(10));
+                continue;
+            }
+
+            uint64_t now = HostNowNs();
+            if (!m_timer && lastTriggerNs != 0 && now - lastTriggerNs < m_minIntervalNs)
+            {
+                uint64_t remaining = m_minIntervalNs - (now - lastTriggerNs);
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+                lock.lock();
+                continue;
+            }
+
+            // Register the trigger before sending it, the frame may arrive before the command returns
+            TriggerRecord record;
+            record.sequence = m_nextSequence++;
+            record.triggerNs = HostNowNs();
+            record.sentNs = 0;
+            record.expectedCounter = -1;
+            if (m_anchored)
+            {
+                record.expectedCounter = (int64_t)m_nextExpected;
+                m_nextExpected = m_frames.Next(m_nextExpected);
+            }
+            m_outstanding.push_back(record);
+            lastTriggerNs = record.triggerNs;
+
+            lock.unlock();
+            bool ok = m_trigger();
+            uint64_t sentNs = HostNowNs();
+            lock.lock();
+
+            if (!ok)
+            {
+                // Nothing will arrive for this trigger, and the camera does not count it
+                for (std::deque<TriggerRecord>::iterator it = m_outstanding.begin(); it != m_outstanding.end(); ++it)
+                {
+                    if (it->sequence == record.sequence)
+                    {
+                        int64_t expected = it->expectedCounter;
+                        Renumber(m_outstanding.erase(it), expected);
+                        break;
+                    }
+                }
+                m_triggerErrors++;
+                continue;
+            }
+
+            for (std::deque<TriggerRecord>::reverse_iterator it = m_outstanding.rbegin(); it != m_outstanding.rend(); ++it)
+            {
+                if (it->sequence == record.sequence)
+                {
+                    it->sentNs = sentNs;
+                    break;
+                }
+            }
+            m_issued++;
+        }
+    }
+
+    // Called with m_mutex held
+    void RetireTimedOut(uint64_t now)
+    {
+        while (!m_outstanding.empty() && now - m_outstanding.front().triggerNs > m_frameTimeoutNs)
+        {
+            int64_t expected = m_outstanding.front().expectedCounter;
+            m_outstanding.pop_front();
+            // Ignored by the camera: the later triggers get the counters from this one on
+            Renumber(m_outstanding.begin(), expected);
+            m_missed++;
+        }
+    }
+
+    // Called with m_mutex held. The oldest trigger gets the frame counter just received, the
+    // following ones the counters after it.
+    void Anchor(uint64_t counter)
+    {
+        m_anchored = true;
+        m_nextExpected = counter;
+        for (std::deque<TriggerRecord>::iterator it = m_outstanding.begin(); it != m_outstanding.end(); ++it)
+        {
+            it->expectedCounter = (int64_t)m_nextExpected;
+            m_nextExpected = m_frames.Next(m_nextExpected);
+        }
+        if (m_outstanding.empty())
+            m_nextExpected = m_frames.Next(counter);
+    }
+
+    // Called with m_mutex held. A trigger expecting counter is gone without being counted by the
+    // camera: from first on the triggers expect one counter less.
+    void Renumber(std::deque<TriggerRecord>::iterator first, int64_t counter)
+    {
+        if (!m_anchored || counter < 0)
+            return;
+        m_nextExpected = (uint64_t)counter;
+        for (std::deque<TriggerRecord>::iterator it = first; it != m_outstanding.end(); ++it)
+        {
+            it->expectedCounter = (int64_t)m_nextExpected;
+            m_nextExpected = m_frames.Next(m_nextExpected);
+        }
+    }
+
+    TriggerFunction m_trigger;
+    int m_maxInFlight;
+    uint64_t m_frameTimeoutNs;
+    uint64_t m_minIntervalNs;
+    double m_rateHz;
+    uint64_t m_spinNs;
+    bool m_rateClamped;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<TriggerRecord> m_outstanding;
+    uint64_t m_nextSequence;
+    bool m_anchored;
+    uint64_t m_nextExpected;
+
+    std::atomic<uint64_t> m_issued;
+    std::atomic<uint64_t> m_completed;
+    std::atomic<uint64_t> m_lost;
+    std::atomic<uint64_t> m_missed;
+    std::atomic<uint64_t> m_triggerErrors;
+    std::atomic<uint64_t> m_skipped;
+    std::atomic<uint64_t> m_unmatched;
+    std::unique_ptr<PeriodicTimer> m_timer;
+    FrameSequenceTracker m_frames;
+    LatencyHistogram m_latency;
+};
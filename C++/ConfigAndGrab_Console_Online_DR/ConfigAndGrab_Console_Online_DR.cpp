@@ -1,396 +1,563 @@
-/*
-******************************************************************************
-* @attention
-*
-*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
-*
-* Redistribution and use in source and binary forms, with or without modification,
-* are permitted provided that the following conditions are met:
-* 1. Redistributions of source code must retain the above copyright notice,
-* this list of conditions and the following disclaimer.
-* 2. Redistributions in binary form must reproduce the above copyright notice,
-* this list of conditions and the following disclaimer in the documentation
-* and/or other materials provided with the distribution.
-* 3. Neither the name of Photonfocus nor the names of its contributors
-* may be used to endorse or promote products derived from this software
-* without specific prior written permission.
-*
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
-* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
-* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
-* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
-* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
-* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*
-******************************************************************************
-*/
-
-/**
-//  \file ConfigAndGrab_Console.cpp
-//
-//  \brief
-//  This example is a command line application that shows the generic process to discover the cameras 
-//  in the computer or network, connect to a double rate camera, grab images, demodulate images, save images demodulated to files  
-//  and disconnect camera.
-//
-//  Description: The purpouse of this sample is to show how images in double rate cameras must be captured and demodulated:
-
-//  1. Set "DoubleRate_Enable" feature value to true to capture images at double rate speed.
-//  2. Configure parameters for capture images. In this example the camera will capture images using Mono8 pixel type.
-//  3. Get "Window_W" feature value to discover which is the real size of the images demodulated.
-//  4. After the image is captured can be demodulated with method PFImage::DemodulateDR()
-//  5. PFImage object with enough space allocated to perform the demodulation (you need to know the width of image demodulated "Window_W") will be passed to this method.
-//  6. After the image is demodulated will be saved to file.
-
-//  The application  will execute  this method until the 'space' key is pressed.
-//  Finally the camera is freezed and disconnected.
-//
-*/
-#include <cinttypes>
-#include <iostream>
-
-#include "PFCamera.h"
-#include "PFStreamGEV.h"
-#include "PFStreamU3V.h"
-#include "PFDiscovery.h"
-#include "PFImage.h"
-
-#ifdef WIN32
-#include <Windows.h>
-#include <conio.h>
-#include <direct.h>
-#else
-#include <unistd.h>
-#include <sys/select.h>
-#include <sys/ioctl.h>
-#include <termios.h>
-#include <stropts.h>
-
-#define _getcwd getcwd
-#define MAX_PATH  4096
-
-int _kbhit() {
-    static const int STDIN = 0;
-    static bool initialized = false;
-
-    if (!initialized) {
-        // Use termios to turn off line buffering
-        struct termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
-    }
-
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
-}
-
-char _getch(void)
-{
-    char buf = 0;
-    struct termios old = { 0 };
-    fflush(stdout);
-    if (tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if (tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if (read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if (tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    return buf;
-}
-#endif
-
-int KeyPressed(char key)
-{
-    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
-}
-
-using namespace std;
-using namespace PFCameraDLL;
-
-int GrabImages(PFStream *pfStream, int64_t widthDR, int64_t height, bool isColor, pfPixelType pixelType);
-
-int main()
-{
-    PFDiscovery pfDiscover;
-    PFCamera pfCamera;
-    PFCameraInfo *pfCameraInfo; 
-    PFStream *pfStream;
-    PFResult pfResult;
-    uint8_t i,camera;
-    uint16_t selected;
-        
-        
-    // Discover the cameras available in the computer or network
-    pfResult = pfDiscover.DiscoverCameras();
-    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
-    {
-        std::cout << "No cameras found." << endl;
-        _getch();
-        return -1;
-    }
-
-    // For each discovered camera, print the model name, manufacturer, version, etc
-    std::cout << "\nCameras found: \n" << endl;
-    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
-    {
-        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
-        if (pfResult == PFSDK_NOERROR)
-        {
-            std::cout << i + 1 << "- " << pfCameraInfo->GetModelName() << " Manufacturer info: "  << pfCameraInfo->GetManufacturerInfo() <<  endl;
-            pfCameraInfo->printCameraInfo();
-        }
-    }
-    
-    // Select one of the following cameras to connect
-    if (i > 0)
-    {
-        std::cout << "Select a camera from the list: ";
-        cin >> selected;
-        camera = static_cast<uint8_t>(selected)-1;
-    }
-    else
-    {
-        cout << "No cameras found." << endl;
-        _getch();
-        return 0;
-    }
-
-    // Get the information of the selected camera and keep it in pfCameraInfo
-    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,camera);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-        
-    // Connect the camera using pfCameraInfo
-    std::cout << "Connecting camera " << selected << " ..." << endl;
-    pfResult = pfCamera.Connect(*pfCameraInfo);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }           
-
-     // Set double rate enable
-    pfResult = pfCamera.SetFeatureBool("DoubleRate_Enable", true);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << "  " << endl;
-        _getch();
-        return -1;
-    }
-       
-       
-    int64_t widthDR = 0;
-    int64_t binX = 0;
-   
-    pfCamera.GetFeatureInt("Window_W", widthDR);
-    // Consider BinningHorizontal
-    pfCamera.GetFeatureInt("BinningHorizontal", binX);
-
-    if (binX > 1)
-    {
-        // Update Width depending on binX value
-        widthDR /= binX;
-    }
-
-    int64_t height = 0;
-    pfCamera.GetFeatureInt("Height", height);
- 
-    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
-    #ifdef _DEBUG
-    pfResult = pfCamera.SetHeartbeatRate(10000);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-    #endif
-        
-    // Set pixel format for mochrome capture
-    pfPixelType pixelType = PixelMono8;
-    pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-
-    // Set the SCPS PacketSize for a proper streaming
-    int packetSize = 8164;
-    pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", packetSize);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "GevSCPSPacketSize: " << packetSize << endl;
-
-    // In order to grab images it is necessary to prepare a proper stream.
-    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
-        pfStream = new PFStreamGEV(false, true, true, false);
-    else
-        pfStream = new PFStreamU3V();
-    
-    // Default Ring buffer Count
-    pfStream->SetBufferCount(500);
-    // It is mandatory to add this stream to the camera before grabbing images.
-    pfResult = pfCamera.AddStream(pfStream);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-            
-       
-    // Start grabbing images
-    pfResult = pfCamera.Grab();
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        // Stop grabbing
-        pfCamera.Freeze();
-        // Disconnect the Camera
-        pfCamera.Disconnect();
-        // Delete stream pointer
-        if (pfStream != nullptr)
-            delete pfStream;
-
-        std::cout << "\r\nPress any key to finish...\r\n" << endl;
-        _getch();
-        return -2;
-    }
-    
-    GrabImages(pfStream, widthDR, height, pfCamera.isColorCamera(), pixelType);
-    
-    // Stop grabbing
-    pfCamera.Freeze();
-    // Disconnect the camera
-    pfCamera.Disconnect();
-
-    // Finally the stream pointer is deleted
-    if (pfStream != nullptr)
-        delete pfStream;
-    
-    std::cout << "\r\nPress any key to finish...\r\n" << endl;
-    _getch();
-    return 0;
-}
-
-int GrabImages(PFStream *pfStream, int64_t widthDR, int64_t height, bool isColor, pfPixelType pixelType)
-{
-    PFImage pfImageDest;
-    PFImage pfImage;
-    PFResult pfResult;
-    PFBuffer *pfBuffer;
-    int iter = 0, iter_file = 0;
-    double fps;
-    double networkRate;
-    int64_t oldFrameCounter = 0;
-    char filename[256];
-
-    // Allocate image for demodulation
-    pfImageDest.ReserveImage(pixelType, (uint32_t)widthDR, (uint32_t)height);
-    
-    // Grab images
-    fflush(stdin);
-
-    std::cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
-    while (!KeyPressed(' '))
-    {
-        // Get from camera image buffer
-        pfResult = pfStream->GetNextBuffer(pfBuffer);
-        
-        if (pfResult == PFSDK_NOERROR)
-        {
-            if (iter == 50)
-            {
-                // Construct PFImage object
-                // The image data is managed inside the class and released in the destructor
-                pfBuffer->GetImage(pfImage);
-                // Cameras with support for color formats decode the image different, this is why isColor may be true even using mono formats
-                pfResult = pfImage.DemodulateDR(pfImageDest, isColor);
-
-                if (pfResult == PFSDK_NOERROR)
-                {
-                    sprintf(filename, "image_%d_demod.bmp", iter_file++);
-                    // Save demodulated image to a file
-                    pfImageDest.SaveToFile(filename, pfImageFileType::BmpFileType);
-                    
-                    // To save original image
-                    // sprintf(filename, "image_%d_mod.bmp", iter_file++);
-                    // pfImage.SaveToFile(filename, pfImageFileType::BmpFileType);
-                }
-                iter = 0;
-            }
-         
-            fps = pfStream->GetStreamStatistics().m_fpsGrab;
-            networkRate = pfStream->GetStreamStatistics().m_networkRate;
-            printf("FrameCounter: %" PRId64 " TimeStamp: %" PRIu64 " FPS: %05.3f %05.3f Mbps \r", pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp(), fps, networkRate);
-            
-            if (pfBuffer->GetFrameCounter() != oldFrameCounter && pfBuffer->GetFrameCounter() - oldFrameCounter > 1)
-            {
-                printf("\nLost frames: %" PRId64 "\n", pfBuffer->GetFrameCounter() - oldFrameCounter);
-            }
-            oldFrameCounter = pfBuffer->GetFrameCounter();
-
-            iter++;
-        }
-        else if (pfBuffer == nullptr)
-        {
-            std::cout << "Buffer is empty!\r\n";
-        }
-        else
-        {
-            std::cout << "\nError: " << pfResult.GetDescription() << "\r\n";
-            if (pfBuffer == nullptr)
-            {
-                std::cout << "Buffer is empty!\r\n";
-            } else if (pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR)
-            {
-                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
-                printf("FrameCounter: %" PRId64 " TimeStamp: %" PRId64 " MissingPackets: %" PRIu32 " FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
-                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
-                // Construct PFImage object
-                // The image data is managed inside the class and released in the destructor
-                pfBuffer->GetImage(pfImage);
-                // Save image to a file
-                pfImage.SaveToFile("image_error.bmp", BmpFileType);
-            }
-            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
-                std::cout << "Timeout error!\r\n";
-            }
-        }
-        
-        pfStream->ReleaseBuffer(pfBuffer);
-    }
-
-
-    pfImageDest.ReleaseImage();
-    // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() 
-    // pfStream->ReleaseBuffer(&pfBuffer);
-
-    std::cout << endl << "\r\nEnd of grabbing process!" << endl;
-
-    return 0;
-}
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ConfigAndGrab_Console.cpp
+//
+//  \brief
+//  This example is a command line application that shows the generic process to discover the cameras 
+//  in the computer or network, connect to a double rate camera, grab images, demodulate images, save images demodulated to files  
+//  and disconnect camera.
+//
+//  Description: The purpouse of this sample is to show how images in double rate cameras must be captured and demodulated:
+
+//  1. Set "DoubleRate_Enable" feature value to true to capture images at double rate speed.
+//  2. Configure parameters for capture images. In this example the camera will capture images using Mono8 pixel type.
+//  3. Get "Window_W" feature value to discover which is the real size of the images demodulated.
+//  4. After the image is captured can be demodulated with method PFImage::DemodulateDR()
+//  5. PFImage object with enough space allocated to perform the demodulation (you need to know the width of image demodulated "Window_W") will be passed to this method.
+//  6. After the image is demodulated will be saved to file.
+
+//  The application  will execute  this method until the 'space' key is pressed.
+//  Finally the camera is freezed and disconnected.
+//
+//  The ring buffer count is not fixed: BufferSizingPolicy measures how long the loop holds each
+//  frame (including the periodic demodulation and file write) and stores the count needed for the
+//  next run in buffer_count_dr.txt. The first run uses the previous default of 500 buffers.
+//
+//  The demodulation target lives in a FrameBufferPool: allocated before grabbing, pre-faulted and
+//  locked in memory, so the first demodulations do not page fault during the acquisition.
+//
+//  Color cameras whose PixelColorFilter is known get a color image instead of the mosaic:
+//  FusedDrDebayer (DrDebayer.h) demodulates the frame in strips of rows and debayers every strip
+//  while it is still in the cache, so the demodulated mosaic is never written to memory as a
+//  whole frame.
+//
+//  Every frame that is demodulated is also stored as received, modulated, in the DR container
+//  image_mod.drc (DrContainer.h) with "Window_W", the binning and the camera model in its header
+//  and the timestamp of every frame in its index, for the offline samples.
+//
+//  Built with the CMake option PF_ENABLE_TRACING, GetNextBuffer, DemodulateDR, SaveToFile and
+//  ReleaseBuffer are traced per frame (TraceSpans.h) and the timeline is written to trace_dr.json.
+//
+*/
+#include <algorithm>
+#include <cinttypes>
+#include <iostream>
+#include <string>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFStreamU3V.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+
+#include "BufferSizingPolicy.h"
+#include "DrContainer.h"
+#include "DrDebayer.h"
+#include "FrameBufferPool.h"
+#include "FrameSequenceTracker.h"
+#include "HostClock.h"
+#include "Telemetry.h"
+#include "TraceSpans.h"
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <stropts.h>
+
+#define _getcwd getcwd
+#define MAX_PATH  4096
+
+int _kbhit() {
+    static const int STDIN = 0;
+    static bool initialized = false;
+
+    if (!initialized) {
+        // Use termios to turn off line buffering
+        struct termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+}
+
+char _getch(void)
+{
+    char buf = 0;
+    struct termios old = { 0 };
+    fflush(stdout);
+    if (tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    if (read(0, &buf, 1) < 0)
+        perror("read()");
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if (tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    return buf;
+}
+#endif
+
+int KeyPressed(char key)
+{
+    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
+}
+
+using namespace std;
+using namespace PFCameraDLL;
+
+int GrabImages(PFStream *pfStream, int64_t widthDR, int64_t height, bool isColor, pfPixelType pixelType,
+    BufferSizingPolicy &bufferSizing, uint64_t payloadSize, double cameraFrameRate, int64_t widthMod,
+    FramePixelFormat colorFilter, const DrContainerHeader &containerHeader);
+
+int main()
+{
+    PFDiscovery pfDiscover;
+    PFCamera pfCamera;
+    PFCameraInfo *pfCameraInfo; 
+    PFStream *pfStream;
+    PFResult pfResult;
+    uint8_t i,camera;
+    uint16_t selected;
+        
+        
+    // Discover the cameras available in the computer or network
+    pfResult = pfDiscover.DiscoverCameras();
+    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
+    {
+        std::cout << "No cameras found." << endl;
+        _getch();
+        return -1;
+    }
+
+    // For each discovered camera, print the model name, manufacturer, version, etc
+    std::cout << "\nCameras found: \n" << endl;
+    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
+    {
+        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
+        if (pfResult == PFSDK_NOERROR)
+        {
+            std::cout << i + 1 << "- " << pfCameraInfo->GetModelName() << " Manufacturer info: "  << pfCameraInfo->GetManufacturerInfo() <<  endl;
+            pfCameraInfo->printCameraInfo();
+        }
+    }
+    
+    // Select one of the following cameras to connect
+    if (i > 0)
+    {
+        std::cout << "Select a camera from the list: ";
+        cin >> selected;
+        camera = static_cast<uint8_t>(selected)-1;
+    }
+    else
+    {
+        cout << "No cameras found." << endl;
+        _getch();
+        return 0;
+    }
+
+    // Get the information of the selected camera and keep it in pfCameraInfo
+    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,camera);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+        
+    // Connect the camera using pfCameraInfo
+    std::cout << "Connecting camera " << selected << " ..." << endl;
+    pfResult = pfCamera.Connect(*pfCameraInfo);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }           
+
+     // Set double rate enable
+    pfResult = pfCamera.SetFeatureBool("DoubleRate_Enable", true);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << "  " << endl;
+        _getch();
+        return -1;
+    }
+       
+       
+    int64_t widthDR = 0;
+    int64_t binX = 0;
+    int64_t binY = 0;
+   
+    pfCamera.GetFeatureInt("Window_W", widthDR);
+    // Consider BinningHorizontal
+    pfCamera.GetFeatureInt("BinningHorizontal", binX);
+    pfCamera.GetFeatureInt("BinningVertical", binY);
+
+    if (binX > 1)
+    {
+        // Update Width depending on binX value
+        widthDR /= binX;
+    }
+
+    int64_t height = 0;
+    pfCamera.GetFeatureInt("Height", height);
+
+    // Width of the modulated lines as transferred by the camera
+    int64_t widthMod = 0;
+    pfCamera.GetFeatureInt("Width", widthMod);
+
+    // Bayer pattern of the demodulated image, the color image is only made when it is known
+    FramePixelFormat colorFilter = FormatUnknown;
+    char colorFilterName[64] = "";
+    if (pfCamera.isColorCamera() && pfCamera.GetFeatureEnum("PixelColorFilter", colorFilterName) == PFSDK_NOERROR)
+    {
+        std::string name = std::string(colorFilterName) + "8";
+        colorFilter = ParsePixelFormat(name.c_str());
+    }
+
+    // Acquisition geometry stored with the modulated frames, the offline samples need no camera
+    DrContainerHeader containerHeader = MakeDrContainerHeader((uint32_t)widthDR, (uint32_t)widthMod,
+        (colorFilter != FormatUnknown) ? colorFilter : FormatMono8, (uint32_t)std::max<int64_t>(binX, 1),
+        (uint32_t)std::max<int64_t>(binY, 1), pfCamera.isColorCamera() ? DrContainerColorCamera : 0);
+ 
+    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
+    #ifdef _DEBUG
+    pfResult = pfCamera.SetHeartbeatRate(10000);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+    #endif
+        
+    // Set pixel format for mochrome capture
+    pfPixelType pixelType = PixelMono8;
+    pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+
+    // Set the SCPS PacketSize for a proper streaming
+    int packetSize = 8164;
+    pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", packetSize);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "GevSCPSPacketSize: " << packetSize << endl;
+
+    // In order to grab images it is necessary to prepare a proper stream.
+    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
+        pfStream = new PFStreamGEV(false, true, true, false);
+    else
+        pfStream = new PFStreamU3V();
+    
+    // Ring buffer count sized by the previous session (500 the first time)
+    BufferSizingPolicy bufferSizing("buffer_count_dr.txt", 500);
+    pfStream->SetBufferCount(bufferSizing.Load());
+    std::cout << "Ring buffer count: " << bufferSizing.GetSessionCount() << endl;
+
+    // Size of one modulated frame as transferred by the camera
+    int64_t payloadSize = 0;
+    if (pfCamera.GetFeatureInt("PayloadSize", payloadSize) != PFSDK_NOERROR)
+        payloadSize = 0;
+    // Rate the camera delivers, for the ring sizing; 0 when it runs free (the stream rate is used then)
+    double cameraFrameRate = 0.0;
+    bool frameRateEnabled = true;
+    if (pfCamera.GetFeatureBool("AcquisitionFrameRateEnable", frameRateEnabled) != PFSDK_NOERROR)
+        frameRateEnabled = true;
+    if (!frameRateEnabled || pfCamera.GetFeatureFloat("AcquisitionFrameRate", cameraFrameRate) != PFSDK_NOERROR)
+        cameraFrameRate = 0.0;
+    // It is mandatory to add this stream to the camera before grabbing images.
+    pfResult = pfCamera.AddStream(pfStream);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+            
+       
+    // Start grabbing images
+    pfResult = pfCamera.Grab();
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        // Stop grabbing
+        pfCamera.Freeze();
+        // Disconnect the Camera
+        pfCamera.Disconnect();
+        // Delete stream pointer
+        if (pfStream != nullptr)
+            delete pfStream;
+
+        std::cout << "\r\nPress any key to finish...\r\n" << endl;
+        _getch();
+        return -2;
+    }
+    
+    GrabImages(pfStream, widthDR, height, pfCamera.isColorCamera(), pixelType, bufferSizing, (uint64_t)payloadSize,
+        cameraFrameRate, widthMod, colorFilter, containerHeader);
+    
+    // Stop grabbing
+    pfCamera.Freeze();
+    // Disconnect the camera
+    pfCamera.Disconnect();
+
+    // Finally the stream pointer is deleted
+    if (pfStream != nullptr)
+        delete pfStream;
+    
+    std::cout << "\r\nPress any key to finish...\r\n" << endl;
+    _getch();
+    return 0;
+}
+
+int GrabImages(PFStream *pfStream, int64_t widthDR, int64_t height, bool isColor, pfPixelType pixelType,
+    BufferSizingPolicy &bufferSizing, uint64_t payloadSize, double cameraFrameRate, int64_t widthMod,
+    FramePixelFormat colorFilter, const DrContainerHeader &containerHeader)
+{
+    FrameBufferPool demodPool;
+    PFImage pfImage;
+    PFResult pfResult;
+    PFBuffer *pfBuffer;
+    int iter = 0, iter_file = 0;
+    FrameSequenceTracker frameTracker;
+    LatencyHistogram consumerLatency;
+    char filename[256];
+
+    // Allocate image for demodulation (Mono8, one byte per pixel) up front in locked memory
+    uint64_t demodBytes = (uint64_t)widthDR * (uint64_t)height;
+    if (!demodPool.Allocate((size_t)demodBytes, 1))
+    {
+        std::cout << "Error: could not allocate " << demodBytes << " bytes for demodulation" << endl;
+        return -1;
+    }
+    demodPool.PrintReport(stdout);
+    // The image only refers to the pool memory, it must not be released with ReleaseImage()
+    PFImage pfImageDest(pixelType, (uint32_t)widthDR, (uint32_t)height, 0, 0, 0, 0, demodBytes, demodPool.GetFrame(0));
+
+    // Color cameras: demodulation and debayering in one pass over strips of rows into an RGB8 image
+    FrameBufferPool colorPool;
+    FusedDrDebayer debayer;
+    bool colorOutput = isColor && colorFilter != FormatUnknown && widthMod > 0 &&
+        debayer.Prepare((uint32_t)widthMod, (uint32_t)widthDR, (uint32_t)height, colorFilter, DebayerRGB) &&
+        colorPool.Allocate((size_t)demodBytes * 3, 1);
+    if (colorOutput)
+    {
+        debayer.SetDemodulate([=](const uint8_t *modulated, uint8_t *demodulated, uint32_t rows)
+        {
+            // Headers over the rows of the strip, the data is not copied
+            PFImage modStrip(pixelType, (uint32_t)widthMod, rows, 0, 0, 0, 0, (uint64_t)widthMod * rows, (uint8_t*)modulated);
+            PFImage demodStrip(pixelType, (uint32_t)widthDR, rows, 0, 0, 0, 0, (uint64_t)widthDR * rows, demodulated);
+            return modStrip.DemodulateDR(demodStrip, true) == PFSDK_NOERROR;
+        });
+        debayer.PrintReport(stdout);
+    }
+    // Modulated frames as received, next to the demodulated images
+    DrContainerWriter modWriter;
+    if (!modWriter.Open("image_mod.drc", containerHeader))
+        std::cout << "Could not create image_mod.drc, the modulated frames are not saved" << endl;
+
+    PFImage pfImageColor(PixelRGB8, (uint32_t)widthDR, (uint32_t)height, 0, 0, 0, 0, demodBytes * 3,
+        colorOutput ? colorPool.GetFrame(0) : nullptr);
+    
+    Telemetry telemetry;
+    telemetry.AddSinks("console");
+    AddStreamStatisticsSampler(telemetry, pfStream);
+
+    // Grab images
+    fflush(stdin);
+
+    std::cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
+    // Stage timeline of every frame, written to trace_dr.json at the end (PF_ENABLE_TRACING builds)
+    PF_TRACE_THREAD_NAME("Grab");
+    telemetry.Start();
+    while (!KeyPressed(' '))
+    {
+        // Get from camera image buffer
+        PF_TRACE_SPAN(getSpan, "GetNextBuffer");
+        pfResult = pfStream->GetNextBuffer(pfBuffer);
+        uint64_t arrivalNs = HostNowNs();
+        if (pfBuffer)
+            PF_TRACE_FRAME(getSpan, pfBuffer->GetFrameCounter());
+        PF_TRACE_END(getSpan);
+        
+        if (pfResult == PFSDK_NOERROR)
+        {
+            if (iter == 50)
+            {
+                if (colorOutput)
+                {
+                    PF_TRACE_SPAN(debayerSpan, "DemodulateDebayer");
+                    PF_TRACE_FRAME(debayerSpan, pfBuffer->GetFrameCounter());
+                    bool demodulated = debayer.Process(pfBuffer->GetRawData(), colorPool.GetFrame(0), (size_t)widthDR * 3);
+                    PF_TRACE_END(debayerSpan);
+
+                    if (demodulated)
+                    {
+                        sprintf(filename, "image_%d_color.bmp", iter_file++);
+                        PF_TRACE_SPAN(saveSpan, "SaveToFile");
+                        PF_TRACE_FRAME(saveSpan, pfBuffer->GetFrameCounter());
+                        pfImageColor.SaveToFile(filename, pfImageFileType::BmpFileType);
+                        PF_TRACE_END(saveSpan);
+                    }
+                }
+                else
+                {
+                    // Construct PFImage object
+                    // The image data is managed inside the class and released in the destructor
+                    pfBuffer->GetImage(pfImage);
+                    // Cameras with support for color formats decode the image different, this is why isColor may be true even using mono formats
+                    PF_TRACE_SPAN(demodSpan, "DemodulateDR");
+                    PF_TRACE_FRAME(demodSpan, pfBuffer->GetFrameCounter());
+                    pfResult = pfImage.DemodulateDR(pfImageDest, isColor);
+                    PF_TRACE_END(demodSpan);
+
+                    if (pfResult == PFSDK_NOERROR)
+                    {
+                        sprintf(filename, "image_%d_demod.bmp", iter_file++);
+                        // Save demodulated image to a file
+                        PF_TRACE_SPAN(saveSpan, "SaveToFile");
+                        PF_TRACE_FRAME(saveSpan, pfBuffer->GetFrameCounter());
+                        pfImageDest.SaveToFile(filename, pfImageFileType::BmpFileType);
+                        PF_TRACE_END(saveSpan);
+                    }
+                }
+                if (modWriter.IsOpen())
+                {
+                    PF_TRACE_SPAN(writeSpan, "WriteFrame");
+                    PF_TRACE_FRAME(writeSpan, pfBuffer->GetFrameCounter());
+                    modWriter.WriteFrame(pfBuffer->GetRawData(), (uint32_t)height, (uint64_t)pfBuffer->GetTimestamp(),
+                        (uint64_t)pfBuffer->GetFrameCounter());
+                    PF_TRACE_END(writeSpan);
+                }
+                iter = 0;
+            }
+
+            telemetry.RecordFrame(pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp());
+            // Counter wraparound and stream restarts are handled by the tracker
+            telemetry.RecordLost(frameTracker.Update(pfBuffer->GetFrameCounter(), arrivalNs));
+
+            iter++;
+        }
+        else if (pfBuffer == nullptr)
+        {
+            std::cout << "Buffer is empty!\r\n";
+        }
+        else
+        {
+            if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT)
+                telemetry.RecordTimeout();
+            else
+                telemetry.RecordError();
+            std::cout << "\nError: " << pfResult.GetDescription() << "\r\n";
+            if (pfBuffer == nullptr)
+            {
+                std::cout << "Buffer is empty!\r\n";
+            } else if (pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR)
+            {
+                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
+                printf("FrameCounter: %" PRId64 " TimeStamp: %" PRId64 " MissingPackets: %" PRIu32 " FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
+                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
+                // Construct PFImage object
+                // The image data is managed inside the class and released in the destructor
+                pfBuffer->GetImage(pfImage);
+                // Save image to a file
+                pfImage.SaveToFile("image_error.bmp", BmpFileType);
+            }
+            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
+                std::cout << "Timeout error!\r\n";
+            }
+        }
+        
+        PF_TRACE_SPAN(releaseSpan, "ReleaseBuffer");
+        pfStream->ReleaseBuffer(pfBuffer);
+        PF_TRACE_END(releaseSpan);
+        // Time the frame kept the loop away from GetNextBuffer
+        if (pfResult == PFSDK_NOERROR)
+            consumerLatency.Record(HostNowNs() - arrivalNs);
+    }
+
+    telemetry.Stop();
+    PF_TRACE_DUMP("trace_dr.json");
+    if (modWriter.IsOpen())
+    {
+        uint32_t savedFrames = modWriter.GetFrameCount();
+        if (modWriter.Close())
+            std::cout << savedFrames << " modulated frames written to image_mod.drc" << endl;
+    }
+    printf("\n");
+    frameTracker.PrintReport(stdout, pfStream->GetStreamStatistics().m_lostFrames);
+
+    // Size the ring buffer of the next session from the measured consumer latency. The frame rate
+    // is the one of the camera or the stream: the intervals seen by the loop are paced by the
+    // consumer when it is too slow.
+    double frameRate = cameraFrameRate;
+    if (frameRate <= 0.0)
+        frameRate = pfStream->GetStreamStatistics().m_fpsGrab;
+    if (frameRate <= 0.0 && frameTracker.GetIntervals().GetMean() > 0.0)
+        frameRate = 1e9 / frameTracker.GetIntervals().GetMean();
+    if (payloadSize == 0)
+        payloadSize = (uint64_t)widthDR * (uint64_t)height;
+    consumerLatency.Print(stdout, "Consumer latency");
+    bufferSizing.Update(payloadSize, frameRate, consumerLatency, frameTracker.GetLost());
+    bufferSizing.PrintReport(stdout);
+    // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() 
+    // pfStream->ReleaseBuffer(&pfBuffer);
+
+    std::cout << endl << "\r\nEnd of grabbing process!" << endl;
+
+    return 0;
+}
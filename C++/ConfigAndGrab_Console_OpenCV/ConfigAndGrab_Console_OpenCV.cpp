@@ -1,441 +1,560 @@
-/*
-******************************************************************************
-* @attention
-*
-*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
-*
-* Redistribution and use in source and binary forms, with or without modification,
-* are permitted provided that the following conditions are met:
-* 1. Redistributions of source code must retain the above copyright notice,
-* this list of conditions and the following disclaimer.
-* 2. Redistributions in binary form must reproduce the above copyright notice,
-* this list of conditions and the following disclaimer in the documentation
-* and/or other materials provided with the distribution.
-* 3. Neither the name of Photonfocus nor the names of its contributors
-* may be used to endorse or promote products derived from this software
-* without specific prior written permission.
-*
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
-* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
-* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
-* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
-* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
-* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*
-******************************************************************************
-*/
-
-/**
-//  \file ConfigAndGrab_Console_OpenCV.cpp
-//
-//  \brief
-//  This example is an application in command line to show the cameras available,
-//  how to connect with the selected camera and show a window with the images 
-//  from the camera. 
-//  OpenCV library is used to display the images.
-//
-//  Description: The main functionality of the example is to show the grayscale images 
-//  from the camera using OpenCV libraries. The example shows how to capture the raw 
-//  data coming from the camera and how to display the image.
-//
-//  First, all the cameras are shown in command line together with the properties of the 
-//  all cameras discovered. The next step is to connect with the camera selected. Then 
-//  the camera starts grabbing, and the specific information for each frame is displayed:
-//  image counter and real time counter in microseconds (time stamp).
-//
-//  In a new window is printed the grayscale image corresponding from the camera connected. 
-// 
-//  IMPORTANT! OpenCV only use 8 bits (Mono8) or 16 bits (Mono16) to display images.
-//
-//  NOTE: this example does not show color images.
-//
-//  For more information about OpenCV, visit: http://opencv.org
-//
-*/
-#include <cstdio>
-#include <iostream>
-
-#include "PFCamera.h"
-#include "PFStreamGEV.h"
-#include "PFDiscovery.h"
-#include "PFImage.h"
-
-// Headers used for OpenCV libraries
-#include <opencv/cv.h>
-#include <opencv2/highgui/highgui.hpp>
-//#include <opencv2/imgcodecs.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-
-
-#ifdef WIN32
-#include <Windows.h>
-#include <conio.h>
-#include <direct.h>
-#else
-#include <unistd.h>
-#include <sys/select.h>
-#include <sys/ioctl.h>
-#include <termios.h>
-#include <stropts.h>
-
-#define _getcwd getcwd
-#define MAX_PATH  4096
-
-int _kbhit() {
-    static const int STDIN = 0;
-    static bool initialized = false;
-
-    if (!initialized) {
-        // Use termios to turn off line buffering
-        struct termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
-    }
-
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
-}
-
-char _getch(void)
-{
-    char buf = 0;
-    struct termios old = { 0 };
-    fflush(stdout);
-    if (tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if (tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if (read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if (tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    return buf;
-}
-#endif
-
-int KeyPressed(char key)
-{
-    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
-}
-
-using namespace cv;
-using namespace std;
-using namespace PFCameraDLL;
-
-Mat *img;
-int Configure(PFCamera &pfCamera);
-int GrabAndDisplayImages(PFStream *pfStream);
-
-int main()
-{
-    PFDiscovery pfDiscover;
-    PFCamera pfCamera;
-    PFCameraInfo *pfCameraInfo;     
-    PFStream *pfStream;
-    PFResult pfResult;
-    uint8_t i, camera;
-    uint16_t selected;
-
-    // Discover the cameras available in the computer or network
-    pfResult = pfDiscover.DiscoverCameras();
-    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
-    {
-        cout << "No cameras found." << endl;
-        _getch();
-        return -1;
-    }
-
-    // For each discovered camera, print the model name, manufacturer, version, etc
-    cout << "\nCameras found: \n" << endl;
-    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
-    {
-        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
-        if (pfResult == PFSDK_NOERROR)
-        {
-            cout << i + 1 << "- " << pfCameraInfo->GetModelName() << endl;
-            pfCameraInfo->printCameraInfo();
-        }
-    }
-
-    // Select one of the following cameras to connect
-    if (i > 0)
-    {
-        cout << "Select a camera from the list: ";
-        cin >> selected;
-        camera = static_cast<uint8_t>(selected)-1;
-    }
-    else {
-        cout << "No cameras found." << endl;
-        _getch();
-        return -1;
-    }
-
-    // Get the information of the selected camera and keep it in pfCameraInfo
-    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo, camera);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-    
-    // Connect the camera using pfCameraInfo
-    cout << "Connecting camera " << selected << " ..." << endl;
-    pfResult = pfCamera.Connect(*pfCameraInfo);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-        
-    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
-#if !defined(NDEBUG)
-    pfResult = pfCamera.SetHeartbeatRate(10000);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-#endif
-    
-    // Configure some camera features
-    Configure(pfCamera);
-
-    // In order to grab images it is necessary to prepare a proper stream.
-    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
-        pfStream = new PFStreamGEV(false, true, true, true);
-    else{
-        cout << "Camera type not supported" << endl;
-        _getch();
-        return -1;
-    }
-
-    // It is mandatory to add this stream to the camera before grabbing images.
-    pfResult = pfCamera.AddStream(pfStream);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-    
-    pfStream->SetBufferCount(100);
-    // Start grabbing images
-    pfResult = pfCamera.Grab();
-    if (pfResult != PFSDK_NOERROR)
-    {
-        cout << "Error: " << pfResult.GetDescription() << endl;
-        // Stop grabbing
-        pfCamera.Freeze();
-        // Disconnect the Camera
-        pfCamera.Disconnect();
-        // Delete stream pointer
-        if (pfStream != nullptr)
-            delete pfStream;
-
-        cout << "\r\nPress any key to finish...\r\n" << endl;
-        _getch();
-        return -2;
-    }
-
-    GrabAndDisplayImages(pfStream);
-
-    // Stop grabbing
-    pfCamera.Freeze();
-    // Disconnect the camera
-    pfCamera.Disconnect();
-
-    // Finally the stream pointer is deleted
-    if (pfStream != nullptr)
-        delete pfStream;
-
-    cout << "\r\nPress any key to finish...\r\n" << endl;
-    _getch();
-    return 0;
-}
-
-int Configure(PFCamera &pfCamera)
-{
-    PFFeatureParameters pfFeatureParams;
-    PFResult pfResult;
-    int64_t width, height;
-    double double_value;
-    char enum_str[64];
-
-    // Set Width value
-    width = 1280;
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("Width", &pfFeatureParams);
-    if (width > pfFeatureParams.Max)
-        width = pfFeatureParams.Max;
-    else if (width < pfFeatureParams.Min)
-        width = pfFeatureParams.Min;
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureInt("Width", width);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Width value
-    pfResult = pfCamera.GetFeatureInt("Width", width);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        cout << "Width: " << (uint16_t)width << endl;
-
-    // Set Height value
-    height = 1024;
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("Height", &pfFeatureParams);
-    if (height > pfFeatureParams.Max)
-        height = pfFeatureParams.Max;
-    else if (height < pfFeatureParams.Min)
-        height = pfFeatureParams.Min;
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureInt("Height", height);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Height value
-    pfResult = pfCamera.GetFeatureInt("Height", height);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        cout << "Height: " << (uint16_t)height << endl;
-
-    // Set pixel format
-    // OpenCV only works with Mono8 or Mono16 in grayscale pixel format 
-    pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back pixel format
-    pfResult = pfCamera.GetFeatureEnum("PixelFormat", enum_str);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        cout << "PixelFormat: " << enum_str << endl;
-
-    // Create OpenCV Matrix image:
-    // 8 bits
-    // 1 channel (grayscale)
-    img = new Mat((int)height, (int)width, CV_8UC1);
-
-    // Set Exposure Time value
-    double_value = 3000.0;
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("ExposureTime", &pfFeatureParams);
-    if (double_value > pfFeatureParams.FloatMax)
-        double_value = pfFeatureParams.FloatMax;
-    else if (double_value < pfFeatureParams.FloatMin)
-        double_value = pfFeatureParams.FloatMin;
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureFloat("ExposureTime", double_value);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Exposure Time value
-    pfResult = pfCamera.GetFeatureFloat("ExposureTime", double_value);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        cout << "ExposureTime: " << double_value << endl;
-
-    // Set the SCPS PacketSize for a proper streaming
-    pfResult = pfCamera.GetFeatureParams("GevSCPSPacketSize", &pfFeatureParams);
-    if (pfResult != PFSDK_NOERROR)
-        cout << "Error: " << pfResult.GetDescription() << endl;
-    else{
-        pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", pfFeatureParams.Max);
-        if (pfResult != PFSDK_NOERROR)
-            cout << "Error: " << pfResult.GetDescription() << endl;
-        else
-            cout << "GevSCPSPacketSize: " << pfFeatureParams.Max << endl;
-    }
-
-    return 0;
-}
-
-int GrabAndDisplayImages(PFStream *pfStream)
-{
-    PFResult pfResult;
-    PFBuffer *pfBuffer;
-    int iter = 0;
-
-    fflush(stdin);
-
-    // Grab images
-    cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
-    while (!KeyPressed(' '))
-    {
-        // Get from camera image buffer
-        pfResult = pfStream->GetNextBuffer(pfBuffer);
-
-        if (pfResult == PFSDK_NOERROR)
-        {
-            if (iter % 2 == 0)  //Display 1 out of 2 images
-            {
-                // Set the data pointer to the OpenCV image to show
-                // We only assign the pointer returned by the SDK without doing any image copy
-                img->data = pfBuffer->GetRawData();
-
-                // Display demodulated image with OpenCV
-                imshow("Display window", *img);
-
-                // Save last image (OpenCV Mat) as PNG file
-                // imwrite("image.png", *img);
-
-                // Show our image inside it
-                cvWaitKey(1);
-
-                iter = 0;
-            }
-            StreamStatistics statistics = pfStream->GetStreamStatistics();
-    
-            printf("FrameCounter: %lli TimeStamp: %llu FPS: %05.3f %05.3f Mbps \r", pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp(), statistics.m_fpsGrab, statistics.m_networkRate);
-            // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
-            pfStream->ReleaseBuffer(pfBuffer);
-            iter++;
-        }
-        else
-        {
-            cout << "\nError: " << pfResult.GetDescription() << "\r\n";
-            if (pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR)
-            {
-                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
-                printf("FrameCounter: %lld TimeStamp: %llu MissingPackets: %lu FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
-                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
-                PFImage pfImage;
-                // Construct PFImage object
-                // The image data is managed inside the class and released in the destructor
-                pfBuffer->GetImage(pfImage);
-                // Save image to a file
-                pfImage.SaveToFile("image_error.bmp", BmpFileType);
-            }
-            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
-                cout << "Timeout error!\r\n";
-            }
-            
-        // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
-            if (pfBuffer != nullptr){
-        pfStream->ReleaseBuffer(pfBuffer);
-            }
-        }
-        fflush(stdout);
-    }
-
-    cout << endl << "\r\nEnd of grabbing process!" << endl;
-
-    return 0;
-}
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ConfigAndGrab_Console_OpenCV.cpp
+//
+//  \brief
+//  This example is an application in command line to show the cameras available,
+//  how to connect with the selected camera and show a window with the images 
+//  from the camera. 
+//  OpenCV library is used to display the images.
+//
+//  Description: The main functionality of the example is to show the grayscale images 
+//  from the camera using OpenCV libraries. The example shows how to capture the raw 
+//  data coming from the camera and how to display the image.
+//
+//  First, all the cameras are shown in command line together with the properties of the 
+//  all cameras discovered. The next step is to connect with the camera selected. Then 
+//  the camera starts grabbing, and the specific information for each frame is displayed:
+//  image counter and real time counter in microseconds (time stamp).
+//
+//  In a new window is printed the grayscale image corresponding from the camera connected. 
+// 
+//  IMPORTANT! OpenCV only use 8 bits (Mono8) or 16 bits (Mono16) to display images.
+//
+//  "-pixelformat Mono10p" or "-pixelformat Mono12p" grabs packed 10/12 bit images (1.25/1.5 bytes
+//  per pixel on the wire instead of 2 for Mono16), unpacked with the SIMD kernels of PackedPixels.h.
+//
+//  "-pixelformat Mono16", Mono10p and Mono12p are previewed through ToneMapper.h: the window and
+//  level follow a sampled histogram of the frames so the full bit depth shows up in the 8 bit
+//  window. Only the preview image is converted, the grabbed buffer is left untouched.
+//  "-tonemap off" shows the 8 most significant bits instead, through ConvertTo8Kernel of
+//  PixelKernels.h (packed lines are unpacked straight to 8 bit): cheaper, but dark scenes stay dark.
+//  The SIMD level of these kernels is chosen for the CPU at startup and printed; set PF_SIMD
+//  (scalar, sse42, avx2, avx512) to compare the levels, see CpuDispatch.h. The time, cycles and
+//  cache misses of these preview kernels are printed at the end (PerfCounters.h, Linux).
+//
+//  NOTE: this example does not show color images.
+//
+//  For more information about OpenCV, visit: http://opencv.org
+//
+*/
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+
+#include "ImageViewOpenCV.h"
+#include "PackedPixels.h"
+#include "PerfCounters.h"
+#include "PixelKernels.h"
+#include "Telemetry.h"
+#include "ToneMapper.h"
+#include "TraceSpans.h"
+
+// Headers used for OpenCV libraries
+#include <opencv/cv.h>
+#include <opencv2/highgui/highgui.hpp>
+//#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <stropts.h>
+
+#define _getcwd getcwd
+#define MAX_PATH  4096
+
+int _kbhit() {
+    static const int STDIN = 0;
+    static bool initialized = false;
+
+    if (!initialized) {
+        // Use termios to turn off line buffering
+        struct termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+}
+
+char _getch(void)
+{
+    char buf = 0;
+    struct termios old = { 0 };
+    fflush(stdout);
+    if (tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    if (read(0, &buf, 1) < 0)
+        perror("read()");
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if (tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    return buf;
+}
+#endif
+
+int KeyPressed(char key)
+{
+    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
+}
+
+using namespace cv;
+using namespace std;
+using namespace PFCameraDLL;
+
+Mat *img;
+FramePixelFormat framePixelFormat = FormatMono8;
+// High bit depth preview: unpacked 16 bit frame and the adaptive window/level
+vector<uint16_t> preview16;
+ToneMapper toneMapper;
+// "-tonemap off": 8 most significant bits instead of the adaptive window/level
+bool toneMapping = true;
+int Configure(PFCamera &pfCamera, const char *pixelFormat);
+int GrabAndDisplayImages(PFStream *pfStream);
+
+// Formats the preview can show: unpacked and/or tone mapped, or directly as a Mat
+static bool CanDisplay(FramePixelFormat format)
+{
+    return IsPackedPixelFormat(format) || format == FormatMono16 || OpenCvType(format) >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    PFDiscovery pfDiscover;
+    PFCamera pfCamera;
+    PFCameraInfo *pfCameraInfo;     
+    PFStream *pfStream;
+    PFResult pfResult;
+    uint8_t i, camera;
+    uint16_t selected;
+    const char *pixelFormat = "Mono8";
+
+    // Pixel format to grab: Mono8, Mono16, Mono10p or Mono12p
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-pixelformat") == 0 && arg + 1 < argc)
+            pixelFormat = argv[++arg];
+        else if (strcmp(argv[arg], "-tonemap") == 0 && arg + 1 < argc)
+            toneMapping = strcmp(argv[++arg], "off") != 0;
+    }
+
+    // Discover the cameras available in the computer or network
+    pfResult = pfDiscover.DiscoverCameras();
+    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
+    {
+        cout << "No cameras found." << endl;
+        _getch();
+        return -1;
+    }
+
+    // For each discovered camera, print the model name, manufacturer, version, etc
+    cout << "\nCameras found: \n" << endl;
+    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
+    {
+        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
+        if (pfResult == PFSDK_NOERROR)
+        {
+            cout << i + 1 << "- " << pfCameraInfo->GetModelName() << endl;
+            pfCameraInfo->printCameraInfo();
+        }
+    }
+
+    // Select one of the following cameras to connect
+    if (i > 0)
+    {
+        cout << "Select a camera from the list: ";
+        cin >> selected;
+        camera = static_cast<uint8_t>(selected)-1;
+    }
+    else {
+        cout << "No cameras found." << endl;
+        _getch();
+        return -1;
+    }
+
+    // Get the information of the selected camera and keep it in pfCameraInfo
+    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo, camera);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+    
+    // Connect the camera using pfCameraInfo
+    cout << "Connecting camera " << selected << " ..." << endl;
+    pfResult = pfCamera.Connect(*pfCameraInfo);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+        
+    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
+#if !defined(NDEBUG)
+    pfResult = pfCamera.SetHeartbeatRate(10000);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+#endif
+    
+    // Configure some camera features
+    Configure(pfCamera, pixelFormat);
+    PrintCpuDispatch(stdout);
+
+    // In order to grab images it is necessary to prepare a proper stream.
+    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
+        pfStream = new PFStreamGEV(false, true, true, true);
+    else{
+        cout << "Camera type not supported" << endl;
+        _getch();
+        return -1;
+    }
+
+    // It is mandatory to add this stream to the camera before grabbing images.
+    pfResult = pfCamera.AddStream(pfStream);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+    
+    pfStream->SetBufferCount(100);
+    // Start grabbing images
+    pfResult = pfCamera.Grab();
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cout << "Error: " << pfResult.GetDescription() << endl;
+        // Stop grabbing
+        pfCamera.Freeze();
+        // Disconnect the Camera
+        pfCamera.Disconnect();
+        // Delete stream pointer
+        if (pfStream != nullptr)
+            delete pfStream;
+
+        cout << "\r\nPress any key to finish...\r\n" << endl;
+        _getch();
+        return -2;
+    }
+
+    GrabAndDisplayImages(pfStream);
+
+    // Stop grabbing
+    pfCamera.Freeze();
+    // Disconnect the camera
+    pfCamera.Disconnect();
+
+    // Finally the stream pointer is deleted
+    if (pfStream != nullptr)
+        delete pfStream;
+
+    cout << "\r\nPress any key to finish...\r\n" << endl;
+    _getch();
+    return 0;
+}
+
+int Configure(PFCamera &pfCamera, const char *pixelFormat)
+{
+    PFFeatureParameters pfFeatureParams;
+    PFResult pfResult;
+    int64_t width, height;
+    double double_value;
+    char enum_str[64];
+
+    // Set Width value
+    width = 1280;
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("Width", &pfFeatureParams);
+    if (width > pfFeatureParams.Max)
+        width = pfFeatureParams.Max;
+    else if (width < pfFeatureParams.Min)
+        width = pfFeatureParams.Min;
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureInt("Width", width);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Width value
+    pfResult = pfCamera.GetFeatureInt("Width", width);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        cout << "Width: " << (uint16_t)width << endl;
+
+    // Set Height value
+    height = 1024;
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("Height", &pfFeatureParams);
+    if (height > pfFeatureParams.Max)
+        height = pfFeatureParams.Max;
+    else if (height < pfFeatureParams.Min)
+        height = pfFeatureParams.Min;
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureInt("Height", height);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Height value
+    pfResult = pfCamera.GetFeatureInt("Height", height);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        cout << "Height: " << (uint16_t)height << endl;
+
+    // Set pixel format
+    // OpenCV only works with Mono8 or Mono16 in grayscale pixel format, Mono16 and packed formats are tone mapped to Mono8
+    pfResult = pfCamera.SetFeatureEnum("PixelFormat", pixelFormat);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back pixel format
+    pfResult = pfCamera.GetFeatureEnum("PixelFormat", enum_str);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+    {
+        cout << "PixelFormat: " << enum_str << endl;
+        framePixelFormat = ParsePixelFormat(enum_str);
+    }
+    if (!CanDisplay(framePixelFormat))
+    {
+        // OpenCV has no image type for it, grab Mono8 instead
+        cout << "PixelFormat " << pixelFormat << " can not be displayed, using Mono8" << endl;
+        pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
+        if (pfResult != PFSDK_NOERROR)
+            cout << "Error: " << pfResult.GetDescription() << endl;
+        framePixelFormat = FormatMono8;
+    }
+
+    // Create OpenCV Matrix image:
+    // 8 bits
+    // 1 channel (grayscale)
+    img = new Mat((int)height, (int)width, CV_8UC1);
+    if (toneMapping && IsPackedPixelFormat(framePixelFormat))
+        preview16.resize((size_t)width * (size_t)height);
+
+    // Set Exposure Time value
+    double_value = 3000.0;
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("ExposureTime", &pfFeatureParams);
+    if (double_value > pfFeatureParams.FloatMax)
+        double_value = pfFeatureParams.FloatMax;
+    else if (double_value < pfFeatureParams.FloatMin)
+        double_value = pfFeatureParams.FloatMin;
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Exposure Time value
+    pfResult = pfCamera.GetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        cout << "ExposureTime: " << double_value << endl;
+
+    // Set the SCPS PacketSize for a proper streaming
+    pfResult = pfCamera.GetFeatureParams("GevSCPSPacketSize", &pfFeatureParams);
+    if (pfResult != PFSDK_NOERROR)
+        cout << "Error: " << pfResult.GetDescription() << endl;
+    else{
+        pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", pfFeatureParams.Max);
+        if (pfResult != PFSDK_NOERROR)
+            cout << "Error: " << pfResult.GetDescription() << endl;
+        else
+            cout << "GevSCPSPacketSize: " << pfFeatureParams.Max << endl;
+    }
+
+    return 0;
+}
+
+int GrabAndDisplayImages(PFStream *pfStream)
+{
+    PFResult pfResult;
+    PFBuffer *pfBuffer;
+    int iter = 0;
+
+    fflush(stdin);
+
+    Telemetry telemetry;
+    telemetry.AddSinks("console");
+    AddStreamStatisticsSampler(telemetry, pfStream);
+    telemetry.Start();
+
+    // Counters of the preview kernels, opened on the grab thread that runs them
+    PerfCounters perfCounters;
+    PerfReport perfReport;
+    perfCounters.Open();
+    uint64_t frameBytes = (uint64_t)PixelFormatLineBytes(framePixelFormat, img->cols) * img->rows;
+
+    // Grab images
+    cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
+    // Stage timeline of every frame, written to trace_opencv.json at the end (PF_ENABLE_TRACING builds)
+    PF_TRACE_THREAD_NAME("Grab");
+    while (!KeyPressed(' '))
+    {
+        // Get from camera image buffer
+        PF_TRACE_SPAN(getSpan, "GetNextBuffer");
+        pfResult = pfStream->GetNextBuffer(pfBuffer);
+        if (pfBuffer)
+            PF_TRACE_FRAME(getSpan, pfBuffer->GetFrameCounter());
+        PF_TRACE_END(getSpan);
+
+        if (pfResult == PFSDK_NOERROR)
+        {
+            if (iter % 2 == 0)  //Display 1 out of 2 images
+            {
+                Mat display = *img;
+                if (!toneMapping && (IsPackedPixelFormat(framePixelFormat) || framePixelFormat == FormatMono16))
+                {
+                    // Most significant bits into the image buffer, one format dispatch per frame
+                    PerfScope scope(perfCounters, perfReport, "ConvertTo8Kernel", frameBytes);
+                    ConvertTo8Kernel convert(FromMat(*img, FormatMono8));
+                    DispatchPixelFormat(ImageView(pfBuffer->GetRawData(), img->cols, img->rows, framePixelFormat), convert);
+                }
+                else if (IsPackedPixelFormat(framePixelFormat))
+                {
+                    // Packed 10/12 bit pixels: unpack to 16 bit, then window them into the image buffer
+                    {
+                        PerfScope scope(perfCounters, perfReport, "UnpackFrameTo16", frameBytes);
+                        UnpackFrameTo16(framePixelFormat, pfBuffer->GetRawData(), PixelFormatLineBytes(framePixelFormat, img->cols),
+                            preview16.data(), img->cols * sizeof(uint16_t), img->cols, img->rows);
+                    }
+                    PerfScope scope(perfCounters, perfReport, "ToneMapper", (uint64_t)img->cols * img->rows * sizeof(uint16_t));
+                    toneMapper.Process(preview16.data(), img->cols * sizeof(uint16_t), img->data, img->step, img->cols, img->rows);
+                }
+                else if (framePixelFormat == FormatMono16)
+                {
+                    // 16 bit pixels: window them into the image buffer, the SDK buffer is only read
+                    PerfScope scope(perfCounters, perfReport, "ToneMapper", frameBytes);
+                    toneMapper.Process((const uint16_t *)pfBuffer->GetRawData(), img->cols * sizeof(uint16_t),
+                        img->data, img->step, img->cols, img->rows);
+                }
+                else
+                {
+                    // Mat header over the buffer returned by the SDK without doing any image copy,
+                    // valid until ReleaseBuffer()
+                    display = ToMat(ImageView(pfBuffer->GetRawData(), img->cols, img->rows, framePixelFormat));
+                }
+                PF_TRACE_SPAN(displaySpan, "Display");
+                PF_TRACE_FRAME(displaySpan, pfBuffer->GetFrameCounter());
+
+                // Display demodulated image with OpenCV. Configure() only keeps displayable
+                // formats; an empty Mat (no OpenCV type) would make imshow() throw.
+                if (!display.empty())
+                    imshow("Display window", display);
+
+                // Save last image (OpenCV Mat) as PNG file
+                // imwrite("image.png", *img);
+
+                // Show our image inside it
+                cvWaitKey(1);
+                PF_TRACE_END(displaySpan);
+
+                iter = 0;
+            }
+            telemetry.RecordFrame(pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp());
+            // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
+            pfStream->ReleaseBuffer(pfBuffer);
+            iter++;
+        }
+        else
+        {
+            if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT)
+                telemetry.RecordTimeout();
+            else
+                telemetry.RecordError();
+            cout << "\nError: " << pfResult.GetDescription() << "\r\n";
+            if (pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR)
+            {
+                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
+                printf("FrameCounter: %lld TimeStamp: %llu MissingPackets: %lu FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
+                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
+                PFImage pfImage;
+                // Construct PFImage object
+                // The image data is managed inside the class and released in the destructor
+                pfBuffer->GetImage(pfImage);
+                // Save image to a file
+                pfImage.SaveToFile("image_error.bmp", BmpFileType);
+            }
+            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
+                cout << "Timeout error!\r\n";
+            }
+            
+        // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
+            if (pfBuffer != nullptr){
+        pfStream->ReleaseBuffer(pfBuffer);
+            }
+        }
+    }
+
+    telemetry.Stop();
+    PF_TRACE_DUMP("trace_opencv.json");
+    if (!perfReport.IsEmpty())
+    {
+        if (!perfCounters.HasHardwareCounters())
+            printf("\nPerformance counters: %s\n", perfCounters.GetError());
+        printf("\nPreview kernels:\n");
+        perfReport.Print(stdout);
+    }
+    cout << endl << "\r\nEnd of grabbing process!" << endl;
+
+    return 0;
+}
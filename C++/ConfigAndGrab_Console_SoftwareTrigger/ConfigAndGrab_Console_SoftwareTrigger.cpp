@@ -1,438 +1,674 @@
-/*
-******************************************************************************
-* @attention
-*
-*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
-*
-* Redistribution and use in source and binary forms, with or without modification,
-* are permitted provided that the following conditions are met:
-* 1. Redistributions of source code must retain the above copyright notice,
-* this list of conditions and the following disclaimer.
-* 2. Redistributions in binary form must reproduce the above copyright notice,
-* this list of conditions and the following disclaimer in the documentation
-* and/or other materials provided with the distribution.
-* 3. Neither the name of Photonfocus nor the names of its contributors
-* may be used to endorse or promote products derived from this software
-* without specific prior written permission.
-*
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
-* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
-* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
-* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
-* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
-* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*
-******************************************************************************
-*/
-
-/**
-//  \file ConfigAndGrab_Console_SoftwareTrigger.cpp
-//
-//  \brief
-//  This example is a command line application that shows the generic process to discover the cameras 
-//  in the computer or network, connect to a camera, grab images using a software trigger, and disconnect.
-//
-//  Description: The main functionality of this example is to show all the available cameras in the 
-//  computer or network and to connect to a specific one. After that it shows how to configure 
-//  some of the camera features and grab images until the 'space' key is pressed.
-//  Finally the camera is freezed and disconnected.
-//
-*/
-#include <cstdio>
-#include <iostream>
-#include <inttypes.h>
-#include <atomic>
-#include <chrono>
-#include <thread>
-
-#include "PFCamera.h"
-#include "PFStreamGEV.h"
-#include "PFStreamU3V.h"
-#include "PFDiscovery.h"
-#include "PFImage.h"
-
-
-#ifdef WIN32
-#include <Windows.h>
-#include <conio.h>
-#else
-#include <unistd.h>  /* only for sleep() */
-#include <sys/select.h>
-#include <sys/ioctl.h>
-#include <termios.h>
-#include <stropts.h>
-
-int _kbhit() {
-    static const int STDIN = 0;
-    static bool initialized = false;
-
-    if (! initialized) {
-        // Use termios to turn off line buffering
-        struct termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
-    }
-
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
-}
-
-char _getch(void)
-{
-    char buf = 0;
-    struct termios old = {0};
-    fflush(stdout);
-    if(tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if(tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if(read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if(tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    return buf;
- }
-#endif
-
-int KeyPressed(char key)
-{
-    return (_kbhit() != 0) && (_getch() == key);
-}
-
-using namespace std;
-using namespace PFCameraDLL;
-
-int Configure(PFCamera &pfCamera);
-int GrabImages(PFCamera &pfCamera, PFStream *pfStream);
-
-int main()
-{
-    PFDiscovery pfDiscover;
-    PFCamera pfCamera;
-    PFCameraInfo *pfCameraInfo; 
-    PFStream *pfStream;
-    PFResult pfResult;
-    uint8_t i,camera;
-    uint16_t selected;
-        
-        
-    // Discover the cameras available in the computer or network
-    pfResult = pfDiscover.DiscoverCameras();
-    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
-    {
-        std::cout << "No cameras found." << endl;
-        _getch();
-        return -1;
-    }
-
-    // For each discovered camera, print the model name, manufacturer, version, etc
-    std::cout << "\nCameras found: \n" << endl;
-    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
-    {
-        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
-        if (pfResult == PFSDK_NOERROR)
-        {
-            std::cout << i + 1 << "- " << pfCameraInfo->GetModelName() << " Manufacturer info: "  << pfCameraInfo->GetManufacturerInfo() <<  endl;
-            pfCameraInfo->printCameraInfo();
-        }
-    }
-    
-    // Select one of the following cameras to connect
-    if (i > 0)
-    {
-        std::cout << "Select a camera from the list: ";
-        cin >> selected;
-        camera = static_cast<uint8_t>(selected)-1;
-    }
-    else
-    {
-        cout << "No cameras found." << endl;
-        _getch();
-        return 0;
-    }
-
-    // Get the information of the selected camera and keep it in pfCameraInfo
-    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,camera);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-
-    // Connect the camera using pfCameraInfo
-    std::cout << "Connecting camera " << selected << " ..." << endl;
-    pfResult = pfCamera.Connect(*pfCameraInfo);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }           
-
-    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
-#if !defined(NDEBUG)
-    pfResult = pfCamera.SetHeartbeatRate(10000);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-#endif
-    
-    // Configure some camera features
-    Configure(pfCamera);
-
-    // Set the SCPS PacketSize for a proper streaming
-    int packetSize = 8164;
-    pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", packetSize);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "GevSCPSPacketSize: " << packetSize << endl;
-
-    // In order to grab images it is necessary to prepare a proper stream.
-    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
-        pfStream = new PFStreamGEV(false, false, true, true);
-    else
-        pfStream = new PFStreamU3V();
-    
-    // Default Ring buffer Count
-    pfStream->SetBufferCount(100);
-    // It is mandatory to add this stream to the camera before grabbing images.
-    pfResult = pfCamera.AddStream(pfStream);
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        _getch();
-        return -1;
-    }
-
-    // Start grabbing images
-    pfResult = pfCamera.Grab();
-
-    if (pfResult != PFSDK_NOERROR)
-    {
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-        // Stop grabbing
-        pfCamera.Freeze();
-        // Disconnect the Camera
-        pfCamera.Disconnect();
-        // Delete stream pointer
-        if (pfStream != nullptr)
-            delete pfStream;
-
-        std::cout << "\r\nPress any key to finish...\r\n" << endl;
-        _getch();
-        return -2;
-    }
-    
-    GrabImages(pfCamera, pfStream);
-
-    // Stop grabbing
-    pfCamera.Freeze();
-    // Disconnect the camera
-    pfCamera.Disconnect();
-
-    // Finally the stream pointer is deleted
-    if (pfStream != nullptr)
-        delete pfStream;
-    
-    std::cout << "\r\nPress any key to finish...\r\n" << endl;
-    _getch();
-    return 0;
-}
-
-int Configure(PFCamera &pfCamera)
-{
-    PFFeatureParameters pfFeatureParams;
-    PFResult pfResult;
-    int64_t width, height;
-    double double_value;
-    char enum_str[64];
-
-    //Enable trigger mode
-    pfResult = pfCamera.SetFeatureEnum("TriggerMode", "On");
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-
-    //Select software trigger source
-    pfResult = pfCamera.SetFeatureEnum("TriggerSource", "Software");
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("Width", &pfFeatureParams);
-    width = pfFeatureParams.Max;
-
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureInt("Width", width);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Width value
-    pfResult = pfCamera.GetFeatureInt("Width", width);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "Width: " << (uint16_t)width << endl;
-
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("Height", &pfFeatureParams);
-    height = pfFeatureParams.Max;
-
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureInt("Height", height);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Height value
-    pfResult = pfCamera.GetFeatureInt("Height", height);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "Height: " << (uint16_t)height << endl;
-
-    // Set pixel format
-    pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back pixel format
-    pfResult = pfCamera.GetFeatureEnum("PixelFormat", enum_str);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "PixelFormat: " << enum_str << endl;
-
-    // Set Exposure Time value
-    double_value = 1000.0;
-    // Check if the value is inside the limits
-    pfResult = pfCamera.GetFeatureParams("ExposureTime", &pfFeatureParams);
-    if (double_value > pfFeatureParams.FloatMax)
-        double_value = pfFeatureParams.FloatMax;
-    else if (double_value < pfFeatureParams.FloatMin)
-        double_value = pfFeatureParams.FloatMin;
-    // Set the corresponding value
-    pfResult = pfCamera.SetFeatureFloat("ExposureTime", double_value);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    // Read back Exposure Time value
-    pfResult = pfCamera.GetFeatureFloat("ExposureTime", double_value);
-    if (pfResult != PFSDK_NOERROR)
-        std::cout << "Error: " << pfResult.GetDescription() << endl;
-    else
-        std::cout << "ExposureTime: " << double_value << endl;
-
-    return 0;
-}
-
-int GrabImages(PFCamera& pfCamera, PFStream *pfStream)
-{
-    PFResult pfResult;
-    PFBuffer *pfBuffer;
-    int iter = 0;
-    double fps;
-    double networkRate;
-    int64_t oldFrameCounter = 0;
-    StreamStatistics statistics;
-    // Grab images
-    fflush(stdin);
-
-    std::cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
-    while (!KeyPressed(' '))
-    {
-        auto triggerResult = pfCamera.SetFeatureCommand("TriggerSoftware", 1);
-        if (triggerResult != PFSDK_NOERROR)
-            std::cout << "Error: " << triggerResult.GetDescription() << endl;
-        // Get from camera image buffer
-        pfResult = pfStream->GetNextBuffer(pfBuffer);
-        
-        if (pfResult == PFSDK_NOERROR)
-        {
-        
-            /*
-            if (iter % 1000 == 0) //Save 1 out of 100 images
-            {
-                PFImage pfImage;
-                // Construct PFImage object
-                // The image data is managed inside the class and released in the destructor
-                pfBuffer->GetImage(pfImage);
-                // Save image to a file
-                pfImage.SaveToFile("image.bmp", pfImageFileType::BmpFileType);
-                iter = 0;
-            }
-            */
-            statistics = pfStream->GetStreamStatistics();  
-            printf("FrameCounter: %" PRId64 " TimeStamp: %" PRIu64 " FPS: %05.3f %05.3f Mbps \r", 
-                pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp(), statistics.m_fpsGrab, statistics.m_networkRate);
-
-            iter++;
-        }
-        else
-        {
-            //When there are missing packets, pfbuffer is valid only if stream corrupt frames is enabled.
-            if ((pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR) && pfBuffer)
-            {
-                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
-                printf("FrameCounter: %" PRId64 " TimeStamp: %" PRIu64 " MissingPackets: %" PRIu32 " FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
-                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
-                PFImage pfImage;
-                // Construct PFImage object
-                // The image data is managed inside the class and released in the destructor
-                pfBuffer->GetImage(pfImage);
-                // Save image to a file
-                pfImage.SaveToFile("image_error.bmp", BmpFileType);
-            }
-            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
-                printf("Timeout error!\r\n");
-            }
-        }
-
-        if(pfBuffer) {
-            //Check if any frames were lost. Corrupt frames will count as lost
-            //unless the option to stream corrupt frames is enabled.
-            int64_t lostFrames;
-            if(pfBuffer->GetFrameCounter() > oldFrameCounter)
-                lostFrames = pfBuffer->GetFrameCounter() - oldFrameCounter - 1;
-            else {
-                lostFrames = 65535 - oldFrameCounter - pfBuffer->GetFrameCounter() + 1;
-            }
-
-            if (lostFrames)
-            {
-                printf("\nLost frames: %" PRId64 " - Last(%" PRId64 ") - Current(%" PRId64 ")\n",
-                    lostFrames, oldFrameCounter, pfBuffer->GetFrameCounter());
-            }
-            oldFrameCounter = pfBuffer->GetFrameCounter();
-        }
-
-        // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() 
-        fflush(stdout);
-        pfStream->ReleaseBuffer(pfBuffer);
-    }
-
-    statistics = pfStream->GetStreamStatistics();
-
-    float pct_lost = (statistics.m_lostFrames)*100/(float)statistics.m_totalFrames;
-    float pct_error = (statistics.m_errorFrames)*100/(float)statistics.m_totalFrames;
-    printf("\n\nTotal frames: %" PRId64 " Lost: %" PRIu64 " (%.3f\%) Errors: %" PRIu64 " (%.3f\%)\n",
-        statistics.m_totalFrames, statistics.m_lostFrames, pct_lost,
-        statistics.m_errorFrames, pct_error);
-
-    std::cout << endl << "\r\nEnd of grabbing process!" << endl;
-
-    return 0;
-}
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ConfigAndGrab_Console_SoftwareTrigger.cpp
+//
+//  \brief
+//  This example is a command line application that shows the generic process to discover the cameras 
+//  in the computer or network, connect to a camera, grab images using a software trigger, and disconnect.
+//
+//  Description: The main functionality of this example is to show all the available cameras in the 
+//  computer or network and to connect to a specific one. After that it shows how to configure 
+//  some of the camera features and grab images until the 'space' key is pressed.
+//  Finally the camera is freezed and disconnected.
+//
+//  Triggers are issued from a separate thread by TriggerScheduler. With the default of one trigger
+//  in flight each frame is triggered after the previous one arrived. Use "-inflight N" to keep N
+//  triggers outstanding, so exposure, readout and transfer of consecutive frames overlap and the
+//  triggered frame rate gets close to the free running one.
+//
+//  "-rate HZ" sends the triggers at a fixed rate on absolute deadlines instead (e.g. 250 Hz to follow
+//  a robot controller cycle). "-spin US" busy waits the last microseconds before every deadline to
+//  reduce the wakeup jitter, which is reported at the end of the grab. Neither mode triggers faster
+//  than exposure plus readout time allow, the camera would ignore those triggers.
+//
+//  "-benchmark N" measures the software trigger to frame latency for N frames instead of the
+//  interactive grab. For every frame the host monotonic time at the trigger command, at its return
+//  and at the arrival in GetNextBuffer is recorded together with the camera timestamp. The
+//  distributions (p50/p99/max) are printed and the raw samples are written to latency.csv.
+//  A CameraClockModel maps the camera timestamps to host time, which splits the latency in
+//  trigger to exposure timestamp and timestamp to arrival.
+//  Use it with the default of one trigger in flight to measure the pure latency.
+//
+//  "-telemetry SINKS" selects where the grab status is reported, e.g. "console,csv:status.csv".
+//
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFStreamU3V.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+
+#include "CameraClockModel.h"
+#include "FrameSequenceTracker.h"
+#include "HostClock.h"
+#include "Telemetry.h"
+#include "TriggerScheduler.h"
+
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#else
+#include <unistd.h>  /* only for sleep() */
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <stropts.h>
+
+int _kbhit() {
+    static const int STDIN = 0;
+    static bool initialized = false;
+
+    if (! initialized) {
+        // Use termios to turn off line buffering
+        struct termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+}
+
+char _getch(void)
+{
+    char buf = 0;
+    struct termios old = {0};
+    fflush(stdout);
+    if(tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if(tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    if(read(0, &buf, 1) < 0)
+        perror("read()");
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if(tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    return buf;
+ }
+#endif
+
+int KeyPressed(char key)
+{
+    return (_kbhit() != 0) && (_getch() == key);
+}
+
+using namespace std;
+using namespace PFCameraDLL;
+
+int Configure(PFCamera &pfCamera);
+// Options of the trigger scheduler, set from the command line
+struct TriggerOptions
+{
+    int inFlight;       // Triggers kept outstanding
+    double rateHz;      // Fixed trigger rate, 0 to trigger as fast as possible
+    int spinUs;         // Busy wait before each fixed rate deadline
+    int benchmarkFrames;// Run the latency benchmark for this number of frames, 0 for interactive grab
+    const char *telemetrySpec; // Telemetry sinks of the interactive grab
+};
+
+int GrabImages(PFCamera &pfCamera, PFStream *pfStream, const TriggerOptions &options);
+int BenchmarkLatency(PFCamera &pfCamera, PFStream *pfStream, const TriggerOptions &options);
+uint64_t MinTriggerIntervalNs(PFCamera &pfCamera);
+
+int main(int argc, char *argv[])
+{
+    PFDiscovery pfDiscover;
+    PFCamera pfCamera;
+    PFCameraInfo *pfCameraInfo; 
+    PFStream *pfStream;
+    PFResult pfResult;
+    uint8_t i,camera;
+    uint16_t selected;
+    TriggerOptions options = { 1, 0.0, 0, 0, "console" };
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        // Number of software triggers kept outstanding
+        if (strcmp(argv[arg], "-inflight") == 0 && arg + 1 < argc)
+            options.inFlight = atoi(argv[++arg]);
+        // Fixed trigger rate in Hz
+        else if (strcmp(argv[arg], "-rate") == 0 && arg + 1 < argc)
+            options.rateHz = atof(argv[++arg]);
+        // Busy wait before each deadline in microseconds
+        else if (strcmp(argv[arg], "-spin") == 0 && arg + 1 < argc)
+            options.spinUs = atoi(argv[++arg]);
+        // Number of frames for the latency benchmark
+        else if (strcmp(argv[arg], "-benchmark") == 0 && arg + 1 < argc)
+            options.benchmarkFrames = atoi(argv[++arg]);
+        // Status sinks, see Telemetry.h
+        else if (strcmp(argv[arg], "-telemetry") == 0 && arg + 1 < argc)
+            options.telemetrySpec = argv[++arg];
+    }
+    if (options.inFlight < 1)
+        options.inFlight = 1;
+
+    // Discover the cameras available in the computer or network
+    pfResult = pfDiscover.DiscoverCameras();
+    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
+    {
+        std::cout << "No cameras found." << endl;
+        _getch();
+        return -1;
+    }
+
+    // For each discovered camera, print the model name, manufacturer, version, etc
+    std::cout << "\nCameras found: \n" << endl;
+    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
+    {
+        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
+        if (pfResult == PFSDK_NOERROR)
+        {
+            std::cout << i + 1 << "- " << pfCameraInfo->GetModelName() << " Manufacturer info: "  << pfCameraInfo->GetManufacturerInfo() <<  endl;
+            pfCameraInfo->printCameraInfo();
+        }
+    }
+    
+    // Select one of the following cameras to connect
+    if (i > 0)
+    {
+        std::cout << "Select a camera from the list: ";
+        cin >> selected;
+        camera = static_cast<uint8_t>(selected)-1;
+    }
+    else
+    {
+        cout << "No cameras found." << endl;
+        _getch();
+        return 0;
+    }
+
+    // Get the information of the selected camera and keep it in pfCameraInfo
+    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,camera);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+
+    // Connect the camera using pfCameraInfo
+    std::cout << "Connecting camera " << selected << " ..." << endl;
+    pfResult = pfCamera.Connect(*pfCameraInfo);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }           
+
+    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
+#if !defined(NDEBUG)
+    pfResult = pfCamera.SetHeartbeatRate(10000);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+#endif
+    
+    // Configure some camera features
+    Configure(pfCamera);
+
+    // Set the SCPS PacketSize for a proper streaming
+    int packetSize = 8164;
+    pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", packetSize);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "GevSCPSPacketSize: " << packetSize << endl;
+
+    // In order to grab images it is necessary to prepare a proper stream.
+    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
+        pfStream = new PFStreamGEV(false, false, true, true);
+    else
+        pfStream = new PFStreamU3V();
+    
+    // Default Ring buffer Count
+    pfStream->SetBufferCount(100);
+    // It is mandatory to add this stream to the camera before grabbing images.
+    pfResult = pfCamera.AddStream(pfStream);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+
+    // Start grabbing images
+    pfResult = pfCamera.Grab();
+
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        // Stop grabbing
+        pfCamera.Freeze();
+        // Disconnect the Camera
+        pfCamera.Disconnect();
+        // Delete stream pointer
+        if (pfStream != nullptr)
+            delete pfStream;
+
+        std::cout << "\r\nPress any key to finish...\r\n" << endl;
+        _getch();
+        return -2;
+    }
+    
+    if (options.benchmarkFrames > 0)
+        BenchmarkLatency(pfCamera, pfStream, options);
+    else
+        GrabImages(pfCamera, pfStream, options);
+
+    // Stop grabbing
+    pfCamera.Freeze();
+    // Disconnect the camera
+    pfCamera.Disconnect();
+
+    // Finally the stream pointer is deleted
+    if (pfStream != nullptr)
+        delete pfStream;
+    
+    std::cout << "\r\nPress any key to finish...\r\n" << endl;
+    _getch();
+    return 0;
+}
+
+int Configure(PFCamera &pfCamera)
+{
+    PFFeatureParameters pfFeatureParams;
+    PFResult pfResult;
+    int64_t width, height;
+    double double_value;
+    char enum_str[64];
+
+    //Enable trigger mode
+    pfResult = pfCamera.SetFeatureEnum("TriggerMode", "On");
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+
+    //Select software trigger source
+    pfResult = pfCamera.SetFeatureEnum("TriggerSource", "Software");
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("Width", &pfFeatureParams);
+    width = pfFeatureParams.Max;
+
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureInt("Width", width);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Width value
+    pfResult = pfCamera.GetFeatureInt("Width", width);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "Width: " << (uint16_t)width << endl;
+
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("Height", &pfFeatureParams);
+    height = pfFeatureParams.Max;
+
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureInt("Height", height);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Height value
+    pfResult = pfCamera.GetFeatureInt("Height", height);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "Height: " << (uint16_t)height << endl;
+
+    // Set pixel format
+    pfResult = pfCamera.SetFeatureEnum("PixelFormat", "Mono8");
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back pixel format
+    pfResult = pfCamera.GetFeatureEnum("PixelFormat", enum_str);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "PixelFormat: " << enum_str << endl;
+
+    // Set Exposure Time value
+    double_value = 1000.0;
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("ExposureTime", &pfFeatureParams);
+    if (double_value > pfFeatureParams.FloatMax)
+        double_value = pfFeatureParams.FloatMax;
+    else if (double_value < pfFeatureParams.FloatMin)
+        double_value = pfFeatureParams.FloatMin;
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Exposure Time value
+    pfResult = pfCamera.GetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "ExposureTime: " << double_value << endl;
+
+    return 0;
+}
+
+// Shortest trigger interval the sensor accepts: exposure plus readout. The readout time is taken
+// from SensorReadoutTime, or else from the frame period at AcquisitionFrameRateMax.
+uint64_t MinTriggerIntervalNs(PFCamera &pfCamera)
+{
+    double exposureTime = 0.0, readoutTime = 0.0, maxFrameRate = 0.0;
+    if (pfCamera.GetFeatureFloat("ExposureTime", exposureTime) != PFSDK_NOERROR)
+        exposureTime = 0.0;
+    if (pfCamera.GetFeatureFloat("SensorReadoutTime", readoutTime) != PFSDK_NOERROR)
+        readoutTime = 0.0;
+    uint64_t intervalNs = (uint64_t)((exposureTime + readoutTime) * 1000.0);
+    if (pfCamera.GetFeatureFloat("AcquisitionFrameRateMax", maxFrameRate) == PFSDK_NOERROR && maxFrameRate > 0.0 &&
+        (uint64_t)(1e9 / maxFrameRate) > intervalNs)
+        intervalNs = (uint64_t)(1e9 / maxFrameRate);
+    return intervalNs;
+}
+
+int GrabImages(PFCamera& pfCamera, PFStream *pfStream, const TriggerOptions &options)
+{
+    PFResult pfResult;
+    PFBuffer *pfBuffer;
+    int iter = 0;
+    FrameSequenceTracker frameTracker;
+    StreamStatistics statistics;
+
+    // Triggers are sent from the scheduler thread, the loop below only collects the buffers
+    TriggerScheduler scheduler([&pfCamera]() {
+        PFResult triggerResult = pfCamera.SetFeatureCommand("TriggerSoftware", 1);
+        return triggerResult == PFSDK_NOERROR;
+    }, options.inFlight);
+
+    // The sensor ignores triggers while it is still exposing or reading out the previous frame
+    scheduler.SetMinInterval(MinTriggerIntervalNs(pfCamera));
+    if (options.rateHz > 0.0)
+        scheduler.SetRate(options.rateHz, (uint64_t)options.spinUs * 1000);
+
+    // Grab images
+    fflush(stdin);
+
+    std::cout << "\r\nTriggers in flight: " << options.inFlight << endl;
+    if (options.rateHz > 0.0)
+        std::cout << "Trigger rate: " << options.rateHz << " Hz" << endl;
+    Telemetry telemetry;
+    telemetry.AddSinks(options.telemetrySpec);
+    AddStreamStatisticsSampler(telemetry, pfStream);
+
+    std::cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
+    telemetry.Start();
+    scheduler.Start();
+    while (!KeyPressed(' '))
+    {
+        // Get from camera image buffer
+        pfResult = pfStream->GetNextBuffer(pfBuffer);
+        uint64_t arrivalNs = HostNowNs();
+        
+        if (pfResult == PFSDK_NOERROR)
+        {
+        
+            /*
+            if (iter % 1000 == 0) //Save 1 out of 100 images
+            {
+                PFImage pfImage;
+                // Construct PFImage object
+                // The image data is managed inside the class and released in the destructor
+                pfBuffer->GetImage(pfImage);
+                // Save image to a file
+                pfImage.SaveToFile("image.bmp", pfImageFileType::BmpFileType);
+                iter = 0;
+            }
+            */
+            telemetry.RecordFrame(pfBuffer->GetFrameCounter(), pfBuffer->GetTimestamp());
+
+            iter++;
+        }
+        else
+        {
+            if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT)
+                telemetry.RecordTimeout();
+            else
+                telemetry.RecordError();
+            //When there are missing packets, pfbuffer is valid only if stream corrupt frames is enabled.
+            if ((pfResult == PFSDK_ERROR_GETIMAGE_MISSING_PACKETS || pfResult == PFSDK_ERROR_GETIMAGE_GRAB_ERROR) && pfBuffer)
+            {
+                // If the streamCorruptFrames option of the PFStreamGEV is enabled, pfBuffer will contain the corrupted frame and metadata, including MissingPacketCount.
+                printf("FrameCounter: %" PRId64 " TimeStamp: %" PRIu64 " MissingPackets: %" PRIu32 " FrameCorrupted:%u \r\n", pfBuffer->GetFrameCounter(),
+                    pfBuffer->GetTimestamp(), pfBuffer->GetMissingPacketCount(), pfBuffer->IsFrameCorrupted());
+                PFImage pfImage;
+                // Construct PFImage object
+                // The image data is managed inside the class and released in the destructor
+                pfBuffer->GetImage(pfImage);
+                // Save image to a file
+                pfImage.SaveToFile("image_error.bmp", BmpFileType);
+            }
+            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT){
+                printf("Timeout error!\r\n");
+            }
+        }
+
+        if(pfBuffer) {
+            //Check if any frames were lost. Corrupt frames will count as lost
+            //unless the option to stream corrupt frames is enabled.
+            //The tracker takes care of the 16 bit counter wraparound and of stream restarts.
+            uint64_t lostFrames = frameTracker.Update(pfBuffer->GetFrameCounter(), arrivalNs);
+            // Hand the frame back to the scheduler so the next trigger can be sent
+            scheduler.Complete(pfBuffer->GetFrameCounter(), arrivalNs);
+            // Loss bursts are reported by the tracker at the end
+            telemetry.RecordLost(lostFrames);
+        }
+
+        // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() 
+        pfStream->ReleaseBuffer(pfBuffer);
+    }
+    scheduler.Stop();
+    telemetry.Stop();
+
+    statistics = pfStream->GetStreamStatistics();
+
+    float pct_lost = (statistics.m_lostFrames)*100/(float)statistics.m_totalFrames;
+    float pct_error = (statistics.m_errorFrames)*100/(float)statistics.m_totalFrames;
+    printf("\n\nTotal frames: %" PRId64 " Lost: %" PRIu64 " (%.3f\%) Errors: %" PRIu64 " (%.3f\%)\n",
+        statistics.m_totalFrames, statistics.m_lostFrames, pct_lost,
+        statistics.m_errorFrames, pct_error);
+    frameTracker.PrintReport(stdout, statistics.m_lostFrames);
+    scheduler.PrintReport(stdout);
+
+    std::cout << endl << "\r\nEnd of grabbing process!" << endl;
+
+    return 0;
+}
+
+// One measurement of the latency benchmark
+struct LatencySample
+{
+    uint64_t sequence;
+    uint64_t triggerNs;
+    uint64_t sentNs;
+    uint64_t arrivalNs;
+    uint64_t cameraTimestamp;
+    int64_t frameCounter;
+};
+
+int BenchmarkLatency(PFCamera &pfCamera, PFStream *pfStream, const TriggerOptions &options)
+{
+    PFResult pfResult;
+    PFBuffer *pfBuffer;
+    int64_t tickFrequency = 0;
+    std::vector<LatencySample> samples;
+    LatencyHistogram command, triggerToArrival, hostInterval, cameraInterval;
+    uint64_t lastArrivalNs = 0, lastCameraTimestamp = 0;
+
+    samples.reserve(options.benchmarkFrames);
+
+    TriggerScheduler scheduler([&pfCamera]() {
+        PFResult triggerResult = pfCamera.SetFeatureCommand("TriggerSoftware", 1);
+        return triggerResult == PFSDK_NOERROR;
+    }, options.inFlight);
+
+    scheduler.SetMinInterval(MinTriggerIntervalNs(pfCamera));
+    if (options.rateHz > 0.0)
+        scheduler.SetRate(options.rateHz, (uint64_t)options.spinUs * 1000);
+
+    // Camera timestamps are in ticks of this frequency (GigE Vision); 0 if not available
+    if (pfCamera.GetFeatureInt("GevTimestampTickFrequency", tickFrequency) != PFSDK_NOERROR)
+        tickFrequency = 0;
+    // Without the feature the model estimates the tick rate itself
+    CameraClockModel clockModel((double)tickFrequency);
+
+    std::cout << "\r\nLatency benchmark: " << options.benchmarkFrames << " frames, "
+        << options.inFlight << " trigger(s) in flight" << endl;
+
+    // Nothing is printed inside the loop, the console would be part of the measurement
+    scheduler.Start();
+    while ((int)samples.size() < options.benchmarkFrames)
+    {
+        pfResult = pfStream->GetNextBuffer(pfBuffer);
+        uint64_t arrivalNs = HostNowNs();
+
+        if (pfResult == PFSDK_NOERROR)
+        {
+            TriggerRecord record;
+            if (scheduler.Complete(pfBuffer->GetFrameCounter(), arrivalNs, &record))
+            {
+                LatencySample sample;
+                sample.sequence = record.sequence;
+                sample.triggerNs = record.triggerNs;
+                sample.sentNs = record.sentNs;
+                sample.arrivalNs = arrivalNs;
+                sample.cameraTimestamp = pfBuffer->GetTimestamp();
+                sample.frameCounter = pfBuffer->GetFrameCounter();
+                samples.push_back(sample);
+                clockModel.Add(sample.cameraTimestamp, arrivalNs);
+
+                if (record.sentNs)
+                    command.Record(record.sentNs - record.triggerNs);
+                triggerToArrival.Record(arrivalNs - record.triggerNs);
+                if (lastArrivalNs)
+                {
+                    hostInterval.Record(arrivalNs - lastArrivalNs);
+                    cameraInterval.Record(sample.cameraTimestamp - lastCameraTimestamp);
+                }
+                lastArrivalNs = arrivalNs;
+                lastCameraTimestamp = sample.cameraTimestamp;
+            }
+        }
+        else if (pfBuffer)
+        {
+            // Corrupt frame, still consumes its trigger
+            scheduler.Complete(pfBuffer->GetFrameCounter(), arrivalNs);
+        }
+        else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT)
+        {
+            printf("Timeout error!\r\n");
+        }
+
+        if (pfBuffer)
+            pfStream->ReleaseBuffer(pfBuffer);
+
+        if (KeyPressed(' '))
+            break;
+    }
+    scheduler.Stop();
+
+    printf("\n");
+    scheduler.PrintReport(stdout);
+    command.Print(stdout, "TriggerSoftware command");
+    triggerToArrival.Print(stdout, "Trigger to GetNextBuffer");
+    triggerToArrival.PrintDistribution(stdout);
+    hostInterval.Print(stdout, "Host frame interval");
+    if (tickFrequency > 0)
+        cameraInterval.Print(stdout, "Camera frame interval", tickFrequency / 1e6, "us");
+    else
+        cameraInterval.Print(stdout, "Camera frame interval", 1.0, "ticks");
+
+    // Split the latency at the camera timestamp, using the final fit for all samples
+    if (clockModel.IsValid())
+    {
+        LatencyHistogram toTimestamp, fromTimestamp;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            uint64_t timestampNs = clockModel.ToHostNs(samples[i].cameraTimestamp);
+            toTimestamp.Record(timestampNs > samples[i].triggerNs ? timestampNs - samples[i].triggerNs : 0);
+            fromTimestamp.Record(samples[i].arrivalNs > timestampNs ? samples[i].arrivalNs - timestampNs : 0);
+        }
+        clockModel.PrintReport(stdout);
+        // The host time of a timestamp includes the minimum transport delay, see CameraClockModel.h
+        toTimestamp.Print(stdout, "Trigger to camera timestamp (+ min. transport)");
+        fromTimestamp.Print(stdout, "Camera timestamp to arrival (above minimum)");
+    }
+
+    // Raw samples for offline analysis
+    FILE *csv = fopen("latency.csv", "w");
+    if (csv)
+    {
+        fprintf(csv, "sequence,frame_counter,trigger_ns,sent_ns,arrival_ns,camera_timestamp,camera_host_ns\n");
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            fprintf(csv, "%" PRIu64 ",%" PRId64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                samples[i].sequence, samples[i].frameCounter, samples[i].triggerNs, samples[i].sentNs,
+                samples[i].arrivalNs, samples[i].cameraTimestamp,
+                clockModel.IsValid() ? clockModel.ToHostNs(samples[i].cameraTimestamp) : 0);
+        }
+        fclose(csv);
+        printf("Samples written to latency.csv\n");
+    }
+
+    std::cout << endl << "\r\nEnd of latency benchmark!" << endl;
+
+    return 0;
+}
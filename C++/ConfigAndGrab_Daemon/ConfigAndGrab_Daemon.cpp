@@ -0,0 +1,877 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file ConfigAndGrab_Daemon.cpp
+//
+//  \brief
+//  Headless acquisition: connects to a camera, grabs continuously and is controlled through a
+//  Unix domain socket instead of the keyboard.
+//
+//  Description: the interactive examples poll the keyboard (ioctl(FIONREAD)), flush stdout and
+//  print a status line for every frame, so their throughput depends on the terminal. Here the grab
+//  loop makes no terminal or socket system call at all. A control thread serves the socket and
+//  hands the commands to the grab loop, which executes them between two frames.
+//
+//  Usage:
+//      PFCameraLib_ConfigAndGrab_Daemon [-camera N] [-socket PATH] [-publish NAME] [-buffers N] [-idle]
+//                                       [-metrics [ADDRESS:]PORT] [-metricsfile PATH]
+//
+//      -camera N       Camera number in discovery order (default 1)
+//      -socket PATH    Control socket (default /tmp/pf_daemon.sock)
+//      -publish NAME   Publish all frames to the shared memory frame bus /dev/shm/NAME
+//      -buffers N      Ring buffer count (default 100)
+//      -idle           Do not start grabbing until the "start" command
+//      -metrics        Serve Prometheus metrics on http://ADDRESS:PORT/metrics. ADDRESS defaults to
+//                      127.0.0.1, so only local scrapers see them; 0.0.0.0:PORT serves all interfaces.
+//      -metricsfile    Write the metrics every 5 s to PATH, for the node_exporter textfile collector
+//
+//  Commands, one per line, each answered with one line starting with "OK" or "ERROR":
+//      start                   Start grabbing
+//      stop                    Stop grabbing
+//      set <Feature> <Value>   Set a camera feature. Features that cannot change while grabbing
+//                              (Width, PixelFormat, ...) are set with a short Freeze()/Grab().
+//                              Other failures are answered with the SDK error.
+//      snapshot <File.bmp>     Save the next frame. Answered with an error if grabbing stops first.
+//      stats                   Frame, loss and rate counters
+//      quit                    Stop grabbing and exit
+//
+//  For example: echo stats | socat - UNIX-CONNECT:/tmp/pf_daemon.sock
+//
+//  The metrics (MetricsExporter.h) cover frame, loss, error and timeout counters, frame rate and
+//  network rate, the age of the last frame, the command queue depth and latency histograms of the
+//  grab stages: waiting in GetNextBuffer, publishing to the frame bus and the whole hold time of a
+//  buffer. An alert on pf_frame_age_seconds or rate(pf_frames_total[1m]) catches stalled cells.
+//
+//  SIGINT and SIGTERM shut the daemon down cleanly (Freeze(), Disconnect(), socket removed).
+//
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFStreamU3V.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+
+#include "FrameSequenceTracker.h"
+#include "HostClock.h"
+#include "MetricsExporter.h"
+#include "PixelFormats.h"
+#include "SharedFrameBus.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+using namespace PFCameraDLL;
+
+// Set by the signal handler, which also writes to the wake pipe of the control thread
+static volatile sig_atomic_t g_signalled = 0;
+static int g_wakePipe[2] = { -1, -1 };
+
+static void OnSignal(int)
+{
+    g_signalled = 1;
+    char byte = 's';
+    // write() is async-signal-safe
+    ssize_t written = write(g_wakePipe[1], &byte, 1);
+    (void)written;
+}
+
+static void WakeControlThread()
+{
+    char byte = 'w';
+    ssize_t written = write(g_wakePipe[1], &byte, 1);
+    (void)written;
+}
+
+struct DaemonOptions
+{
+    int camera;
+    const char *socketPath;
+    const char *busName;
+    int bufferCount;
+    bool idle;
+    const char *metricsAddress;
+    int metricsPort;
+    const char *metricsFile;
+};
+
+struct ControlCommand
+{
+    uint64_t clientId;
+    string line;
+};
+
+struct ControlReply
+{
+    uint64_t clientId;
+    string text;
+};
+
+// Grab loop and command execution. Runs on the main thread.
+class AcquisitionDaemon
+{
+public:
+    AcquisitionDaemon(PFCamera &camera, PFStream *stream, SharedFrameBusPublisher *publisher)
+        : m_camera(camera), m_stream(stream), m_publisher(publisher), m_grabbing(false), m_shutdown(false),
+          m_commandPending(false),
+          m_frames(m_metrics.AddCounter("pf_frames_total", "Frames received")),
+          m_lost(m_metrics.AddCounter("pf_frames_lost_total", "Frames lost, from the frame counter sequence")),
+          m_errors(m_metrics.AddCounter("pf_frame_errors_total", "Incomplete or corrupted frames")),
+          m_timeouts(m_metrics.AddCounter("pf_frame_timeouts_total", "GetNextBuffer timeouts")),
+          m_grabbingGauge(m_metrics.AddGauge("pf_grabbing", "1 while the camera is grabbing")),
+          m_commandDepth(m_metrics.AddGauge("pf_command_queue_depth", "Control commands waiting for the grab loop")),
+          m_lastArrivalNs(0), m_snapshotClient(0)
+    {
+        m_frameInfo = {};
+        ReadFrameInfo();
+        RegisterMetrics();
+    }
+
+    MetricsRegistry &GetMetrics() { return m_metrics; }
+
+    // Called by the control thread
+    void PostCommand(uint64_t clientId, const string &line)
+    {
+        {
+            lock_guard<mutex> lock(m_commandMutex);
+            m_commands.push_back({ clientId, line });
+            m_commandDepth.Set((double)m_commands.size());
+        }
+        m_commandPending.store(true, memory_order_release);
+        m_commandCondition.notify_one();
+    }
+
+    void RequestShutdown()
+    {
+        {
+            // Under the lock: Run() can not be between its predicate check and the wait
+            lock_guard<mutex> lock(m_commandMutex);
+            m_shutdown.store(true);
+        }
+        m_commandCondition.notify_one();
+    }
+
+    bool IsShutdown() const { return m_shutdown.load(); }
+
+    // Replies produced by the grab loop, sent by the control thread
+    void TakeReplies(vector<ControlReply> &replies)
+    {
+        lock_guard<mutex> lock(m_replyMutex);
+        replies.insert(replies.end(), m_replies.begin(), m_replies.end());
+        m_replies.clear();
+    }
+
+    bool StartGrab()
+    {
+        if (m_grabbing)
+            return true;
+        if (m_camera.Grab() != PFSDK_NOERROR)
+            return false;
+        m_tracker.Restart();
+        m_grabbing = true;
+        m_grabbingGauge.Set(1.0);
+        return true;
+    }
+
+    void StopGrab()
+    {
+        if (!m_grabbing)
+            return;
+        m_camera.Freeze();
+        m_grabbing = false;
+        m_grabbingGauge.Set(0.0);
+    }
+
+    int Run()
+    {
+        PFResult pfResult;
+        PFBuffer *pfBuffer;
+
+        while (!m_shutdown.load())
+        {
+            if (m_commandPending.load(memory_order_acquire))
+                ProcessCommands();
+
+            if (!m_grabbing)
+            {
+                // Nothing to grab: sleep until a command or the shutdown arrives
+                unique_lock<mutex> lock(m_commandMutex);
+                m_commandCondition.wait(lock, [this]() { return !m_commands.empty() || m_shutdown.load(); });
+                continue;
+            }
+
+            uint64_t waitNs = HostNowNs();
+            pfResult = m_stream->GetNextBuffer(pfBuffer);
+            uint64_t arrivalNs = HostNowNs();
+            m_waitLatency.Record(arrivalNs - waitNs);
+
+            if (pfResult == PFSDK_NOERROR)
+            {
+                m_lost.Add(m_tracker.Update(pfBuffer->GetFrameCounter(), arrivalNs));
+                m_frames.Add();
+                m_lastArrivalNs.store(arrivalNs, memory_order_relaxed);
+
+                if (m_publisher && m_frameInfo.pixelFormat != FormatUnknown)
+                {
+                    SharedFrameInfo info = m_frameInfo;
+                    info.frameCounter = pfBuffer->GetFrameCounter();
+                    info.timestamp = pfBuffer->GetTimestamp();
+                    info.hostNs = arrivalNs;
+                    m_publisher->Publish(info, pfBuffer->GetRawData(), (uint64_t)info.stride * info.height);
+                    m_publishLatency.Record(HostNowNs() - arrivalNs);
+                }
+
+                if (!m_snapshotPath.empty())
+                    SaveSnapshot(pfBuffer);
+            }
+            else if (pfResult == PFSDK_ERROR_GETIMAGE_TIMEOUT)
+            {
+                m_timeouts.Add();
+            }
+            else
+            {
+                m_errors.Add();
+            }
+
+            if (pfBuffer)
+            {
+                m_stream->ReleaseBuffer(pfBuffer);
+                m_holdLatency.Record(HostNowNs() - arrivalNs);
+            }
+        }
+
+        StopGrab();
+        CancelSnapshot("ERROR daemon shutting down");
+        return 0;
+    }
+
+private:
+    void ProcessCommands()
+    {
+        deque<ControlCommand> commands;
+        {
+            lock_guard<mutex> lock(m_commandMutex);
+            commands.swap(m_commands);
+            m_commandPending.store(false, memory_order_relaxed);
+            m_commandDepth.Set(0.0);
+        }
+        for (size_t i = 0; i < commands.size(); i++)
+        {
+            string reply = Execute(commands[i]);
+            if (!reply.empty())
+                Reply(commands[i].clientId, reply);
+        }
+    }
+
+    void Reply(uint64_t clientId, const string &text)
+    {
+        {
+            lock_guard<mutex> lock(m_replyMutex);
+            m_replies.push_back({ clientId, text + "\n" });
+        }
+        WakeControlThread();
+    }
+
+    // Returns the reply, or an empty string if the reply is sent later
+    string Execute(const ControlCommand &command)
+    {
+        char verb[32] = "", name[128] = "", value[256] = "";
+        int fields = sscanf(command.line.c_str(), "%31s %127s %255[^\r\n]", verb, name, value);
+        if (fields < 1)
+            return "ERROR empty command";
+
+        if (strcmp(verb, "start") == 0)
+            return StartGrab() ? "OK grabbing" : "ERROR Grab() failed";
+
+        if (strcmp(verb, "stop") == 0)
+        {
+            StopGrab();
+            CancelSnapshot("ERROR snapshot cancelled, grabbing stopped");
+            return "OK stopped";
+        }
+
+        if (strcmp(verb, "set") == 0 && fields == 3)
+            return SetFeature(name, value);
+
+        if (strcmp(verb, "snapshot") == 0 && fields >= 2)
+        {
+            if (!m_grabbing)
+                return "ERROR not grabbing";
+            if (!m_snapshotPath.empty())
+                return "ERROR snapshot already pending";
+            m_snapshotPath = name;
+            m_snapshotClient = command.clientId;
+            return "";
+        }
+
+        if (strcmp(verb, "stats") == 0)
+            return Stats();
+
+        if (strcmp(verb, "quit") == 0)
+        {
+            RequestShutdown();
+            return "OK shutting down";
+        }
+
+        return "ERROR unknown command, use start|stop|set <Feature> <Value>|snapshot <File>|stats|quit";
+    }
+
+    // Values the grab loop does not maintain itself are read on the exporter thread at every scrape
+    void RegisterMetrics()
+    {
+        MetricGauge &fps = m_metrics.AddGauge("pf_stream_fps", "Frame rate reported by the stream");
+        MetricGauge &networkRate = m_metrics.AddGauge("pf_network_mbps", "Network rate reported by the stream in Mbit/s");
+        MetricCounter &streamLost = m_metrics.AddCounter("pf_stream_lost_frames_total", "Lost frames reported by the stream");
+        MetricGauge &frameAge = m_metrics.AddGauge("pf_frame_age_seconds", "Time since the last frame arrived");
+        MetricCounter &published = m_metrics.AddCounter("pf_frame_bus_published_total", "Frames published to the shared memory frame bus");
+        m_metrics.AddHistogram("pf_stage_latency_seconds", "Time spent per grab stage", "stage=\"wait\"", &m_waitLatency);
+        m_metrics.AddHistogram("pf_stage_latency_seconds", "Time spent per grab stage", "stage=\"publish\"", &m_publishLatency);
+        m_metrics.AddHistogram("pf_stage_latency_seconds", "Time spent per grab stage", "stage=\"hold\"", &m_holdLatency);
+
+        m_metrics.SetCollector([this, &fps, &networkRate, &streamLost, &frameAge, &published]()
+        {
+            StreamStatistics statistics = m_stream->GetStreamStatistics();
+            fps.Set(statistics.m_fpsGrab);
+            networkRate.Set(statistics.m_networkRate);
+            streamLost.Set((uint64_t)statistics.m_lostFrames);
+            uint64_t lastArrivalNs = m_lastArrivalNs.load(memory_order_relaxed);
+            frameAge.Set(lastArrivalNs ? (HostNowNs() - lastArrivalNs) * 1e-9 : 0.0);
+            published.Set(m_publisher ? (uint64_t)m_publisher->GetPublished() : 0);
+        });
+    }
+
+    // Tries bool, integer, float and enumeration, in this order
+    PFResult ApplyFeature(const char *name, const char *value)
+    {
+        char *end;
+        if (strcmp(value, "true") == 0 || strcmp(value, "false") == 0)
+            return m_camera.SetFeatureBool(name, strcmp(value, "true") == 0);
+
+        long long integer = strtoll(value, &end, 0);
+        if (*end == '\0')
+        {
+            PFResult result = m_camera.SetFeatureInt(name, (int64_t)integer);
+            if (result == PFSDK_NOERROR)
+                return result;
+        }
+
+        double real = strtod(value, &end);
+        if (*end == '\0')
+            return m_camera.SetFeatureFloat(name, real);
+
+        return m_camera.SetFeatureEnum(name, value);
+    }
+
+    // Features that change the payload layout; the camera locks them while the stream runs
+    static bool IsLockedWhileGrabbing(const char *name)
+    {
+        static const char *const locked[] = { "Width", "Height", "PixelFormat", "BinningHorizontal", "BinningVertical",
+            "DecimationHorizontal", "DecimationVertical", "DoubleRate_Enable" };
+        for (size_t i = 0; i < sizeof(locked) / sizeof(locked[0]); i++)
+            if (strcmp(name, locked[i]) == 0)
+                return true;
+        return false;
+    }
+
+    // False for integer values outside the range or increment of the feature; those fail frozen as well
+    bool IsValidValue(const char *name, const char *value)
+    {
+        char *end;
+        long long integer = strtoll(value, &end, 0);
+        if (*end != '\0')
+            return true;
+        PFFeatureParameters params;
+        if (m_camera.GetFeatureParams(name, &params) != PFSDK_NOERROR)
+            return true;
+        if (integer < params.Min || integer > params.Max)
+            return false;
+        return params.Inc <= 1 || (integer - params.Min) % params.Inc == 0;
+    }
+
+    string SetFeature(const char *name, const char *value)
+    {
+        PFResult result = ApplyFeature(name, value);
+        // Only a feature that is locked while streaming is retried, unknown features and invalid
+        // values are reported without interrupting the acquisition
+        if (result != PFSDK_NOERROR && m_grabbing && IsLockedWhileGrabbing(name) && IsValidValue(name, value))
+        {
+            // Image format features are locked while streaming: freeze, set and grab again
+            m_camera.Freeze();
+            result = ApplyFeature(name, value);
+            if (m_camera.Grab() != PFSDK_NOERROR)
+            {
+                m_grabbing = false;
+                m_grabbingGauge.Set(0.0);
+                CancelSnapshot("ERROR snapshot cancelled, grabbing stopped");
+                ReadFrameInfo();
+                return string("ERROR Grab() failed after setting ") + name + ", grabbing stopped";
+            }
+            m_tracker.Restart();
+        }
+        if (result != PFSDK_NOERROR)
+            return string("ERROR ") + result.GetDescription();
+
+        ReadFrameInfo();
+        return string("OK ") + name + "=" + value;
+    }
+
+    // Frame layout for the frame bus, after start and after every reconfiguration
+    void ReadFrameInfo()
+    {
+        int64_t width = 0, height = 0;
+        char pixelFormat[64] = "";
+        m_camera.GetFeatureInt("Width", width);
+        m_camera.GetFeatureInt("Height", height);
+        m_camera.GetFeatureEnum("PixelFormat", pixelFormat);
+        m_frameInfo.width = (uint32_t)width;
+        m_frameInfo.height = (uint32_t)height;
+        m_frameInfo.pixelFormat = ParsePixelFormat(pixelFormat);
+        m_frameInfo.stride = (uint32_t)PixelFormatLineBytes(m_frameInfo.pixelFormat, m_frameInfo.width);
+        // A frame that does not fit the bus slots is not published
+        if (m_publisher && (uint64_t)m_frameInfo.stride * m_frameInfo.height > m_publisher->GetMaxFrameBytes())
+            m_frameInfo.pixelFormat = FormatUnknown;
+    }
+
+    // A pending snapshot that no frame will answer any more
+    void CancelSnapshot(const char *reason)
+    {
+        if (m_snapshotPath.empty())
+            return;
+        Reply(m_snapshotClient, reason);
+        m_snapshotPath.clear();
+    }
+
+    void SaveSnapshot(PFBuffer *pfBuffer)
+    {
+        PFImage pfImage;
+        pfBuffer->GetImage(pfImage);
+        PFResult result = pfImage.SaveToFile(m_snapshotPath.c_str(), BmpFileType);
+        if (result == PFSDK_NOERROR)
+            Reply(m_snapshotClient, "OK saved " + m_snapshotPath);
+        else
+            Reply(m_snapshotClient, string("ERROR ") + result.GetDescription());
+        m_snapshotPath.clear();
+    }
+
+    string Stats()
+    {
+        StreamStatistics statistics = m_stream->GetStreamStatistics();
+        char text[512];
+        snprintf(text, sizeof(text),
+            "OK grabbing=%d frames=%" PRIu64 " lost=%" PRIu64 " errors=%" PRIu64 " timeouts=%" PRIu64
+            " restarts=%" PRIu64 " stream_lost=%" PRIu64 " fps=%.3f mbps=%.3f published=%" PRIu64,
+            m_grabbing ? 1 : 0, m_frames.Get(), m_lost.Get(), m_errors.Get(), m_timeouts.Get(),
+            m_tracker.GetRestarts(), (uint64_t)statistics.m_lostFrames, statistics.m_fpsGrab,
+            statistics.m_networkRate, m_publisher ? m_publisher->GetPublished() : 0);
+        return text;
+    }
+
+    PFCamera &m_camera;
+    PFStream *m_stream;
+    SharedFrameBusPublisher *m_publisher;
+    SharedFrameInfo m_frameInfo;
+    bool m_grabbing;
+    atomic<bool> m_shutdown;
+
+    mutex m_commandMutex;
+    condition_variable m_commandCondition;
+    deque<ControlCommand> m_commands;
+    atomic<bool> m_commandPending;
+
+    mutex m_replyMutex;
+    vector<ControlReply> m_replies;
+
+    FrameSequenceTracker m_tracker;
+
+    // Updated by the grab loop with relaxed atomics, rendered by the metrics exporter
+    MetricsRegistry m_metrics;
+    MetricCounter &m_frames;
+    MetricCounter &m_lost;
+    MetricCounter &m_errors;
+    MetricCounter &m_timeouts;
+    MetricGauge &m_grabbingGauge;
+    MetricGauge &m_commandDepth;
+    atomic<uint64_t> m_lastArrivalNs;
+    LatencyHistogram m_waitLatency;
+    LatencyHistogram m_publishLatency;
+    LatencyHistogram m_holdLatency;
+    string m_snapshotPath;
+    uint64_t m_snapshotClient;
+};
+
+// Unix domain socket server. Runs on its own thread and is the only one touching client sockets.
+class ControlServer
+{
+public:
+    ControlServer()
+        : m_listenFd(-1), m_nextClientId(1), m_stop(false)
+    {
+    }
+
+    ~ControlServer()
+    {
+        Close();
+    }
+
+    bool Open(const char *path)
+    {
+        struct sockaddr_un address;
+        if (strlen(path) >= sizeof(address.sun_path))
+            return false;
+
+        m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_listenFd < 0)
+            return false;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+        // A stale socket of a previous run would make bind() fail
+        unlink(path);
+        if (bind(m_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(m_listenFd, 8) != 0)
+        {
+            Close();
+            return false;
+        }
+        m_path = path;
+        return true;
+    }
+
+    // Ends Run() after it has sent the replies queued so far. Called once the grab loop has ended,
+    // so the reply to "quit" is among them.
+    void Stop()
+    {
+        m_stop.store(true);
+        WakeControlThread();
+    }
+
+    void Close()
+    {
+        for (map<uint64_t, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+            CloseClient(it->second.fd);
+        m_clients.clear();
+        if (m_listenFd >= 0)
+        {
+            close(m_listenFd);
+            unlink(m_path.c_str());
+        }
+        m_listenFd = -1;
+    }
+
+    void Run(AcquisitionDaemon &daemon)
+    {
+        vector<struct pollfd> fds;
+        vector<uint64_t> ids;
+
+        while (!m_stop.load())
+        {
+            fds.clear();
+            ids.clear();
+            fds.push_back({ g_wakePipe[0], POLLIN, 0 });
+            fds.push_back({ m_listenFd, POLLIN, 0 });
+            for (map<uint64_t, Client>::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+            {
+                fds.push_back({ it->second.fd, POLLIN, 0 });
+                ids.push_back(it->first);
+            }
+
+            if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+                break;
+
+            if (fds[0].revents & POLLIN)
+            {
+                char drain[64];
+                while (read(g_wakePipe[0], drain, sizeof(drain)) > 0)
+                {
+                }
+                if (g_signalled)
+                    daemon.RequestShutdown();
+            }
+
+            if (fds[1].revents & POLLIN)
+            {
+                int fd = accept(m_listenFd, NULL, NULL);
+                if (fd >= 0)
+                    m_clients[m_nextClientId++].fd = fd;
+            }
+
+            for (size_t i = 2; i < fds.size(); i++)
+            {
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                    ReadClient(ids[i - 2], daemon);
+            }
+
+            SendReplies(daemon);
+        }
+        // Replies queued by the last commands, e.g. the one to "quit"
+        SendReplies(daemon);
+    }
+
+private:
+    struct Client
+    {
+        int fd;
+        string input;
+    };
+
+    void SendReplies(AcquisitionDaemon &daemon)
+    {
+        vector<ControlReply> replies;
+        daemon.TakeReplies(replies);
+        for (size_t i = 0; i < replies.size(); i++)
+        {
+            map<uint64_t, Client>::iterator it = m_clients.find(replies[i].clientId);
+            // The client may have disconnected in the meantime
+            if (it != m_clients.end())
+                send(it->second.fd, replies[i].text.data(), replies[i].text.size(), MSG_NOSIGNAL);
+        }
+    }
+
+    // Half close first: close() with unread input would reset the connection and the client could
+    // lose the last reply. The client gets a short time to read it and hang up.
+    static void CloseClient(int fd)
+    {
+        shutdown(fd, SHUT_WR);
+        struct pollfd pending = { fd, POLLIN, 0 };
+        char drain[256];
+        while (poll(&pending, 1, 100) > 0 && recv(fd, drain, sizeof(drain), 0) > 0)
+        {
+        }
+        close(fd);
+    }
+
+    void ReadClient(uint64_t id, AcquisitionDaemon &daemon)
+    {
+        Client &client = m_clients[id];
+        char buffer[1024];
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            close(client.fd);
+            m_clients.erase(id);
+            return;
+        }
+        client.input.append(buffer, (size_t)received);
+
+        size_t end;
+        while ((end = client.input.find('\n')) != string::npos)
+        {
+            string line = client.input.substr(0, end);
+            client.input.erase(0, end + 1);
+            if (!line.empty())
+                daemon.PostCommand(id, line);
+        }
+        // Protect against clients that never send a newline
+        if (client.input.size() > 4096)
+            client.input.clear();
+    }
+
+    int m_listenFd;
+    string m_path;
+    uint64_t m_nextClientId;
+    map<uint64_t, Client> m_clients;
+    atomic<bool> m_stop;
+};
+
+int main(int argc, char *argv[])
+{
+    PFDiscovery pfDiscover;
+    PFCamera pfCamera;
+    PFCameraInfo *pfCameraInfo;
+    PFStream *pfStream;
+    PFResult pfResult;
+    DaemonOptions options = { 1, "/tmp/pf_daemon.sock", nullptr, 100, false, "127.0.0.1", 0, nullptr };
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-camera") == 0 && arg + 1 < argc)
+            options.camera = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-socket") == 0 && arg + 1 < argc)
+            options.socketPath = argv[++arg];
+        else if (strcmp(argv[arg], "-publish") == 0 && arg + 1 < argc)
+            options.busName = argv[++arg];
+        else if (strcmp(argv[arg], "-buffers") == 0 && arg + 1 < argc)
+            options.bufferCount = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-idle") == 0)
+            options.idle = true;
+        else if (strcmp(argv[arg], "-metrics") == 0 && arg + 1 < argc)
+        {
+            // [ADDRESS:]PORT
+            char *value = argv[++arg];
+            char *colon = strrchr(value, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                options.metricsAddress = value;
+                value = colon + 1;
+            }
+            options.metricsPort = atoi(value);
+        }
+        else if (strcmp(argv[arg], "-metricsfile") == 0 && arg + 1 < argc)
+            options.metricsFile = argv[++arg];
+        else
+        {
+            cerr << "Unknown option: " << argv[arg] << endl;
+            return -1;
+        }
+    }
+
+    // The signal handler only sets a flag and wakes the control thread through this pipe
+    if (pipe(g_wakePipe) != 0)
+        return -1;
+    fcntl(g_wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(g_wakePipe[1], F_SETFL, O_NONBLOCK);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = OnSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Discover the cameras and take the requested one, there is nobody to ask
+    pfResult = pfDiscover.DiscoverCameras();
+    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND || options.camera < 1 || options.camera > pfDiscover.GetCameraCount())
+    {
+        cerr << "Camera " << options.camera << " not found" << endl;
+        return -1;
+    }
+    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo, options.camera - 1);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cerr << "Error: " << pfResult.GetDescription() << endl;
+        return -1;
+    }
+
+    cerr << "Connecting camera " << pfCameraInfo->GetModelName() << " ..." << endl;
+    pfResult = pfCamera.Connect(*pfCameraInfo);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cerr << "Error: " << pfResult.GetDescription() << endl;
+        return -1;
+    }
+
+    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
+#if !defined(NDEBUG)
+    pfCamera.SetHeartbeatRate(10000);
+#endif
+
+    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
+        pfStream = new PFStreamGEV(false, true, true, true);
+    else
+        pfStream = new PFStreamU3V();
+    pfStream->SetBufferCount(options.bufferCount);
+    pfResult = pfCamera.AddStream(pfStream);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        cerr << "Error: " << pfResult.GetDescription() << endl;
+        pfCamera.Disconnect();
+        delete pfStream;
+        return -1;
+    }
+
+    // Frame bus slots are sized for the largest image the camera can deliver
+    SharedFrameBusPublisher publisher;
+    if (options.busName)
+    {
+        PFFeatureParameters widthParams, heightParams;
+        pfCamera.GetFeatureParams("Width", &widthParams);
+        pfCamera.GetFeatureParams("Height", &heightParams);
+        // Up to 16 bit per pixel
+        uint64_t maxFrameBytes = (uint64_t)widthParams.Max * (uint64_t)heightParams.Max * 2;
+        if (!publisher.Create(options.busName, 8, maxFrameBytes))
+            cerr << "Error: could not create frame bus " << options.busName << endl;
+    }
+
+    AcquisitionDaemon daemon(pfCamera, pfStream, publisher.IsOpen() ? &publisher : nullptr);
+    ControlServer server;
+    if (!server.Open(options.socketPath))
+    {
+        cerr << "Error: could not listen on " << options.socketPath << endl;
+        pfCamera.Disconnect();
+        delete pfStream;
+        return -1;
+    }
+
+    MetricsExporter metricsExporter(daemon.GetMetrics());
+    if (options.metricsPort > 0)
+    {
+        if (metricsExporter.ListenHttp(options.metricsAddress, options.metricsPort))
+            cerr << "Metrics on http://" << options.metricsAddress << ":" << options.metricsPort << "/metrics" << endl;
+        else
+            cerr << "Error: could not serve metrics on port " << options.metricsPort << endl;
+    }
+    if (options.metricsFile)
+        metricsExporter.SetTextFile(options.metricsFile);
+    if (options.metricsPort > 0 || options.metricsFile)
+        metricsExporter.Start();
+
+    if (!options.idle && !daemon.StartGrab())
+        cerr << "Error: could not start grabbing" << endl;
+
+    cerr << "Listening on " << options.socketPath << endl;
+    thread controlThread([&server, &daemon]() { server.Run(daemon); });
+
+    daemon.Run();
+
+    // The control thread sends the last replies and ends
+    server.Stop();
+    controlThread.join();
+    server.Close();
+    metricsExporter.Stop();
+
+    pfCamera.Disconnect();
+    delete pfStream;
+    publisher.Close();
+    close(g_wakePipe[0]);
+    close(g_wakePipe[1]);
+    cerr << "Daemon stopped" << endl;
+    return 0;
+}
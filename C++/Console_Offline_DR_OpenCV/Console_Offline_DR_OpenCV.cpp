@@ -1,173 +1,288 @@
-/*
-******************************************************************************
-* @attention
-*
-*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
-*
-* Redistribution and use in source and binary forms, with or without modification,
-* are permitted provided that the following conditions are met:
-* 1. Redistributions of source code must retain the above copyright notice,
-* this list of conditions and the following disclaimer.
-* 2. Redistributions in binary form must reproduce the above copyright notice,
-* this list of conditions and the following disclaimer in the documentation
-* and/or other materials provided with the distribution.
-* 3. Neither the name of Photonfocus nor the names of its contributors
-* may be used to endorse or promote products derived from this software
-* without specific prior written permission.
-*
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
-* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
-* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
-* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
-* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
-* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*
-******************************************************************************
-*/
-
-/**
-//  \file Console_Offline_DR.cpp
-//
-//  \brief
-//  This example shows the generic process to demodulate an image captured previously with double rate camera and saved to ".BMP" file.
-//  See related sample PFCameraLib_ConfigAndGrabConsole_Online_DR to verify how capture double rate images.
-//
-//  Description: This sample uses OpenCV library to load images from file with BMP format. A few assumptions of the input images is done:
-//
-//  1. The images are saved in BMP format.
-//  2. The images captured are in monochrome format. PixelMono8 is the format used.
-//  3. "Window_W" is 2048 (this value cannot be obtained directly from the input image but can be read in the camera).
-//
-// After the image is loaded from disk can be demodulated with method PFImage::DemodulateDR(). Finally the demodulated image is saved to ".BMP" file.
-//
-*/
-
-#include <stdio.h>
-#include <iostream>
-
-#include "PFCamera.h"
-#include "PFStreamGEV.h"
-#include "PFStreamU3V.h"
-#include "PFDiscovery.h"
-#include "PFImage.h"
-#include "pfcPixelTypes.h"
-
-// Headers used for OpenCV libraries
-#include <opencv/cv.h>
-#include <opencv2/highgui/highgui.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-
-
-#ifdef WIN32
-#include <Windows.h>
-#include <conio.h>
-#include <direct.h>
-#else
-#include <unistd.h>
-#include <sys/select.h>
-#include <sys/ioctl.h>
-#include <termios.h>
-#include <stropts.h>
-
-#define _getcwd getcwd
-#define MAX_PATH  4096
-
-int _kbhit() {
-    static const int STDIN = 0;
-    static bool initialized = false;
-
-    if (!initialized) {
-        // Use termios to turn off line buffering
-        struct termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
-    }
-
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
-}
-
-char _getch(void)
-{
-    char buf = 0;
-    struct termios old = { 0 };
-    fflush(stdout);
-    if (tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if (tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if (read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if (tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    return buf;
-}
-#endif
-
-int KeyPressed(char key)
-{
-    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
-}
-
-
-using namespace cv;
-using namespace std;
-using namespace PFCameraDLL;
-
-int main()
-{
-    char filename[512];
-    char input_path[512];
-    
-    // Load image from disk
-    for (int i = 0; i < 5; i++)
-    {
-        sprintf(input_path, "image_%d_mod.bmp",i);
-        // Use imread to load BMP monochrome image
-        Mat img = imread(input_path, IMREAD_GRAYSCALE);
-
-        if (img.empty())
-        {
-            std::cout << "Could not read the image: " << input_path << std::endl;
-            return 1;
-        }
-
-        size_t sizeInBytes = img.total() * img.elemSize();
-
-        PFImage pfImage(PixelMono8, img.cols, img.rows, 0, 0, 0, 0, (uint64_t)sizeInBytes, img.data);
-        PFImage pfImageDest;
-
-        // Allocate image for demodulation, sizeX correspond to Window_W feature value that you will find in double rate cameras, this value corresponds to the width of the image demodulated 
-        uint32_t Window_W = 2048;
-        pfImageDest.ReserveImage(PixelMono8, Window_W, (uint32_t)img.rows);
-
-        // Cameras with support for color formats decode the image different, this is why isColor may be true even using mono formats
-        PFResult pfResult = pfImage.DemodulateDR(pfImageDest, true);
-
-        sprintf(filename, "image_%d_demod.bmp", i);
-        // Save demodulated image to a file
-        pfImageDest.SaveToFile(filename, pfImageFileType::BmpFileType);
-        pfImageDest.ReleaseImage();
-    }
-    
-    std::cout << "\r\nPress any key to finish...\r\n" << endl;
-    _getch();
-    return 0;
-}
-
-
-
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file Console_Offline_DR.cpp
+//
+//  \brief
+//  This example shows the generic process to demodulate an image captured previously with double rate camera and saved to ".BMP" file.
+//  See related sample PFCameraLib_ConfigAndGrabConsole_Online_DR to verify how capture double rate images.
+//
+//  Description: This sample uses OpenCV library to load images from file with BMP format. A few assumptions of the input images is done:
+//
+//  1. The images are saved in BMP format.
+//  2. The images captured are in monochrome format. PixelMono8 is the format used.
+//  3. "Window_W" is 2048 (this value cannot be obtained directly from the input image but can be read in the camera).
+//
+// After the image is loaded from disk can be demodulated with method PFImage::DemodulateDR(). Finally the demodulated image is saved to ".BMP" file.
+//
+// Given a DR container (DrContainer.h) on the command line, the frames are read from it instead. The container
+// header holds "Window_W", the binning and whether the camera is a color model, so none of the assumptions above
+// are needed; the lines of every frame come from its index, and "-frame k" demodulates only frame k:
+//
+//      PFCameraLib_Console_Offline_DR_OpenCV capture.drc
+//      PFCameraLib_Console_Offline_DR_OpenCV -frame 10 capture.drc
+//
+// A file without the container header is taken as a plain DR1 image: "Window_W" is read from the modulated data
+// with pfDoubleRate_GetDeModulatedWidth(), the height follows from the file size and isColor is assumed as above.
+//
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFStreamU3V.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+#include "pfcPixelTypes.h"
+#include "pfDoubleRate.h"
+
+#include "DrContainer.h"
+
+// Headers used for OpenCV libraries
+#include <opencv/cv.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <stropts.h>
+
+#define _getcwd getcwd
+#define MAX_PATH  4096
+
+int _kbhit() {
+    static const int STDIN = 0;
+    static bool initialized = false;
+
+    if (!initialized) {
+        // Use termios to turn off line buffering
+        struct termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+}
+
+char _getch(void)
+{
+    char buf = 0;
+    struct termios old = { 0 };
+    fflush(stdout);
+    if (tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    if (read(0, &buf, 1) < 0)
+        perror("read()");
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if (tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    return buf;
+}
+#endif
+
+int KeyPressed(char key)
+{
+    return (_kbhit() != 0) && (tolower(_getch()) == tolower(key));
+}
+
+
+using namespace cv;
+using namespace std;
+using namespace PFCameraDLL;
+
+// Demodulates one modulated frame and saves it as image_<index>_demod.bmp
+bool DemodulateFrame(uint8_t *modulated, uint32_t modulatedStride, uint32_t windowWidth, uint32_t lines, bool isColor, uint32_t index)
+{
+    PFImage pfImage(PixelMono8, modulatedStride, lines, 0, 0, 0, 0, (uint64_t)modulatedStride * lines, modulated);
+    PFImage pfImageDest;
+    pfImageDest.ReserveImage(PixelMono8, windowWidth, lines);
+
+    PFResult pfResult = pfImage.DemodulateDR(pfImageDest, isColor);
+    if (pfResult == PFSDK_NOERROR)
+    {
+        char filename[512];
+        sprintf(filename, "image_%u_demod.bmp", index);
+        pfImageDest.SaveToFile(filename, pfImageFileType::BmpFileType);
+    }
+    else
+        std::cout << "Could not demodulate frame " << index << ": " << pfResult.GetDescription() << std::endl;
+    pfImageDest.ReleaseImage();
+    return pfResult == PFSDK_NOERROR;
+}
+
+// Demodulates a plain DR1 file, the modulated data of one frame without a header
+int DemodulateDr1(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        std::cout << "Could not open " << path << std::endl;
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    std::vector<uint8_t> modulated(size > 0 ? (size_t)size : 0);
+    size_t read = fread(modulated.data(), 1, modulated.size(), file);
+    fclose(file);
+
+    // Window_W is encoded in the modulated data
+    int demodWidth = 0, modWidth = 0;
+    if (read != modulated.size() || modulated.empty() ||
+        pfDoubleRate_GetDeModulatedWidth(modulated.data(), &demodWidth) != PFDOUBLERATE_SUCCESS ||
+        pfDoubleRate_GetModulatedWidth(demodWidth, &modWidth) != PFDOUBLERATE_SUCCESS ||
+        demodWidth <= 0 || modWidth <= 0 || modulated.size() < (size_t)modWidth)
+    {
+        std::cout << "No DR container and no DR1 image: " << path << std::endl;
+        return 1;
+    }
+    uint32_t lines = (uint32_t)(modulated.size() / modWidth);
+    std::cout << "DR1 image: Window_W " << demodWidth << ", modulated width " << modWidth << ", " << lines << " lines" << std::endl;
+    // As for the BMP images, whether the camera is a color model is unknown
+    return DemodulateFrame(modulated.data(), (uint32_t)modWidth, (uint32_t)demodWidth, lines, true, 0) ? 0 : 1;
+}
+
+// Demodulates the frames of a DR container with the geometry of its header, frame -1 for all frames
+int DemodulateContainer(const char *path, int frame)
+{
+    DrContainerReader container;
+    if (!container.Open(path))
+    {
+        if (container.IsHeaderless())
+            return DemodulateDr1(path);
+        std::cout << "Could not read the DR container " << path << ": " << container.GetError() << std::endl;
+        return 1;
+    }
+    container.PrintReport(stdout);
+    const DrContainerHeader &header = container.GetHeader();
+    if (frame >= (int)container.GetFrameCount())
+    {
+        std::cout << "Frame " << frame << " requested, the container has " << container.GetFrameCount() << " frames" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> modulated(container.GetMaxFrameBytes());
+    uint32_t first = (frame < 0) ? 0 : (uint32_t)frame;
+    uint32_t last = (frame < 0) ? container.GetFrameCount() : first + 1;
+    for (uint32_t i = first; i < last; i++)
+    {
+        // One seek to the frame, found in the index
+        if (!container.ReadFrame(i, modulated.data()))
+        {
+            std::cout << "Could not read frame " << i << std::endl;
+            return 1;
+        }
+        DemodulateFrame(modulated.data(), header.modulatedStride, header.windowWidth, container.GetFrame(i).lines,
+            header.IsColorCamera(), i);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char filename[512];
+    char input_path[512];
+
+    const char *inputPath = nullptr;
+    int frame = -1;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "-frame") == 0 && arg + 1 < argc)
+            frame = atoi(argv[++arg]);
+        else
+            inputPath = argv[arg];
+    }
+    if (inputPath != nullptr)
+        return DemodulateContainer(inputPath, frame);
+    
+    // Load image from disk
+    for (int i = 0; i < 5; i++)
+    {
+        sprintf(input_path, "image_%d_mod.bmp",i);
+        // Use imread to load BMP monochrome image
+        Mat img = imread(input_path, IMREAD_GRAYSCALE);
+
+        if (img.empty())
+        {
+            std::cout << "Could not read the image: " << input_path << std::endl;
+            return 1;
+        }
+
+        size_t sizeInBytes = img.total() * img.elemSize();
+
+        PFImage pfImage(PixelMono8, img.cols, img.rows, 0, 0, 0, 0, (uint64_t)sizeInBytes, img.data);
+        PFImage pfImageDest;
+
+        // Allocate image for demodulation, sizeX correspond to Window_W feature value that you will find in double rate cameras, this value corresponds to the width of the image demodulated 
+        uint32_t Window_W = 2048;
+        pfImageDest.ReserveImage(PixelMono8, Window_W, (uint32_t)img.rows);
+
+        // Cameras with support for color formats decode the image different, this is why isColor may be true even using mono formats
+        PFResult pfResult = pfImage.DemodulateDR(pfImageDest, true);
+
+        sprintf(filename, "image_%d_demod.bmp", i);
+        // Save demodulated image to a file
+        pfImageDest.SaveToFile(filename, pfImageFileType::BmpFileType);
+        pfImageDest.ReleaseImage();
+    }
+    
+    std::cout << "\r\nPress any key to finish...\r\n" << endl;
+    _getch();
+    return 0;
+}
+
+
+
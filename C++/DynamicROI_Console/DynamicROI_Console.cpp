@@ -0,0 +1,528 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file DynamicROI_Console.cpp
+//
+//  \brief
+//  This example is a command line application that follows a bright target with the sensor
+//  window (ROI) to grab it at several times the full frame rate.
+//
+//  Description: the camera starts grabbing full frames. In every frame the pixels brighter than
+//  a threshold are the target; its bounding box goes to a RoiController, which shrinks the
+//  ROI (Width, Height, OffsetX, OffsetY) around it and moves it along when the target moves. When
+//  the target is lost the ROI goes back to full frame. See RoiController.h for the size classes
+//  and the hysteresis that keep the number of reconfigurations low.
+//
+//  Moving the ROI only writes the offsets while grabbing; a size change is a fast Freeze(),
+//  write and Grab() sequence. The target is searched in the stream buffer itself, with the width,
+//  height and offsets of that frame: after a change the frames already in the ring still have the
+//  previous ROI. The buffer is released right after the search, before any reconfiguration.
+//
+//  The current ROI and frame rate are shown once per second. When the grab is stopped with the
+//  'space' key, the frame rate of every ROI size is printed against the full frame rate together
+//  with the number and duration of the reconfigurations.
+//
+//  The target search is a kernel of PixelKernels.h: it is compiled for every pixel format and
+//  selected once per frame, so Mono10p, Mono12p and Mono16 frames are searched without unpacking
+//  the whole frame first and without a format check per pixel.
+//
+//  Options:
+//      -pixelformat F  Mono8 (default), Mono10p, Mono12p or Mono16
+//      -threshold N    Gray value of the target pixels in the units of the pixel format
+//                      (default half of the range, e.g. 128 for Mono8, 2048 for Mono12p)
+//      -margin F       Free space around the target, relative to its size (default 0.5)
+//
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "PFCamera.h"
+#include "PFStreamGEV.h"
+#include "PFStreamU3V.h"
+#include "PFDiscovery.h"
+#include "PFImage.h"
+
+#include "HostClock.h"
+#include "ImageView.h"
+#include "PixelKernels.h"
+#include "RoiController.h"
+
+
+#ifdef WIN32
+#include <Windows.h>
+#include <conio.h>
+#else
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <stropts.h>
+
+int _kbhit() {
+    static const int STDIN = 0;
+    static bool initialized = false;
+
+    if (! initialized) {
+        // Use termios to turn off line buffering
+        struct termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+}
+
+char _getch(void)
+{
+    char buf = 0;
+    struct termios old = {0};
+    fflush(stdout);
+    if(tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if(tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    if(read(0, &buf, 1) < 0)
+        perror("read()");
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if(tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    return buf;
+ }
+#endif
+
+int KeyPressed(char key)
+{
+    return (_kbhit() != 0) && (_getch() == key);
+}
+
+using namespace std;
+using namespace PFCameraDLL;
+
+// Options of the tracking, set from the command line
+struct TrackingOptions
+{
+    const char *pixelFormat; // Pixel format to grab
+    int threshold;      // Gray value of the target pixels, -1 for half of the range
+    double margin;      // Free space around the target, relative to its size
+};
+
+// Bounding box of the target pixels in ROI coordinates
+struct Target
+{
+    double centerX;
+    double centerY;
+    double width;
+    double height;
+};
+
+// Bounding box and centroid of the pixels >= threshold, on every second pixel of every second line.
+// Compiled for each pixel format, see DispatchPixelFormat() in PixelKernels.h.
+class TargetKernel
+{
+public:
+    explicit TargetKernel(int threshold) : m_threshold(threshold), m_found(false) {}
+
+    template <class Traits>
+    void Run(const ImageView &view)
+    {
+        typedef typename Traits::Sample Sample;
+        const Sample threshold = (Sample)(m_threshold >= 0 ? m_threshold : 1 << (Traits::Bits - 1));
+        LineReader<Traits> reader(view);
+        uint32_t width = view.GetWidth(), height = view.GetHeight();
+        uint32_t minX = width, minY = height, maxX = 0, maxY = 0;
+        uint64_t sumX = 0, sumY = 0, count = 0;
+
+        for (uint32_t y = 0; y < height; y += 2)
+        {
+            const Sample *line = reader(y);
+            for (uint32_t x = 0; x < width; x += 2)
+            {
+                if (line[x] < threshold)
+                    continue;
+                if (x < minX) minX = x;
+                if (x > maxX) maxX = x;
+                if (y < minY) minY = y;
+                if (y > maxY) maxY = y;
+                sumX += x;
+                sumY += y;
+                count++;
+            }
+        }
+        m_found = count >= 4;
+        if (!m_found)
+            return;
+
+        m_target.centerX = (double)sumX / count;
+        m_target.centerY = (double)sumY / count;
+        m_target.width = (double)(maxX - minX + 2);
+        m_target.height = (double)(maxY - minY + 2);
+    }
+
+    bool IsFound() const { return m_found; }
+    const Target &GetTarget() const { return m_target; }
+
+private:
+    int m_threshold;
+    bool m_found;
+    Target m_target;
+};
+
+int Configure(PFCamera &pfCamera, const char *pixelFormat, RoiLimits &limits, FramePixelFormat &format);
+int TrackAndGrab(PFStream *pfStream, RoiController &roiController, FramePixelFormat format, const TrackingOptions &options);
+
+int main(int argc, char *argv[])
+{
+    PFDiscovery pfDiscover;
+    PFCamera pfCamera;
+    PFCameraInfo *pfCameraInfo; 
+    PFStream *pfStream;
+    PFResult pfResult;
+    uint8_t i,camera;
+    uint16_t selected;
+    TrackingOptions options = { "Mono8", -1, 0.5 };
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        // Pixel format to grab
+        if (strcmp(argv[arg], "-pixelformat") == 0 && arg + 1 < argc)
+            options.pixelFormat = argv[++arg];
+        // Gray value of the target pixels
+        else if (strcmp(argv[arg], "-threshold") == 0 && arg + 1 < argc)
+            options.threshold = atoi(argv[++arg]);
+        // Free space around the target, relative to its size
+        else if (strcmp(argv[arg], "-margin") == 0 && arg + 1 < argc)
+            options.margin = atof(argv[++arg]);
+    }
+
+    // Discover the cameras available in the computer or network
+    pfResult = pfDiscover.DiscoverCameras();
+    if (pfResult == PFSDK_ERROR_DISCOVERY_NO_CAMERAS_FOUND)
+    {
+        std::cout << "No cameras found." << endl;
+        _getch();
+        return -1;
+    }
+
+    // For each discovered camera, print the model name, manufacturer, version, etc
+    std::cout << "\nCameras found: \n" << endl;
+    for (i = 0; i < pfDiscover.GetCameraCount(); i++)
+    {
+        pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,i);
+        if (pfResult == PFSDK_NOERROR)
+        {
+            std::cout << i + 1 << "- " << pfCameraInfo->GetModelName() << " Manufacturer info: "  << pfCameraInfo->GetManufacturerInfo() <<  endl;
+            pfCameraInfo->printCameraInfo();
+        }
+    }
+    
+    // Select one of the following cameras to connect
+    if (i > 0)
+    {
+        std::cout << "Select a camera from the list: ";
+        cin >> selected;
+        camera = static_cast<uint8_t>(selected)-1;
+    }
+    else
+    {
+        cout << "No cameras found." << endl;
+        _getch();
+        return 0;
+    }
+
+    // Get the information of the selected camera and keep it in pfCameraInfo
+    pfResult = pfDiscover.GetCameraInfo(pfCameraInfo,camera);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+
+    // Connect the camera using pfCameraInfo
+    std::cout << "Connecting camera " << selected << " ..." << endl;
+    pfResult = pfCamera.Connect(*pfCameraInfo);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }           
+
+    // While debugging it is advisable to configure a HeartbeatRate of at least 10 seconds.
+#if !defined(NDEBUG)
+    pfResult = pfCamera.SetHeartbeatRate(10000);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+#endif
+    
+    // Configure the camera and read the ROI limits of the sensor
+    RoiLimits limits;
+    FramePixelFormat format = FormatMono8;
+    Configure(pfCamera, options.pixelFormat, limits, format);
+
+    // The ROI controller writes the features; a size change stops and restarts the stream
+    RoiController roiController(limits, options.margin);
+    roiController.SetCallbacks(
+        [&pfCamera](const char *feature, int64_t value) { return pfCamera.SetFeatureInt(feature, value) == PFSDK_NOERROR; },
+        [&pfCamera](const char *feature, int64_t &value) { return pfCamera.GetFeatureInt(feature, value) == PFSDK_NOERROR; },
+        [&pfCamera]() { return pfCamera.Freeze() == PFSDK_NOERROR; },
+        [&pfCamera]() { return pfCamera.Grab() == PFSDK_NOERROR; });
+    if (!roiController.Reset())
+        std::cout << "Error: full frame ROI could not be set" << endl;
+
+    // In order to grab images it is necessary to prepare a proper stream.
+    if (pfCameraInfo->GetType() == CAMTYPE_GEV)
+        pfStream = new PFStreamGEV(false, false, true, true);
+    else
+        pfStream = new PFStreamU3V();
+    
+    // Default Ring buffer Count
+    pfStream->SetBufferCount(100);
+    // It is mandatory to add this stream to the camera before grabbing images.
+    pfResult = pfCamera.AddStream(pfStream);
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        _getch();
+        return -1;
+    }
+
+    // Start grabbing images
+    pfResult = pfCamera.Grab();
+
+    if (pfResult != PFSDK_NOERROR)
+    {
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+        // Stop grabbing
+        pfCamera.Freeze();
+        // Disconnect the Camera
+        pfCamera.Disconnect();
+        // Delete stream pointer
+        if (pfStream != nullptr)
+            delete pfStream;
+
+        std::cout << "\r\nPress any key to finish...\r\n" << endl;
+        _getch();
+        return -2;
+    }
+    
+    TrackAndGrab(pfStream, roiController, format, options);
+
+    // Stop grabbing
+    pfCamera.Freeze();
+    // Leave the camera with the full sensor
+    roiController.Reset();
+    // Disconnect the camera
+    pfCamera.Disconnect();
+
+    // Finally the stream pointer is deleted
+    if (pfStream != nullptr)
+        delete pfStream;
+    
+    std::cout << "\r\nPress any key to finish...\r\n" << endl;
+    _getch();
+    return 0;
+}
+
+int Configure(PFCamera &pfCamera, const char *pixelFormat, RoiLimits &limits, FramePixelFormat &format)
+{
+    PFFeatureParameters pfFeatureParams;
+    PFResult pfResult;
+    double double_value;
+    char enum_str[64];
+
+    // Set pixel format
+    pfResult = pfCamera.SetFeatureEnum("PixelFormat", pixelFormat);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back pixel format
+    pfResult = pfCamera.GetFeatureEnum("PixelFormat", enum_str);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+    {
+        std::cout << "PixelFormat: " << enum_str << endl;
+        format = ParsePixelFormat(enum_str);
+    }
+
+    // Offsets to 0 first, the maximum of Width and Height depends on them
+    pfCamera.SetFeatureInt("OffsetX", 0);
+    pfCamera.SetFeatureInt("OffsetY", 0);
+
+    // Sensor size and increments of the ROI
+    memset(&limits, 0, sizeof(limits));
+    pfResult = pfCamera.GetFeatureParams("Width", &pfFeatureParams);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    limits.sensorWidth = (uint32_t)pfFeatureParams.Max;
+    limits.minWidth = (uint32_t)pfFeatureParams.Min;
+    limits.widthInc = (uint32_t)pfFeatureParams.Inc;
+    pfResult = pfCamera.GetFeatureParams("Height", &pfFeatureParams);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    limits.sensorHeight = (uint32_t)pfFeatureParams.Max;
+    limits.minHeight = (uint32_t)pfFeatureParams.Min;
+    limits.heightInc = (uint32_t)pfFeatureParams.Inc;
+    if (pfCamera.GetFeatureParams("OffsetX", &pfFeatureParams) == PFSDK_NOERROR)
+        limits.offsetXInc = (uint32_t)pfFeatureParams.Inc;
+    if (pfCamera.GetFeatureParams("OffsetY", &pfFeatureParams) == PFSDK_NOERROR)
+        limits.offsetYInc = (uint32_t)pfFeatureParams.Inc;
+    std::cout << "Sensor: " << limits.sensorWidth << "x" << limits.sensorHeight << " Width increment: " << limits.widthInc
+        << " Height increment: " << limits.heightInc << endl;
+
+    // Short exposure, so the readout and not the exposure limits the frame rate of small ROIs
+    double_value = 1000.0;
+    // Check if the value is inside the limits
+    pfResult = pfCamera.GetFeatureParams("ExposureTime", &pfFeatureParams);
+    if (double_value > pfFeatureParams.FloatMax)
+        double_value = pfFeatureParams.FloatMax;
+    else if (double_value < pfFeatureParams.FloatMin)
+        double_value = pfFeatureParams.FloatMin;
+    // Set the corresponding value
+    pfResult = pfCamera.SetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    // Read back Exposure Time value
+    pfResult = pfCamera.GetFeatureFloat("ExposureTime", double_value);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "ExposureTime: " << double_value << endl;
+
+    // Set the SCPS PacketSize for a proper streaming
+    int packetSize = 8164;
+    pfResult = pfCamera.SetFeatureInt("GevSCPSPacketSize", packetSize);
+    if (pfResult != PFSDK_NOERROR)
+        std::cout << "Error: " << pfResult.GetDescription() << endl;
+    else
+        std::cout << "GevSCPSPacketSize: " << packetSize << endl;
+
+    return 0;
+}
+
+int TrackAndGrab(PFStream *pfStream, RoiController &roiController, FramePixelFormat format, const TrackingOptions &options)
+{
+    PFResult pfResult;
+    PFBuffer *pfBuffer;
+    uint64_t lastStatusNs = HostNowNs();
+    uint64_t lastKeyNs = 0;
+
+    // Grab images
+    std::cout << "\r\nPress SPACE to stop grabbing...\r\n" << endl;
+    for (;;)
+    {
+        // The console is polled ten times per second, not at the frame rate of a small ROI
+        uint64_t loopNs = HostNowNs();
+        if (loopNs - lastKeyNs >= 100000000ull)
+        {
+            if (KeyPressed(' '))
+                break;
+            lastKeyNs = loopNs;
+        }
+
+        // Get from camera image buffer
+        pfResult = pfStream->GetNextBuffer(pfBuffer);
+        if (pfResult != PFSDK_NOERROR)
+        {
+            std::cout << "\nError: " << pfResult.GetDescription() << "\r\n";
+            // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
+            if (pfBuffer != nullptr)
+                pfStream->ReleaseBuffer(pfBuffer);
+            continue;
+        }
+        uint64_t now = HostNowNs();
+
+        // Geometry of this frame, not of the ROI written last
+        RoiRect roi;
+        {
+            PFImage pfImage;
+            pfBuffer->GetImage(pfImage);
+            roi.offsetX = pfImage.GetOffsetX();
+            roi.offsetY = pfImage.GetOffsetY();
+            roi.width = pfImage.GetWidth();
+            roi.height = pfImage.GetHeight();
+        }
+        roiController.RecordFrame(now, roi);
+
+        // Search the stream buffer in place, then give it back before the ROI may change
+        TargetKernel targetKernel(options.threshold);
+        bool found = DispatchPixelFormat(ImageView(pfBuffer->GetRawData(), roi.width, roi.height, format), targetKernel) &&
+            targetKernel.IsFound();
+        // Note: Release the image buffer. It's mandatory to call ReleaseBuffer() after each iteration.
+        pfStream->ReleaseBuffer(pfBuffer);
+
+        // Follow the target in sensor coordinates
+        bool changed;
+        if (found)
+        {
+            const Target &target = targetKernel.GetTarget();
+            changed = roiController.Track(roi.offsetX + target.centerX, roi.offsetY + target.centerY,
+                target.width, target.height);
+        }
+        else
+        {
+            changed = roiController.Lost();
+        }
+
+        // Status once per second and on every size change
+        const RoiRect &current = roiController.GetRoi();
+        bool resized = changed && (current.width != roi.width || current.height != roi.height);
+        if (resized || now - lastStatusNs >= 1000000000ull)
+        {
+            printf("ROI %ux%u+%u+%u %.1f fps   \r%s", current.width, current.height, current.offsetX, current.offsetY,
+                roiController.GetFps(), resized ? "\n" : "");
+            fflush(stdout);
+            lastStatusNs = now;
+        }
+    }
+
+    std::cout << endl << "\r\nEnd of grabbing process!" << endl << endl;
+    roiController.PrintReport(stdout);
+
+    return 0;
+}
@@ -0,0 +1,460 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file GrabLoop_Benchmark.cpp
+//
+//  \brief
+//  Headroom of a host for an acquisition: the grab loop of the examples (GetNextBuffer(),
+//  processing, optional recording and display, ReleaseBuffer()) against a simulated stream, swept
+//  over frame size, ring buffer count and consumer cost.
+//
+//  Description: SimulatedStream.h produces frames at a fixed rate into a ring of buffers and
+//  drops them when no buffer is free, like the stream of a camera. The loop per frame:
+//
+//  1. GetNextBuffer(), the frame counter goes through a FrameSequenceTracker
+//  2. processing: FrameStatisticsKernel over the frame (PixelKernels.h) plus -cost microseconds of
+//     busy work standing for the application
+//  3. -record: the frame is copied into a ring of recorder buffers (an in-memory recorder)
+//  4. -display: at most 30 times per second the frame is reduced to an 8 bit preview of at most
+//     640 pixels width (without a window, the conversion is what costs)
+//  5. ReleaseBuffer()
+//
+//  For every frame size, buffer count and cost the frame rate is searched (bisection between a
+//  rate that is sustained and one that is not) for the highest rate at which the loop keeps up:
+//  no frame lost and at most one frame waiting at the end, so a growing backlog that has not
+//  overflowed the ring yet does not count as sustained. Reported per point:
+//
+//      max fps     highest sustained rate (the headroom of the host for this configuration)
+//      onset fps   lowest measured rate with loss or backlog, and its loss
+//      CPU/frame   CPU time of the grab loop thread, and of the whole process (including the
+//                  producer, which copies every frame like a DMA transfer) per received frame
+//      p99 ms      latency from production to ReleaseBuffer() at the max fps
+//
+//      GrabLoop_Benchmark -sizes 2048x1536,4096x3072 -buffers 8,64 -cost 0,2000 -record -display
+//
+//  -duration sets the seconds per measured rate (at least 20 frames), -csv writes the table to a
+//  file. The producer is a thread of its own: with a single core it competes with the loop, and
+//  rates it cannot produce are marked as overrun of the simulation.
+//
+*/
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "CpuTime.h"
+#include "FrameBufferPool.h"
+#include "FrameSequenceTracker.h"
+#include "HostClock.h"
+#include "ImageView.h"
+#include "LatencyHistogram.h"
+#include "PixelFormats.h"
+#include "PixelKernels.h"
+#include "SimulatedStream.h"
+
+struct LoopOptions
+{
+    uint32_t width;
+    uint32_t height;
+    FramePixelFormat format;
+    double costUs;
+    bool record;
+    bool display;
+};
+
+struct TrialResult
+{
+    double offeredFps;
+    uint64_t received;
+    uint64_t lost;
+    uint64_t overruns;
+    size_t backlog;
+    double loopCpuUsPerFrame;
+    double processCpuUsPerFrame;
+    double p99Ms;
+
+    bool IsSustained() const
+    {
+        // A backlog that grows without overflowing the ring yet is not sustained either
+        return lost == 0 && overruns == 0 && backlog <= 1;
+    }
+};
+
+// Work of the loop besides the stream calls, with the buffers it needs allocated up front
+class FrameStages
+{
+public:
+    static const int RecorderFrames = 8;
+    static const uint32_t PreviewWidth = 640;
+
+    bool Prepare(const LoopOptions &options, size_t frameBytes)
+    {
+        m_options = options;
+        m_recordIndex = 0;
+        m_lastDisplayNs = 0;
+        m_step = std::max<uint32_t>(1, (options.width + PreviewWidth - 1) / PreviewWidth);
+        m_preview.assign((size_t)(options.width / m_step + 1) * (options.height / m_step + 1), 0);
+        if (options.record && !m_recorder.Allocate(frameBytes, RecorderFrames, true, false))
+            return false;
+        return true;
+    }
+
+    void Run(const uint8_t *data)
+    {
+        ImageView view((uint8_t *)data, m_options.width, m_options.height, m_options.format);
+        DispatchPixelFormat(view, m_statistics);
+
+        if (m_options.costUs > 0.0)
+        {
+            uint64_t end = HostNowNs() + (uint64_t)(m_options.costUs * 1000.0);
+            while (HostNowNs() < end)
+            {
+            }
+        }
+
+        if (m_options.record)
+        {
+            memcpy(m_recorder.GetFrame(m_recordIndex), data, view.GetSizeInBytes());
+            m_recordIndex = (m_recordIndex + 1) % RecorderFrames;
+        }
+
+        // A display refreshes at about 30 Hz, only then a preview is made
+        uint64_t now = HostNowNs();
+        if (m_options.display && now - m_lastDisplayNs >= 33000000)
+        {
+            m_lastDisplayNs = now;
+            bool wide = FindPixelFormat(m_options.format)->bitsPerPixel == 16;
+            int shift = std::max(0, m_statistics.GetBits() - 8);
+            size_t index = 0;
+            for (uint32_t y = 0; y < m_options.height; y += m_step)
+            {
+                if (wide)
+                {
+                    const uint16_t *line = view.LineAs<uint16_t>(y);
+                    for (uint32_t x = 0; x < m_options.width; x += m_step)
+                        m_preview[index++] = (uint8_t)(line[x] >> shift);
+                }
+                else
+                {
+                    // 8 bit and packed formats: the bytes are close enough for a preview
+                    const uint8_t *line = view.Line(y);
+                    for (uint32_t x = 0; x < m_options.width; x += m_step)
+                        m_preview[index++] = line[x];
+                }
+            }
+        }
+    }
+
+    // Keeps the results alive so the work is not optimized away
+    double GetChecksum() const
+    {
+        return m_statistics.GetMean(0) + m_preview[0];
+    }
+
+private:
+    LoopOptions m_options;
+    FrameStatisticsKernel m_statistics;
+    FrameBufferPool m_recorder;
+    int m_recordIndex;
+    uint64_t m_lastDisplayNs;
+    uint32_t m_step;
+    std::vector<uint8_t> m_preview;
+};
+
+// The grab loop at one offered rate for durationSeconds
+static TrialResult RunTrial(SimulatedStream &stream, FrameStages &stages, double fps, double durationSeconds, double &checksum)
+{
+    FrameSequenceTracker tracker;
+    LatencyHistogram latency;
+    TrialResult result;
+    result.offeredFps = fps;
+    result.received = 0;
+    result.lost = 0;
+
+    stream.Start(fps);
+    uint64_t startNs = HostNowNs();
+    uint64_t endNs = startNs + (uint64_t)(std::max(durationSeconds, 20.0 / fps) * 1e9);
+    uint64_t loopCpuStart = ThreadCpuNs();
+    uint64_t processCpuStart = ProcessCpuNs();
+    while (HostNowNs() < endNs)
+    {
+        SimulatedBuffer *buffer;
+        if (!stream.GetNextBuffer(buffer, 100))
+            continue;
+        uint64_t arrivalNs = HostNowNs();
+        result.lost += tracker.Update(buffer->GetFrameCounter(), arrivalNs);
+        stages.Run(buffer->GetRawData());
+        uint64_t producedNs = buffer->GetTimestamp();
+        stream.ReleaseBuffer(buffer);
+        latency.Record(HostNowNs() - producedNs);
+        result.received++;
+    }
+    uint64_t loopCpu = ThreadCpuNs() - loopCpuStart;
+    uint64_t processCpu = ProcessCpuNs() - processCpuStart;
+    result.backlog = stream.GetQueued();
+    stream.Stop();
+    // Frames produced but not taken yet go back to the ring for the next trial
+    SimulatedBuffer *buffer;
+    while (stream.GetNextBuffer(buffer, 0))
+        stream.ReleaseBuffer(buffer);
+
+    result.overruns = stream.GetOverruns();
+    // Drops at the end of the trial are not seen by the tracker yet
+    result.lost = std::max<uint64_t>(result.lost, stream.GetDropped());
+    result.loopCpuUsPerFrame = result.received ? loopCpu / 1000.0 / result.received : 0.0;
+    result.processCpuUsPerFrame = result.received ? processCpu / 1000.0 / result.received : 0.0;
+    result.p99Ms = latency.GetValueAtPercentile(99.0) / 1e6;
+    checksum += stages.GetChecksum();
+    return result;
+}
+
+static bool ParseSizes(const char *text, std::vector<std::pair<uint32_t, uint32_t> > &sizes)
+{
+    sizes.clear();
+    while (*text != '\0')
+    {
+        unsigned int width, height;
+        int used = 0;
+        if (sscanf(text, "%ux%u%n", &width, &height, &used) != 2 || width == 0 || height == 0)
+            return false;
+        sizes.push_back(std::make_pair(width, height));
+        text += used;
+        if (*text == ',')
+            text++;
+    }
+    return !sizes.empty();
+}
+
+static bool ParseNumbers(const char *text, std::vector<double> &values)
+{
+    values.clear();
+    while (*text != '\0')
+    {
+        char *end;
+        double value = strtod(text, &end);
+        if (end == text || value < 0.0)
+            return false;
+        values.push_back(value);
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::pair<uint32_t, uint32_t> > sizes;
+    std::vector<double> bufferCounts, costs;
+    ParseSizes("2048x1536,4096x3072", sizes);
+    ParseNumbers("8,64", bufferCounts);
+    ParseNumbers("0,2000", costs);
+    LoopOptions options;
+    options.format = FormatMono8;
+    options.record = false;
+    options.display = false;
+    double durationSeconds = 1.0;
+    double maxFps = 20000.0;
+    const char *csvFile = nullptr;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        bool valid = true;
+        if (strcmp(argv[arg], "-sizes") == 0 && arg + 1 < argc)
+            valid = ParseSizes(argv[++arg], sizes);
+        else if (strcmp(argv[arg], "-buffers") == 0 && arg + 1 < argc)
+            valid = ParseNumbers(argv[++arg], bufferCounts);
+        else if (strcmp(argv[arg], "-cost") == 0 && arg + 1 < argc)
+            valid = ParseNumbers(argv[++arg], costs);
+        else if (strcmp(argv[arg], "-pixelformat") == 0 && arg + 1 < argc)
+        {
+            options.format = ParsePixelFormat(argv[++arg]);
+            valid = options.format != FormatUnknown;
+        }
+        else if (strcmp(argv[arg], "-duration") == 0 && arg + 1 < argc)
+            durationSeconds = std::max(0.1, atof(argv[++arg]));
+        else if (strcmp(argv[arg], "-max-fps") == 0 && arg + 1 < argc)
+            maxFps = std::max(1.0, atof(argv[++arg]));
+        else if (strcmp(argv[arg], "-record") == 0)
+            options.record = true;
+        else if (strcmp(argv[arg], "-display") == 0)
+            options.display = true;
+        else if (strcmp(argv[arg], "-csv") == 0 && arg + 1 < argc)
+            csvFile = argv[++arg];
+        else
+        {
+            printf("Usage: %s [-sizes 2048x1536,4096x3072] [-buffers 8,64] [-cost 0,2000 (us)] [-pixelformat Mono8]\n"
+                "          [-record] [-display] [-duration 1.0] [-max-fps 20000] [-csv results.csv]\n", argv[0]);
+            return 0;
+        }
+        if (!valid)
+        {
+            printf("Invalid value for %s: %s\n", argv[arg - 1], argv[arg]);
+            return 0;
+        }
+    }
+
+    FILE *csv = (csvFile != nullptr) ? fopen(csvFile, "w") : nullptr;
+    if (csv != nullptr)
+        fprintf(csv, "width,height,format,buffers,cost_us,record,display,max_fps,onset_fps,onset_loss,loop_cpu_us,process_cpu_us,p99_ms\n");
+    printf("Format %s, record %s, display %s, %g s per rate\n\n", PixelFormatName(options.format),
+        options.record ? "on" : "off", options.display ? "on" : "off", durationSeconds);
+    printf("%-11s %7s %8s %9s %9s %8s %12s %14s %8s\n", "Size", "Buffers", "Cost us", "Max fps", "Onset fps",
+        "Loss", "Loop CPU us", "Process CPU us", "p99 ms");
+
+    double checksum = 0.0;
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        options.width = sizes[s].first;
+        options.height = sizes[s].second;
+        size_t frameBytes = (size_t)PixelFormatLineBytes(options.format, options.width) * options.height;
+        for (size_t b = 0; b < bufferCounts.size(); b++)
+        {
+            int buffers = std::max(1, (int)bufferCounts[b]);
+            SimulatedStream stream;
+            if (!stream.Open(frameBytes, buffers))
+            {
+                printf("Could not allocate %d buffers of %zu bytes\n", buffers, frameBytes);
+                continue;
+            }
+            for (size_t c = 0; c < costs.size(); c++)
+            {
+                options.costUs = costs[c];
+                FrameStages stages;
+                if (!stages.Prepare(options, frameBytes))
+                {
+                    printf("Could not allocate the recorder\n");
+                    continue;
+                }
+
+                // Capacity of the loop from the cost of the stages alone, the upper end of the search
+                SimulatedBuffer *buffer;
+                stream.Start(maxFps);
+                while (!stream.GetNextBuffer(buffer, 100))
+                {
+                }
+                uint64_t stageStart = HostNowNs();
+                int stageRuns = 0;
+                do
+                {
+                    stages.Run(buffer->GetRawData());
+                    stageRuns++;
+                } while (HostNowNs() - stageStart < 100000000 && stageRuns < 1000);
+                double stageNs = (double)(HostNowNs() - stageStart) / stageRuns;
+                stream.ReleaseBuffer(buffer);
+                stream.Stop();
+                while (stream.GetNextBuffer(buffer, 0))
+                    stream.ReleaseBuffer(buffer);
+                double capacity = std::min(maxFps, 1e9 / std::max(stageNs, 1000.0));
+
+                // Bisection on a log scale between a sustained and an unsustained rate
+                double low = 0.05 * capacity, high = 1.2 * capacity;
+                TrialResult best = {}, onset = {};
+                TrialResult trial = RunTrial(stream, stages, high, durationSeconds, checksum);
+                // The estimate can be low when the stages run faster in the loop (warm caches)
+                while (trial.IsSustained() && high < maxFps)
+                {
+                    best = trial;
+                    low = high;
+                    high = std::min(2.0 * high, maxFps);
+                    trial = RunTrial(stream, stages, high, durationSeconds, checksum);
+                }
+                if (trial.IsSustained())
+                    best = trial;
+                else
+                {
+                    onset = trial;
+                    if (best.received == 0)
+                    {
+                        trial = RunTrial(stream, stages, low, durationSeconds, checksum);
+                        if (trial.IsSustained())
+                            best = trial;
+                        else
+                            onset = trial;
+                    }
+                    for (int step = 0; step < 8 && best.received > 0 && high / low > 1.02; step++)
+                    {
+                        double fps = std::sqrt(low * high);
+                        trial = RunTrial(stream, stages, fps, durationSeconds, checksum);
+                        if (trial.IsSustained())
+                        {
+                            best = trial;
+                            low = fps;
+                        }
+                        else
+                        {
+                            onset = trial;
+                            high = fps;
+                        }
+                    }
+                }
+
+                char size[32], onsetFps[32], onsetLoss[32];
+                snprintf(size, sizeof(size), "%ux%u", options.width, options.height);
+                if (onset.received + onset.lost > 0)
+                {
+                    snprintf(onsetFps, sizeof(onsetFps), "%.1f", onset.offeredFps);
+                    snprintf(onsetLoss, sizeof(onsetLoss), "%.2f%%", 100.0 * onset.lost / (onset.received + onset.lost));
+                }
+                else
+                {
+                    // Even the highest rate was sustained: the limit is above the search range
+                    snprintf(onsetFps, sizeof(onsetFps), "> %.0f", high);
+                    snprintf(onsetLoss, sizeof(onsetLoss), "-");
+                }
+                // The CPU per frame is taken at the max fps, without the spinning of an overloaded loop
+                const TrialResult &cpu = best.received ? best : onset;
+                printf("%-11s %7d %8.0f %9.1f %9s %8s %12.1f %14.1f %8.2f%s\n", size, buffers, options.costUs,
+                    best.offeredFps, onsetFps, onsetLoss, cpu.loopCpuUsPerFrame, cpu.processCpuUsPerFrame, best.p99Ms,
+                    (onset.overruns > 0) ? "  (producer overrun: limit of the simulation)" : "");
+                if (csv != nullptr)
+                {
+                    fprintf(csv, "%u,%u,%s,%d,%.0f,%d,%d,%.1f,%.1f,%.4f,%.1f,%.1f,%.3f\n", options.width, options.height,
+                        PixelFormatName(options.format), buffers, options.costUs, options.record ? 1 : 0,
+                        options.display ? 1 : 0, best.offeredFps, onset.offeredFps,
+                        (onset.received + onset.lost) ? (double)onset.lost / (onset.received + onset.lost) : 0.0,
+                        cpu.loopCpuUsPerFrame, cpu.processCpuUsPerFrame, best.p99Ms);
+                    fflush(csv);
+                }
+            }
+        }
+    }
+
+    // Keeps the work of the stages observable
+    if (checksum < 0.0)
+        printf("%f\n", checksum);
+    if (csv != nullptr)
+        fclose(csv);
+    return 0;
+}
@@ -0,0 +1,502 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+/**
+//  \file pfDoubleRate_Benchmark.cpp
+//
+//  \brief
+//  Throughput of the double rate demodulation: pfDoubleRate_DeModulateImage() and
+//  PFImage::DemodulateDR() (mono and color), across frame sizes, thread counts and cache states,
+//  with a JSON baseline to catch regressions.
+//
+//  Description: for every width and height a data set of modulated frames is prepared and these
+//  cases are measured with BenchmarkRunner.h (median time of an iteration, MB/s of modulated
+//  input, frames/s):
+//
+//  - DeModulateImage, DemodulateDR/mono and DemodulateDR/color
+//  - warm: the same frame again and again, it stays in the caches (for frames up to the cache size)
+//  - cold: a ring of different frames larger than the last level cache, every iteration reads
+//    its input from memory and writes its output to memory, as in a real acquisition
+//  - threads:1, one frame per iteration
+//  - threads:N/frames, N threads demodulate N frames in parallel (throughput of the machine)
+//  - threads:N/rows, N threads demodulate one frame split into bands of rows (latency of a
+//    frame). Only measured if the split gives the same image as one call.
+//
+//  The frames are made from captured DR1 files (DrStreamSynthesizer.h), at least one is needed.
+//  Random bytes are no valid modulated image, so a width is only measured when a capture of that
+//  width was given. Without -widths the widths of the captures are measured.
+//
+//      pfDoubleRate_Benchmark -widths 1024,2048 -heights 1088,3072 -threads 1,8
+//          -json results.json -baseline baseline.json -threshold 0.1 w1024.dr1 w2048.dr1
+//
+//  Cases slower than the baseline by more than the threshold, and cases of the baseline that
+//  fail now, are listed as REGRESSION and the exit code is 1. The exit code is 2 without a usable
+//  capture or when the baseline can not be read. A results file becomes the next baseline by
+//  copying it.
+//
+//  After the timed cases every api runs "-perf-runs" more times per frame size on one thread with
+//  warm caches under the hardware performance counters of PerfCounters.h (cycles per byte, IPC,
+//  cache and branch misses), to tell a memory bound from a compute bound demodulation.
+//
+*/
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PFCamera.h"
+#include "PFImage.h"
+#include "pfDoubleRate.h"
+
+#include "BenchmarkRunner.h"
+#include "DrStreamSynthesizer.h"
+#include "FrameBufferPool.h"
+#include "PerfCounters.h"
+
+using namespace PFCameraDLL;
+
+enum DemodulationApi
+{
+    ApiDeModulateImage,
+    ApiDemodulateDRMono,
+    ApiDemodulateDRColor
+};
+
+static const char *ApiName(DemodulationApi api)
+{
+    switch (api)
+    {
+    case ApiDeModulateImage: return "DeModulateImage";
+    case ApiDemodulateDRMono: return "DemodulateDR/mono";
+    default: return "DemodulateDR/color";
+    }
+}
+
+static bool Demodulate(DemodulationApi api, const uint8_t *modulated, uint8_t *demodulated, int demodWidth, int rows, int modWidth)
+{
+    if (api == ApiDeModulateImage)
+        return pfDoubleRate_DeModulateImage(demodulated, (unsigned char*)modulated, demodWidth, rows, modWidth) == PFDOUBLERATE_SUCCESS;
+    // Headers over the benchmark memory, nothing is allocated or copied
+    PFImage modImage(PixelMono8, (uint32_t)modWidth, (uint32_t)rows, 0, 0, 0, 0, (uint64_t)modWidth * rows, (uint8_t*)modulated);
+    PFImage demodImage(PixelMono8, (uint32_t)demodWidth, (uint32_t)rows, 0, 0, 0, 0, (uint64_t)demodWidth * rows, demodulated);
+    return modImage.DemodulateDR(demodImage, api == ApiDemodulateDRColor) == PFSDK_NOERROR;
+}
+
+// Persistent worker threads: creating threads per frame would cost more than a small frame
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int threads)
+        : m_task(nullptr), m_count(0), m_pending(0), m_generation(0), m_stop(false)
+    {
+        for (int i = 1; i < threads; i++)
+            m_threads.push_back(std::thread(&WorkerPool::Worker, this, i));
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (size_t i = 0; i < m_threads.size(); i++)
+            m_threads[i].join();
+    }
+
+    // Calls task(0) .. task(count - 1) on count threads, the caller is thread 0, and waits for all
+    void Run(int count, const std::function<void(int)> &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_count = count;
+            m_pending = count - 1;
+            m_generation++;
+        }
+        m_wake.notify_all();
+        task(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_pending == 0; });
+        m_task = nullptr;
+    }
+
+private:
+    void Worker(int index)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            const std::function<void(int)> *task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+                if (m_stop)
+                    return;
+                seen = m_generation;
+                if (index >= m_count)
+                    continue;
+                task = m_task;
+            }
+            (*task)(index);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(int)> *m_task;
+    int m_count;
+    int m_pending;
+    uint64_t m_generation;
+    bool m_stop;
+};
+
+// Modulated frames and their demodulation targets of one frame size
+struct DataSet
+{
+    int width;
+    int height;
+    int modWidth;
+    int frames;
+    FrameBufferPool modulated;
+    FrameBufferPool demodulated;
+
+    uint8_t *Modulated(uint64_t index) const
+    {
+        return modulated.GetFrame((int)(index % frames));
+    }
+
+    uint8_t *Demodulated(uint64_t index) const
+    {
+        return demodulated.GetFrame((int)(index % frames));
+    }
+};
+
+static bool ParseList(const char *text, std::vector<int> &values)
+{
+    values.clear();
+    while (*text != '\0')
+    {
+        char *end;
+        long value = strtol(text, &end, 10);
+        if (end == text || value <= 0)
+            return false;
+        values.push_back((int)value);
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+// Reads a DR1 file, returns the number of lines or 0
+static int ReadDr1(const char *filename, std::vector<uint8_t> &data, int &demodWidth, int &modWidth)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == nullptr)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    data.resize(size > 0 ? (size_t)size : 0);
+    size_t read = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    if (read != data.size() || data.empty())
+        return 0;
+    pfDoubleRate_GetDeModulatedWidth(data.data(), &demodWidth);
+    pfDoubleRate_GetModulatedWidth(demodWidth, &modWidth);
+    return (demodWidth > 0 && modWidth > 0) ? (int)(data.size() / modWidth) : 0;
+}
+
+// Adds the cases of one api and cache state for every thread count
+static void AddCases(BenchmarkRunner &runner, WorkerPool &pool, DataSet &set, DemodulationApi api, bool cold,
+    const std::vector<int> &threads, bool rowsSplitValid)
+{
+    char prefix[256];
+    snprintf(prefix, sizeof(prefix), "%s/%dx%d/%s", ApiName(api), set.width, set.height, cold ? "cold" : "warm");
+    uint64_t frameBytes = (uint64_t)set.modWidth * set.height;
+
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        int count = threads[t];
+        std::shared_ptr<uint64_t> next = std::make_shared<uint64_t>(0);
+        char name[320];
+        if (count == 1)
+        {
+            snprintf(name, sizeof(name), "%s/threads:1", prefix);
+            runner.Add(name, frameBytes, 1, [=, &set]()
+            {
+                uint64_t index = cold ? (*next)++ : 0;
+                return Demodulate(api, set.Modulated(index), set.Demodulated(index), set.width, set.height, set.modWidth);
+            });
+            continue;
+        }
+
+        // One frame per thread
+        snprintf(name, sizeof(name), "%s/threads:%d/frames", prefix, count);
+        runner.Add(name, frameBytes * count, (uint32_t)count, [=, &set, &pool]()
+        {
+            uint64_t base = cold ? (*next)++ * count : 0;
+            std::vector<char> ok(count, 0);
+            pool.Run(count, [&](int k)
+            {
+                ok[k] = Demodulate(api, set.Modulated(base + k), set.Demodulated(base + k), set.width, set.height, set.modWidth);
+            });
+            return std::count(ok.begin(), ok.end(), 1) == count;
+        });
+
+        // One frame split into bands of an even number of rows
+        if (!rowsSplitValid)
+            continue;
+        snprintf(name, sizeof(name), "%s/threads:%d/rows", prefix, count);
+        runner.Add(name, frameBytes, 1, [=, &set, &pool]()
+        {
+            uint64_t index = cold ? (*next)++ : 0;
+            std::vector<char> ok(count, 0);
+            pool.Run(count, [&](int k)
+            {
+                int y0 = (int)(((int64_t)set.height * k / count) & ~1);
+                int y1 = (k + 1 == count) ? set.height : (int)(((int64_t)set.height * (k + 1) / count) & ~1);
+                ok[k] = Demodulate(api, set.Modulated(index) + (size_t)y0 * set.modWidth,
+                    set.Demodulated(index) + (size_t)y0 * set.width, set.width, y1 - y0, set.modWidth);
+            });
+            return std::count(ok.begin(), ok.end(), 1) == count;
+        });
+    }
+}
+
+// True when demodulating a frame in bands of rows gives the same image as one call
+static bool CheckRowsSplit(DemodulationApi api, DataSet &set, int count)
+{
+    std::vector<uint8_t> whole((size_t)set.width * set.height), bands((size_t)set.width * set.height);
+    if (!Demodulate(api, set.Modulated(0), whole.data(), set.width, set.height, set.modWidth))
+        return false;
+    for (int k = 0; k < count; k++)
+    {
+        int y0 = (int)(((int64_t)set.height * k / count) & ~1);
+        int y1 = (k + 1 == count) ? set.height : (int)(((int64_t)set.height * (k + 1) / count) & ~1);
+        if (!Demodulate(api, set.Modulated(0) + (size_t)y0 * set.modWidth, bands.data() + (size_t)y0 * set.width,
+            set.width, y1 - y0, set.modWidth))
+            return false;
+    }
+    return whole == bands;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<int> widths, heights, threads;
+    ParseList("1088,3072", heights);
+    int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    threads.push_back(1);
+    if (hardwareThreads > 1)
+        threads.push_back(hardwareThreads);
+    double minSeconds = 0.2;
+    double threshold = 0.10;
+    int coldMegabytes = 256;
+    int perfRuns = 20;
+    const char *jsonFile = nullptr;
+    const char *baselineFile = nullptr;
+    const char *filter = nullptr;
+    std::map<int, DrStreamSynthesizer> captured;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        bool valid = true;
+        if (strcmp(argv[arg], "-widths") == 0 && arg + 1 < argc)
+            valid = ParseList(argv[++arg], widths);
+        else if (strcmp(argv[arg], "-heights") == 0 && arg + 1 < argc)
+            valid = ParseList(argv[++arg], heights);
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            valid = ParseList(argv[++arg], threads);
+        else if (strcmp(argv[arg], "-min-time") == 0 && arg + 1 < argc)
+            minSeconds = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-cold-mb") == 0 && arg + 1 < argc)
+            coldMegabytes = std::max(1, atoi(argv[++arg]));
+        else if (strcmp(argv[arg], "-perf-runs") == 0 && arg + 1 < argc)
+            perfRuns = std::max(0, atoi(argv[++arg]));
+        else if (strcmp(argv[arg], "-filter") == 0 && arg + 1 < argc)
+            filter = argv[++arg];
+        else if (strcmp(argv[arg], "-json") == 0 && arg + 1 < argc)
+            jsonFile = argv[++arg];
+        else if (strcmp(argv[arg], "-baseline") == 0 && arg + 1 < argc)
+            baselineFile = argv[++arg];
+        else if (strcmp(argv[arg], "-threshold") == 0 && arg + 1 < argc)
+            threshold = atof(argv[++arg]);
+        else if (argv[arg][0] == '-')
+        {
+            printf("Usage: %s [-widths 1024,2048] [-heights 1088,3072] [-threads 1,%d] [-min-time 0.2]\n"
+                "          [-cold-mb 256] [-perf-runs 20] [-filter text] [-json results.json] [-baseline baseline.json]\n"
+                "          [-threshold 0.10] captured .dr1 files\n", argv[0], hardwareThreads);
+            return 0;
+        }
+        else
+        {
+            std::vector<uint8_t> data;
+            int demodWidth = 0, modWidth = 0;
+            int lines = ReadDr1(argv[arg], data, demodWidth, modWidth);
+            if (lines == 0)
+                printf("Could not read the DR1 image %s\n", argv[arg]);
+            else if (!captured[demodWidth].AddFrame(data.data(), (uint32_t)modWidth, (uint32_t)lines))
+            {
+                printf("The DR1 image %s has less than two lines, skipped\n", argv[arg]);
+                if (captured[demodWidth].GetSourceLines() == 0)
+                    captured.erase(demodWidth);
+            }
+        }
+        if (!valid)
+        {
+            printf("Invalid list for %s: %s\n", argv[arg - 1], argv[arg]);
+            return 0;
+        }
+    }
+
+    if (captured.empty())
+    {
+        printf("No captured DR1 image given, nothing to measure\n");
+        return 2;
+    }
+    if (widths.empty())
+    {
+        for (std::map<int, DrStreamSynthesizer>::const_iterator it = captured.begin(); it != captured.end(); ++it)
+            widths.push_back(it->first);
+    }
+
+    int maxThreads = *std::max_element(threads.begin(), threads.end());
+    WorkerPool pool(maxThreads);
+    BenchmarkRunner runner(minSeconds);
+    runner.SetFilter(filter);
+    runner.SetContext("num_cpus", std::to_string(hardwareThreads));
+    runner.SetContext("cold_mb", std::to_string(coldMegabytes));
+    PerfCounters perfCounters;
+    PerfReport perfReport;
+    if (perfRuns > 0 && !perfCounters.Open())
+        printf("Performance counters not available (%s), reporting time only\n", perfCounters.GetError());
+
+    for (size_t w = 0; w < widths.size(); w++)
+    {
+        std::map<int, DrStreamSynthesizer>::const_iterator source = captured.find(widths[w]);
+        if (source == captured.end())
+        {
+            printf("No captured DR1 image of width %d, skipped\n", widths[w]);
+            continue;
+        }
+        int modWidth = 0;
+        if (pfDoubleRate_GetModulatedWidth(widths[w], &modWidth) != PFDOUBLERATE_SUCCESS || modWidth <= 0)
+        {
+            printf("No modulated width for a width of %d, skipped\n", widths[w]);
+            continue;
+        }
+
+        for (size_t h = 0; h < heights.size(); h++)
+        {
+            DataSet set;
+            set.width = widths[w];
+            set.height = heights[h];
+            set.modWidth = modWidth;
+            size_t modBytes = (size_t)modWidth * set.height;
+            size_t demodBytes = (size_t)set.width * set.height;
+            // Cold ring larger than the caches, at least two frames per thread
+            size_t coldFrames = ((size_t)coldMegabytes << 20) / (modBytes + demodBytes) + 1;
+            set.frames = (int)std::max<size_t>(coldFrames, 2 * (size_t)maxThreads);
+            if (!set.modulated.Allocate(modBytes, set.frames, true, false) ||
+                !set.demodulated.Allocate(demodBytes, set.frames, true, false))
+            {
+                printf("Could not allocate %d frames of %dx%d, skipped\n", set.frames, set.width, set.height);
+                continue;
+            }
+            for (int n = 0; n < set.frames; n++)
+                source->second.MakeFrame((uint64_t)n, (uint32_t)set.height, set.modulated.GetFrame(n));
+
+            const DemodulationApi apis[3] = { ApiDeModulateImage, ApiDemodulateDRMono, ApiDemodulateDRColor };
+            for (int a = 0; a < 3; a++)
+            {
+                bool rowsSplitValid = maxThreads > 1 && CheckRowsSplit(apis[a], set, maxThreads);
+                if (maxThreads > 1 && !rowsSplitValid)
+                    printf("%s %dx%d: bands of rows do not demodulate like the whole frame, no rows cases\n",
+                        ApiName(apis[a]), set.width, set.height);
+                AddCases(runner, pool, set, apis[a], false, threads, rowsSplitValid);
+                AddCases(runner, pool, set, apis[a], true, threads, rowsSplitValid);
+            }
+            runner.Run(stdout);
+
+            // Single thread, warm: the frame was demodulated by the cases above
+            for (int a = 0; a < 3 && perfRuns > 0; a++)
+            {
+                char name[128];
+                snprintf(name, sizeof(name), "%s/%dx%d", ApiName(apis[a]), set.width, set.height);
+                for (int run = 0; run < perfRuns; run++)
+                {
+                    PerfScope scope(perfCounters, perfReport, name, (uint64_t)modBytes);
+                    Demodulate(apis[a], set.Modulated(0), set.Demodulated(0), set.width, set.height, set.modWidth);
+                }
+            }
+        }
+    }
+
+    if (!perfReport.IsEmpty())
+    {
+        if (perfCounters.IsOpen() && !perfCounters.HasHardwareCounters())
+            printf("\nPerformance counters: %s\n", perfCounters.GetError());
+        printf("\nPerformance counters, %d runs per case:\n", perfRuns);
+        perfReport.Print(stdout);
+    }
+
+    if (jsonFile != nullptr)
+    {
+        if (runner.WriteJson(jsonFile))
+            printf("\nResults written to %s\n", jsonFile);
+        else
+            printf("\nCould not write %s\n", jsonFile);
+    }
+    if (baselineFile != nullptr)
+    {
+        if (!runner.LoadBaseline(baselineFile))
+        {
+            printf("Could not read the baseline %s\n", baselineFile);
+            return 2;
+        }
+        if (runner.Compare(stdout, threshold) > 0)
+            return 1;
+    }
+    return 0;
+}
@@ -1,115 +1,298 @@
-/*
-******************************************************************************
-* @attention
-*
-*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
-*
-* Redistribution and use in source and binary forms, with or without modification,
-* are permitted provided that the following conditions are met:
-* 1. Redistributions of source code must retain the above copyright notice,
-* this list of conditions and the following disclaimer.
-* 2. Redistributions in binary form must reproduce the above copyright notice,
-* this list of conditions and the following disclaimer in the documentation
-* and/or other materials provided with the distribution.
-* 3. Neither the name of Photonfocus nor the names of its contributors
-* may be used to endorse or promote products derived from this software
-* without specific prior written permission.
-*
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
-* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
-* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
-* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
-* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
-* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
-* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*
-******************************************************************************
-*/
-
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include "pfDoubleRate.h"
-
-#define BUFFER_SIZE 1024
-
-
-int main(int argc, char **argv)
-{
-	unsigned char *modImage, *demodImage;
-	int Height, modWidth, demodWidth, filesize;
-	char filename[BUFFER_SIZE];
-	FILE *pFile;
-		
-	modWidth = 0;
-	demodWidth = 0;
-	Height = 0;
-	filesize = 0;
-
-	//Read DR1 image
-	if(argc == 2){
-		strcpy(filename, argv[1]);
-	}
-	else{
-		strcpy(filename, "image.dr1");
-		printf("--------------------------------------------------------------------------\n");
-		printf("This program shows, how to use pfDoubleRate Demodulation DLL\n(pfDoubleRate.dll)\n");
-		printf("\n\bUsage:\n");
-		printf("pfDoubleRateExample.exe <dr1 filename>\n");
-		printf("pfDoubleRateExample.exe image.dr1\n");
-		printf("\n\nDefault DR1 image file name is: image.dr1");
-		printf("\n");
-	}
-
-	if((pFile = fopen(filename, "rb")) == NULL){
-		printf("Could not read input image!!!\n");
-		return 0;
-	}
-	//obtain file size:
-	fseek(pFile , 0 , SEEK_END);
-	filesize = ftell(pFile);
-	rewind(pFile);
-
-	//alloc buffer and read from file
-	modImage = (unsigned char*)malloc(filesize);
-	fread(modImage, 1, filesize, pFile);
-	fclose(pFile);
-
-
-	//DEMODULATE
-	//get width of deModulated image
-	pfDoubleRate_GetDeModulatedWidth(modImage, &demodWidth);
-	pfDoubleRate_GetModulatedWidth(demodWidth, &modWidth);
-	Height = filesize / modWidth;
-	demodImage = (unsigned char*)malloc(demodWidth * Height);
-
-	//demodulate image
-	int demod_result = pfDoubleRate_DeModulateImage(demodImage, modImage, demodWidth, Height, modWidth);
-	if(demod_result == PFDOUBLERATE_SUCCESS) {
-		printf("Size of demodulated image: %d %d\n", demodWidth, Height);
-		//write the demodulated image as RAW image format
-		strcpy(filename, "image.raw");
-		if((pFile = fopen(filename, "wb")) == NULL){
-			printf("Could not write output image!!!\n");
-			return 0;
-		}
-		fwrite(demodImage, 1, demodWidth*Height, pFile);
-		fclose(pFile);
-		printf("Image written to %s\n", filename);
-	}
-
-	//clean up
-	if(modImage != NULL){
-		free(modImage);
-		modImage = NULL;
-	}
-	if(demodImage != NULL){
-		free(demodImage);
-		demodImage = NULL;
-	}
-	
-	return 0;
-}
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "pfDoubleRate.h"
+#include "DrContainer.h"
+#include "DrDebayer.h"
+#include "DrRoiDemodulator.h"
+#include "PerfCounters.h"
+
+#define BUFFER_SIZE 1024
+
+//Demodulates the image perfRuns times with hardware performance counters around every call.
+//A copy of the modulated frame is measured alongside as the memory bandwidth reference.
+//With a color debayer the demodulation followed by a full frame debayer is compared with the
+//fused strips of FusedDrDebayer, with a rectangle the demodulation of its lines only.
+static void RunPerfBenchmark(unsigned char *demodImage, unsigned char *modImage, int demodWidth, int Height, int modWidth, int perfRuns,
+	FusedDrDebayer *debayer, FramePixelFormat bayer, unsigned char *colorImage, DrRoiDemodulator *roi, unsigned char *roiImage)
+{
+	PerfCounters counters;
+	PerfReport report;
+	uint64_t modBytes = (uint64_t)modWidth * Height;
+	unsigned char *copyImage = (unsigned char*)malloc(modBytes);
+
+	if(copyImage == NULL){
+		printf("Could not allocate the %llu bytes of the copy reference\n", (unsigned long long)modBytes);
+		return;
+	}
+	if(!counters.Open())
+		printf("Performance counters not available (%s), reporting time only\n", counters.GetError());
+	else if(!counters.HasHardwareCounters())
+		printf("Performance counters: %s\n", counters.GetError());
+
+	//first call outside of the measurement, it pays for page faults and cold caches
+	pfDoubleRate_DeModulateImage(demodImage, modImage, demodWidth, Height, modWidth);
+	memcpy(copyImage, modImage, modBytes);
+
+	for(int run = 0; run < perfRuns; run++){
+		{
+			PerfScope scope(counters, report, "DeModulateImage", modBytes);
+			pfDoubleRate_DeModulateImage(demodImage, modImage, demodWidth, Height, modWidth);
+		}
+		{
+			PerfScope scope(counters, report, "memcpy", modBytes);
+			memcpy(copyImage, modImage, modBytes);
+		}
+		if(debayer != NULL){
+			{
+				PerfScope scope(counters, report, "DeModulate+Debayer", modBytes);
+				pfDoubleRate_DeModulateImage(demodImage, modImage, demodWidth, Height, modWidth);
+				DebayerBilinear(demodImage, demodWidth, demodWidth, Height, bayer, debayer->GetGains(), DebayerBGR,
+					colorImage, (size_t)demodWidth * 3);
+			}
+			{
+				PerfScope scope(counters, report, "FusedDrDebayer", modBytes);
+				debayer->Process(modImage, colorImage, (size_t)demodWidth * 3);
+			}
+		}
+		if(roi != NULL){
+			PerfScope scope(counters, report, "DeModulate ROI", (uint64_t)modWidth * roi->GetHeight());
+			roi->Process(modImage, roiImage, roi->GetWidth());
+		}
+	}
+
+	printf("\nPerformance counters, %d runs on a %dx%d frame:\n", perfRuns, demodWidth, Height);
+	report.Print(stdout);
+	free(copyImage);
+}
+
+
+int main(int argc, char **argv)
+{
+	unsigned char *modImage, *demodImage;
+	int Height, modWidth, demodWidth, filesize;
+	int perfRuns = 0;
+	FramePixelFormat bayer = FormatUnknown;
+	float gainRed = 1.0f, gainGreen = 1.0f, gainBlue = 1.0f;
+	unsigned int roiX = 0, roiY = 0, roiWidth = 0, roiHeight = 0;
+	unsigned int frameIndex = 0;
+	char filename[BUFFER_SIZE];
+	FILE *pFile;
+		
+	modWidth = 0;
+	demodWidth = 0;
+	Height = 0;
+	filesize = 0;
+
+	//Read DR1 image
+	filename[0] = '\0';
+	for(int arg = 1; arg < argc; arg++){
+		if(strcmp(argv[arg], "-perf") == 0 && arg + 1 < argc)
+			perfRuns = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-bayer") == 0 && arg + 1 < argc){
+			//color filter of the demodulated image: GR, RG, GB or BG
+			char name[16];
+			snprintf(name, sizeof(name), "Bayer%s8", argv[++arg]);
+			bayer = ParsePixelFormat(name);
+			if(bayer == FormatUnknown)
+				printf("Unknown Bayer pattern %s, writing the mosaic only\n", argv[arg]);
+		}
+		else if(strcmp(argv[arg], "-roi") == 0 && arg + 1 < argc){
+			if(sscanf(argv[++arg], "%u,%u,%u,%u", &roiX, &roiY, &roiWidth, &roiHeight) != 4)
+				printf("The rectangle must be given as x,y,width,height, e.g. 0,1000,2048,64\n");
+		}
+		else if(strcmp(argv[arg], "-frame") == 0 && arg + 1 < argc)
+			frameIndex = (unsigned int)atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-wb") == 0 && arg + 1 < argc){
+			if(sscanf(argv[++arg], "%f,%f,%f", &gainRed, &gainGreen, &gainBlue) != 3)
+				printf("White balance must be given as red,green,blue gains, e.g. 1.8,1.0,1.5\n");
+		}
+		else{
+			strncpy(filename, argv[arg], BUFFER_SIZE - 1);
+			filename[BUFFER_SIZE - 1] = '\0';
+		}
+	}
+	if(filename[0] == '\0'){
+		strcpy(filename, "image.dr1");
+		printf("--------------------------------------------------------------------------\n");
+		printf("This program shows, how to use pfDoubleRate Demodulation DLL\n(pfDoubleRate.dll)\n");
+		printf("\n\bUsage:\n");
+		printf("pfDoubleRateExample.exe <dr1 filename>\n");
+		printf("pfDoubleRateExample.exe image.dr1\n");
+		printf("pfDoubleRateExample.exe -perf 100 image.dr1    (performance counter report)\n");
+		printf("pfDoubleRateExample.exe -bayer GR -wb 1.8,1.0,1.5 image.dr1    (color image as BGR8 raw)\n");
+		printf("pfDoubleRateExample.exe -roi 0,1000,2048,64 image.dr1    (demodulates the lines of a rectangle only)\n");
+		printf("pfDoubleRateExample.exe -frame 10 capture.drc    (frame 10 of a DR container, see DrContainer.h)\n");
+		printf("\n\nDefault DR1 image file name is: image.dr1");
+		printf("\n");
+	}
+
+	//a DR container holds Window_W and the lines of every frame, frame k is read with one seek
+	DrContainerReader container;
+	if(container.Open(filename)){
+		container.PrintReport(stdout);
+		if(frameIndex >= container.GetFrameCount()){
+			printf("Frame %u requested, %s has %u frames\n", frameIndex, filename, container.GetFrameCount());
+			return 0;
+		}
+		const DrContainerHeader &header = container.GetHeader();
+		const DrContainerFrame &frame = container.GetFrame(frameIndex);
+		demodWidth = (int)header.windowWidth;
+		modWidth = (int)header.modulatedStride;
+		Height = (int)frame.lines;
+		printf("Frame %u: ID %llu, timestamp %llu\n", frameIndex, (unsigned long long)frame.frameId, (unsigned long long)frame.timestamp);
+		//the color filter recorded with the frames unless one is given
+		if(bayer == FormatUnknown && strncmp(header.pixelFormat, "Bayer", 5) == 0)
+			bayer = header.GetPixelFormat();
+
+		modImage = (unsigned char*)malloc(container.GetFrameBytes(frameIndex));
+		if(!container.ReadFrame(frameIndex, modImage)){
+			printf("Could not read frame %u of %s\n", frameIndex, filename);
+			free(modImage);
+			return 0;
+		}
+		container.Close();
+	}
+	else if(!container.IsHeaderless()){
+		printf("Could not read input image!!! (%s)\n", container.GetError());
+		return 0;
+	}
+	else{
+		//plain DR1 data: one frame, the width is found in the data and the height from the file size
+		if((pFile = fopen(filename, "rb")) == NULL){
+			printf("Could not read input image!!!\n");
+			return 0;
+		}
+		//obtain file size:
+		fseek(pFile , 0 , SEEK_END);
+		filesize = ftell(pFile);
+		rewind(pFile);
+
+		//alloc buffer and read from file
+		modImage = (unsigned char*)malloc(filesize);
+		fread(modImage, 1, filesize, pFile);
+		fclose(pFile);
+
+		//get width of deModulated image
+		pfDoubleRate_GetDeModulatedWidth(modImage, &demodWidth);
+		pfDoubleRate_GetModulatedWidth(demodWidth, &modWidth);
+		Height = filesize / modWidth;
+	}
+
+
+	//DEMODULATE
+	demodImage = (unsigned char*)malloc(demodWidth * Height);
+
+	//demodulate image
+	int demod_result = pfDoubleRate_DeModulateImage(demodImage, modImage, demodWidth, Height, modWidth);
+	if(demod_result == PFDOUBLERATE_SUCCESS) {
+		printf("Size of demodulated image: %d %d\n", demodWidth, Height);
+		//write the demodulated image as RAW image format
+		strcpy(filename, "image.raw");
+		if((pFile = fopen(filename, "wb")) == NULL){
+			printf("Could not write output image!!!\n");
+			return 0;
+		}
+		fwrite(demodImage, 1, demodWidth*Height, pFile);
+		fclose(pFile);
+		printf("Image written to %s\n", filename);
+
+		//COLOR
+		//demodulate again in strips of rows, every strip is debayered while it is in the cache
+		FusedDrDebayer debayer;
+		unsigned char *colorImage = NULL;
+		if(bayer != FormatUnknown && debayer.Prepare(modWidth, demodWidth, Height, bayer)){
+			debayer.SetDemodulate([=](const uint8_t *mod, uint8_t *demod, uint32_t rows)
+			{
+				return pfDoubleRate_DeModulateImage(demod, (unsigned char*)mod, demodWidth, (int)rows, modWidth) == PFDOUBLERATE_SUCCESS;
+			});
+			debayer.SetWhiteBalance(gainRed, gainGreen, gainBlue);
+			colorImage = (unsigned char*)malloc((size_t)demodWidth * Height * 3);
+			if(debayer.Process(modImage, colorImage, (size_t)demodWidth * 3)){
+				debayer.PrintReport(stdout);
+				strcpy(filename, "image_bgr.raw");
+				if((pFile = fopen(filename, "wb")) != NULL){
+					fwrite(colorImage, 1, (size_t)demodWidth * Height * 3, pFile);
+					fclose(pFile);
+					printf("Color image written to %s\n", filename);
+				}
+			}
+		}
+
+		//RECTANGLE
+		//only the lines of the rectangle are demodulated, into a compact image
+		DrRoiDemodulator roi;
+		unsigned char *roiImage = NULL;
+		if(roiWidth > 0 && roiHeight > 0 && roi.Prepare(modWidth, demodWidth, Height)){
+			roi.SetDemodulate([=](const uint8_t *mod, uint8_t *demod, uint32_t rows)
+			{
+				return pfDoubleRate_DeModulateImage(demod, (unsigned char*)mod, demodWidth, (int)rows, modWidth) == PFDOUBLERATE_SUCCESS;
+			});
+			if(!roi.SetRegion(roiX, roiY, roiWidth, roiHeight))
+				printf("Rectangle %u,%u,%u,%u does not fit into the %dx%d image\n", roiX, roiY, roiWidth, roiHeight, demodWidth, Height);
+			else{
+				roiImage = (unsigned char*)malloc((size_t)roiWidth * roiHeight);
+				if(roi.Process(modImage, roiImage, roiWidth)){
+					roi.PrintReport(stdout);
+					strcpy(filename, "image_roi.raw");
+					if((pFile = fopen(filename, "wb")) != NULL){
+						fwrite(roiImage, 1, (size_t)roiWidth * roiHeight, pFile);
+						fclose(pFile);
+						printf("Rectangle written to %s (%ux%u)\n", filename, roiWidth, roiHeight);
+					}
+				}
+			}
+		}
+
+		if(perfRuns > 0)
+			RunPerfBenchmark(demodImage, modImage, demodWidth, Height, modWidth, perfRuns,
+				(colorImage != NULL) ? &debayer : NULL, bayer, colorImage, (roiImage != NULL) ? &roi : NULL, roiImage);
+		if(colorImage != NULL)
+			free(colorImage);
+		if(roiImage != NULL)
+			free(roiImage);
+	}
+
+	//clean up
+	if(modImage != NULL){
+		free(modImage);
+		modImage = NULL;
+	}
+	if(demodImage != NULL){
+		free(demodImage);
+		demodImage = NULL;
+	}
+	
+	return 0;
+}
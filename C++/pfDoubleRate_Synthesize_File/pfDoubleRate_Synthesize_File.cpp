@@ -0,0 +1,201 @@
+/*
+******************************************************************************
+* @attention
+*
+*<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+* 3. Neither the name of Photonfocus nor the names of its contributors
+* may be used to endorse or promote products derived from this software
+* without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+//Makes a multi frame DR1 stream from captured DR1 frames (see DrStreamSynthesizer.h): any number
+//of frames of any height, all made of captured modulated lines, for demodulation benchmarks at
+//realistic data volumes. The stream file is the frames one after the other, modWidth * height
+//bytes each; an output name ending in .drc makes a DR container (DrContainer.h) with the width
+//in its header and an index of the frames instead. With -verify every frame is demodulated and compared line by line with the
+//demodulation of the captured lines it was made of. The exit code is 1 when an image can not be read, the stream
+//can not be written or a frame does not verify.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "pfDoubleRate.h"
+#include "DrContainer.h"
+#include "DrStreamSynthesizer.h"
+
+#define BUFFER_SIZE 1024
+
+//Reads a DR1 file, returns the number of lines or 0
+static int ReadDr1(const char *filename, std::vector<unsigned char> &data, int &demodWidth, int &modWidth)
+{
+	FILE *pFile;
+	if((pFile = fopen(filename, "rb")) == NULL){
+		printf("Could not read %s\n", filename);
+		return 0;
+	}
+	fseek(pFile, 0, SEEK_END);
+	long filesize = ftell(pFile);
+	rewind(pFile);
+	data.resize(filesize > 0 ? filesize : 0);
+	size_t read = fread(data.data(), 1, data.size(), pFile);
+	fclose(pFile);
+	if(read != data.size() || data.empty()){
+		printf("Could not read %s\n", filename);
+		return 0;
+	}
+	pfDoubleRate_GetDeModulatedWidth(data.data(), &demodWidth);
+	pfDoubleRate_GetModulatedWidth(demodWidth, &modWidth);
+	if(demodWidth <= 0 || modWidth <= 0){
+		printf("%s is not a DR1 image\n", filename);
+		return 0;
+	}
+	return (int)(data.size() / modWidth);
+}
+
+//Demodulates frame n and compares every line with the demodulated captured line it came from
+static bool VerifyFrame(const DrStreamSynthesizer &synthesizer, const std::vector<unsigned char> &sourceDemod,
+	unsigned char *modFrame, unsigned char *demodFrame, uint64_t n, int demodWidth, int height, int modWidth)
+{
+	if(pfDoubleRate_DeModulateImage(demodFrame, modFrame, demodWidth, height, modWidth) != PFDOUBLERATE_SUCCESS)
+		return false;
+	for(int y = 0; y < height; y++){
+		uint32_t sourceLine = synthesizer.GetSourceLine(n, (uint32_t)y);
+		if(memcmp(demodFrame + (size_t)y * demodWidth, &sourceDemod[(size_t)sourceLine * demodWidth], demodWidth) != 0){
+			printf("Frame %llu line %d differs from the demodulation of captured line %u\n",
+				(unsigned long long)n, y, sourceLine);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	DrStreamSynthesizer synthesizer;
+	std::vector<unsigned char> data;
+	int demodWidth = 0, modWidth = 0;
+	int height = 0, frames = 1;
+	bool verify = false;
+	char output[BUFFER_SIZE] = "stream.dr1";
+	int sources = 0;
+
+	for(int arg = 1; arg < argc; arg++){
+		if(strcmp(argv[arg], "-height") == 0 && arg + 1 < argc)
+			height = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-frames") == 0 && arg + 1 < argc)
+			frames = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-o") == 0 && arg + 1 < argc){
+			strncpy(output, argv[++arg], BUFFER_SIZE - 1);
+			output[BUFFER_SIZE - 1] = '\0';
+		}
+		else if(strcmp(argv[arg], "-verify") == 0)
+			verify = true;
+		else{
+			int width = 0, stride = 0;
+			int lines = ReadDr1(argv[arg], data, width, stride);
+			if(lines == 0)
+				return 1;
+			if(sources > 0 && width != demodWidth){
+				printf("%s is %d pixels wide, the other images %d\n", argv[arg], width, demodWidth);
+				return 1;
+			}
+			if(!synthesizer.AddFrame(data.data(), (uint32_t)stride, (uint32_t)lines)){
+				printf("%s has less than two lines\n", argv[arg]);
+				return 1;
+			}
+			demodWidth = width;
+			modWidth = stride;
+			sources++;
+		}
+	}
+	if(sources == 0){
+		printf("--------------------------------------------------------------------------\n");
+		printf("This program makes multi frame DR1 streams from captured DR1 images\n");
+		printf("\n\bUsage:\n");
+		printf("pfDoubleRate_Synthesize_File [-height lines] [-frames count] [-o stream.dr1|stream.drc] [-verify] <dr1 files>\n");
+		printf("pfDoubleRate_Synthesize_File -height 3072 -frames 500 -o stream.dr1 image.dr1\n");
+		printf("pfDoubleRate_Synthesize_File -frames 500 -o stream.drc image.dr1    (DR container, see DrContainer.h)\n");
+		printf("\n\nAll images must have the same width, the default height is the one of the images together\n");
+		return 0;
+	}
+	if(height <= 0)
+		height = (int)synthesizer.GetSourceLines();
+	if(frames <= 0)
+		frames = 1;
+	synthesizer.PrintReport(stdout);
+
+	//demodulated captured lines, the reference of -verify
+	std::vector<unsigned char> sourceDemod;
+	if(verify){
+		uint32_t lines = synthesizer.GetSourceLines();
+		sourceDemod.resize((size_t)demodWidth * lines);
+		std::vector<unsigned char> sourceMod(synthesizer.GetLine(0), synthesizer.GetLine(0) + (size_t)modWidth * lines);
+		if(pfDoubleRate_DeModulateImage(sourceDemod.data(), sourceMod.data(), demodWidth, (int)lines, modWidth) != PFDOUBLERATE_SUCCESS){
+			printf("Could not demodulate the captured images\n");
+			return 1;
+		}
+	}
+
+	//the captured files do not tell the color filter, binning or camera model: Mono8 without binning
+	size_t outputLength = strlen(output);
+	bool toContainer = outputLength > 4 && strcmp(output + outputLength - 4, ".drc") == 0;
+	DrContainerWriter container;
+	FILE *pFile = NULL;
+	if(toContainer ? !container.Open(output, MakeDrContainerHeader((uint32_t)demodWidth, (uint32_t)modWidth, FormatMono8))
+		: (pFile = fopen(output, "wb")) == NULL){
+		printf("Could not write %s\n", output);
+		return 1;
+	}
+	std::vector<unsigned char> modFrame((size_t)modWidth * height);
+	std::vector<unsigned char> demodFrame(verify ? (size_t)demodWidth * height : 0);
+	int written = 0, verified = 0;
+	bool failed = false;
+	for(int n = 0; n < frames; n++){
+		synthesizer.MakeFrame((uint64_t)n, (uint32_t)height, modFrame.data());
+		//synthetic frames have no camera timestamp
+		if(toContainer ? !container.WriteFrame(modFrame.data(), (uint32_t)height, 0, (uint64_t)n + 1)
+			: fwrite(modFrame.data(), 1, modFrame.size(), pFile) != modFrame.size()){
+			printf("Could not write frame %d to %s\n", n, output);
+			failed = true;
+			break;
+		}
+		written++;
+		if(verify && VerifyFrame(synthesizer, sourceDemod, modFrame.data(), demodFrame.data(), (uint64_t)n, demodWidth, height, modWidth))
+			verified++;
+	}
+	if(toContainer ? !container.Close() : fclose(pFile) != 0){
+		printf("Could not complete %s\n", output);
+		failed = true;
+	}
+
+	printf("%d frames of %dx%d (modulated %dx%d, %.1f MB) written to %s\n", written, demodWidth, height, modWidth, height,
+		(double)written * modFrame.size() / (1024.0 * 1024.0), output);
+	if(verify){
+		printf("%d of %d frames demodulate to the captured lines%s\n", verified, written,
+			(verified == written) ? "" : ", the stream is not valid DR data");
+		failed = failed || verified != written;
+	}
+	return failed ? 1 : 0;
+}
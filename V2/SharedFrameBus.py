@@ -0,0 +1,134 @@
+#
+##############################################################################
+# @attention
+#
+#<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of Photonfocus nor the names of its contributors
+# may be used to endorse or promote products derived from this software
+# without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+# OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+##############################################################################
+#
+#
+#Read only access to the shared memory frame bus written by the C++ examples
+#(see C++/Common/SharedFrameBus.h for the layout). Frames are returned as NumPy
+#arrays that point straight into the shared memory, nothing is copied.
+#
+#The publisher may overwrite a slot at any time. A frame is only consistent if
+#IsValid() still returns True after it has been used; copy it (frame.copy())
+#if it has to be kept longer than the ring takes to wrap around.
+#
+import os, struct, mmap
+
+import numpy as np
+
+MAGIC = b"PFFRBUS\0"
+VERSION = 1
+
+#magic, version, headerBytes, slotCount, slotHeaderBytes, slotBytes, dataBytes, published, pid, reserved
+HEADER = struct.Struct("<8sIIIIQQQII")
+PUBLISHED_OFFSET = 40
+#sequence, frameNumber, frameCounter, timestamp, hostNs, width, height, stride, pixelFormat, dataSize, reserved
+SLOT = struct.Struct("<QQqQQIIIIII")
+
+#PFNC code: (dtype, channels)
+PIXEL_FORMATS = {
+    0x01080001: (np.uint8, 1),      #Mono8
+    0x01100007: (np.uint16, 1),     #Mono16
+    0x01080008: (np.uint8, 1),      #BayerGR8
+    0x01080009: (np.uint8, 1),      #BayerRG8
+    0x0108000A: (np.uint8, 1),      #BayerGB8
+    0x0108000B: (np.uint8, 1),      #BayerBG8
+    0x02180014: (np.uint8, 3),      #RGB8
+    0x02180015: (np.uint8, 3),      #BGR8
+}
+
+class SharedFrame(object):
+    def __init__(self, frameNumber, sequence, header, image):
+        self.frameNumber = frameNumber
+        self.sequence = sequence
+        (_, _, self.frameCounter, self.timestamp, self.hostNs, self.width, self.height,
+            self.stride, self.pixelFormat, self.dataSize, _) = header
+        #NumPy view on the shared memory (read only)
+        self.image = image
+
+class SharedFrameBus(object):
+    def __init__(self, name):
+        path = os.path.join("/dev/shm", name.lstrip("/"))
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self.map = mmap.mmap(fd, 0, access=mmap.ACCESS_READ)
+        finally:
+            os.close(fd)
+
+        (magic, version, self.headerBytes, self.slotCount, self.slotHeaderBytes,
+            self.slotBytes, self.dataBytes, _, self.publisherPid, _) = HEADER.unpack_from(self.map, 0)
+        if magic != MAGIC or version != VERSION:
+            self.map.close()
+            raise ValueError("%s is not a frame bus (version %d)" % (path, VERSION))
+
+    def Close(self):
+        self.map.close()
+
+    def Published(self):
+        #Number of frames published so far, the newest one is Published() - 1
+        return struct.unpack_from("<Q", self.map, PUBLISHED_OFFSET)[0]
+
+    def _SlotOffset(self, frameNumber):
+        return self.headerBytes + self.slotBytes * (frameNumber % self.slotCount)
+
+    def Peek(self, frameNumber):
+        #Returns a SharedFrame without copying, or None if the frame is not available
+        if frameNumber >= self.Published():
+            return None
+        offset = self._SlotOffset(frameNumber)
+        header = SLOT.unpack_from(self.map, offset)
+        sequence = header[0]
+        if sequence & 1 or header[1] != frameNumber:
+            return None
+
+        width, height, stride, pixelFormat = header[5], header[6], header[7], header[8]
+        if pixelFormat not in PIXEL_FORMATS:
+            return None
+        dtype, channels = PIXEL_FORMATS[pixelFormat]
+        itemSize = np.dtype(dtype).itemsize
+        data = np.frombuffer(self.map, dtype=dtype, count=stride * height // itemSize,
+                             offset=offset + self.slotHeaderBytes)
+        #Strided view, lines may be padded
+        image = data.reshape(height, stride // itemSize)[:, :width * channels]
+        if channels > 1:
+            image = image.reshape(height, width, channels)
+        frame = SharedFrame(frameNumber, sequence, header, image)
+        #The header may have been rewritten while it was parsed
+        if not self.IsValid(frame):
+            return None
+        return frame
+
+    def Latest(self):
+        published = self.Published()
+        if published == 0:
+            return None
+        return self.Peek(published - 1)
+
+    def IsValid(self, frame):
+        #True if the slot of the frame was not overwritten in the meantime
+        return struct.unpack_from("<Q", self.map, self._SlotOffset(frame.frameNumber))[0] == frame.sequence
@@ -0,0 +1,82 @@
+#
+##############################################################################
+# @attention
+#
+#<h2><center>&copy; COPYRIGHT(c) 2021 Photonfocus AG</center></h2>
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of Photonfocus nor the names of its contributors
+# may be used to endorse or promote products derived from this software
+# without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+# OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+##############################################################################
+#
+#
+#Displays the frames published to the shared memory frame bus by a C++ example
+#that owns the camera, e.g.:
+#
+#   PFCameraLib_DiscoverConfigAndGrab_Console -publish pf_camera0
+#   python SharedFrameBus_Viewer_OpenCV.py pf_camera0
+#
+#Any number of viewers can run at the same time. They map the frames read only
+#and never slow down the acquisition; a viewer that is too slow skips frames.
+#
+import sys
+
+import cv2 as cv
+from kbhit import KBHit
+from SharedFrameBus import SharedFrameBus
+
+def ViewFrames(bus):
+    lastFrame = -1
+    shown = 0
+    skipped = 0
+    kb = KBHit()
+    print("Press any key to stop")
+    while not kb.kbhit():
+        frame = bus.Latest()
+        if frame is None or frame.frameNumber == lastFrame:
+            cv.waitKey(1)
+            continue
+
+        if lastFrame >= 0:
+            skipped += frame.frameNumber - lastFrame - 1
+        lastFrame = frame.frameNumber
+
+        #imshow copies into the window, after that the slot may be reused
+        cv.imshow("Shared frame bus", frame.image)
+        if bus.IsValid(frame):
+            shown += 1
+        cv.waitKey(1)
+
+        sys.stdout.write("Frame: %d FrameCounter: %d Shown: %d Skipped: %d\r" % (frame.frameNumber, frame.frameCounter, shown, skipped))
+        sys.stdout.flush()
+    kb.set_normal_term()
+
+if __name__ == "__main__":
+    name = sys.argv[1] if len(sys.argv) > 1 else "pf_camera0"
+    try:
+        bus = SharedFrameBus(name)
+    except (OSError, IOError, ValueError) as e:
+        print("Could not open frame bus %s: %s" % (name, e))
+        sys.exit(-1)
+    print("Frame bus %s: %d slots of %d bytes, publisher pid %d" % (name, bus.slotCount, bus.dataBytes, bus.publisherPid))
+    ViewFrames(bus)
+    bus.Close()